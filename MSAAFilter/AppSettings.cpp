@@ -59,6 +59,12 @@ static const char* ScenesLabels[5] =
     "Tower",
 };
 
+static const char* BloomModesLabels[2] =
+{
+    "Gaussian",
+    "Dual Filter",
+};
+
 namespace AppSettings
 {
     MSAAModesSetting MSAAMode;
@@ -88,12 +94,19 @@ namespace AppSettings
     FilterTypesSetting ReprojectionFilter;
     BoolSetting UseStandardReprojection;
     ScenesSetting CurrentScene;
+    IntSetting SceneMemoryBudget;
+    BoolSetting CompressVertices;
+    BoolSetting MeshletCulling;
+    BoolSetting OcclusionCulling;
+    FloatSetting LODErrorThreshold;
     DirectionSetting LightDirection;
     ColorSetting LightColor;
     BoolSetting EnableDirectLighting;
     BoolSetting EnableAmbientLighting;
     BoolSetting RenderBackground;
     BoolSetting EnableShadows;
+    IntSetting DepthReadbackLatency;
+    IntSetting MaxCascadeUpdateInterval;
     BoolSetting EnableNormalMaps;
     FloatSetting NormalMapIntensity;
     FloatSetting DiffuseIntensity;
@@ -107,7 +120,13 @@ namespace AppSettings
     FloatSetting BloomExposure;
     FloatSetting BloomMagnitude;
     FloatSetting BloomBlurSigma;
+    BloomModesSetting BloomMode;
+    IntSetting BloomMipCount;
+    FloatSetting BloomFilterRadius;
     FloatSetting ManualExposure;
+    BoolSetting ValidateBloom;
+    BoolSetting ValidateEVSM;
+    BoolSetting ValidateDepthReduction;
 
     ConstantBuffer<AppSettingsCBuffer> CBuffer;
 
@@ -196,6 +215,21 @@ namespace AppSettings
         CurrentScene.Initialize(tweakBar, "CurrentScene", "Scene Controls", "Current Scene", "", Scenes::RoboHand, 5, ScenesLabels);
         Settings.AddSetting(&CurrentScene);
 
+        SceneMemoryBudget.Initialize(tweakBar, "SceneMemoryBudget", "Scene Controls", "Scene Memory Budget (MB)", "Amount of GPU memory that loaded scenes can use before the least recently used scenes are unloaded", 256, 16, 4096);
+        Settings.AddSetting(&SceneMemoryBudget);
+
+        CompressVertices.Initialize(tweakBar, "CompressVertices", "Scene Controls", "Compress Vertices", "Uses a quantized 20-byte vertex format in the vertex buffers, instead of full-precision floats", true);
+        Settings.AddSetting(&CompressVertices);
+
+        MeshletCulling.Initialize(tweakBar, "MeshletCulling", "Scene Controls", "Meshlet Culling", "Culls clusters of triangles against the view frustum, the shadow cascades, and their normal cones, instead of drawing whole mesh parts", true);
+        Settings.AddSetting(&MeshletCulling);
+
+        OcclusionCulling.Initialize(tweakBar, "OcclusionCulling", "Scene Controls", "Occlusion Culling", "Skips mesh parts that are hidden behind large occluders, using a low-resolution depth buffer that is rasterized on the CPU for the camera and for each shadow cascade", true);
+        Settings.AddSetting(&OcclusionCulling);
+
+        LODErrorThreshold.Initialize(tweakBar, "LODErrorThreshold", "Scene Controls", "LOD Error Threshold", "Maximum screen-space error in pixels for drawing a simplified LOD of a mesh part, or 0 to always draw full detail", 1.0000f, 0.0000f, 16.0000f, 0.2500f, ConversionMode::None, 1.0000f);
+        Settings.AddSetting(&LODErrorThreshold);
+
         LightDirection.Initialize(tweakBar, "LightDirection", "Scene Controls", "Light Direction", "The direction of the light", Float3(-0.7500f, 0.9770f, -0.4000f));
         Settings.AddSetting(&LightDirection);
 
@@ -214,6 +248,12 @@ namespace AppSettings
         EnableShadows.Initialize(tweakBar, "EnableShadows", "Scene Controls", "Enable Shadows", "", true);
         Settings.AddSetting(&EnableShadows);
 
+        DepthReadbackLatency.Initialize(tweakBar, "DepthReadbackLatency", "Scene Controls", "Depth Readback Latency", "Number of frames that the shadow depth bounds readback is allowed to lag behind the GPU", 2, 2, 4);
+        Settings.AddSetting(&DepthReadbackLatency);
+
+        MaxCascadeUpdateInterval.Initialize(tweakBar, "MaxCascadeUpdateInterval", "Scene Controls", "Max Cascade Update Interval", "Maximum number of frames between updates of the far shadow cascades, which trades shadow latency for reduced rendering cost", 4, 1, 8);
+        Settings.AddSetting(&MaxCascadeUpdateInterval);
+
         EnableNormalMaps.Initialize(tweakBar, "EnableNormalMaps", "Scene Controls", "Enable Normal Maps", "", true);
         Settings.AddSetting(&EnableNormalMaps);
 
@@ -253,15 +293,35 @@ namespace AppSettings
         BloomBlurSigma.Initialize(tweakBar, "BloomBlurSigma", "Post Processing", "Bloom Blur Sigma", "Sigma parameter of the Gaussian filter used in the bloom pass", 5.0000f, 0.5000f, 5.0000f, 0.0100f, ConversionMode::None, 1.0000f);
         Settings.AddSetting(&BloomBlurSigma);
 
+        BloomMode.Initialize(tweakBar, "BloomMode", "Post Processing", "Bloom Mode", "Selects between a separable Gaussian blur and a downsample/upsample mip chain for the bloom pass", BloomModes::Gaussian, 2, BloomModesLabels);
+        Settings.AddSetting(&BloomMode);
+
+        BloomMipCount.Initialize(tweakBar, "BloomMipCount", "Post Processing", "Bloom Mip Count", "Number of levels in the dual filter bloom mip chain", 6, 1, 8);
+        Settings.AddSetting(&BloomMipCount);
+
+        BloomFilterRadius.Initialize(tweakBar, "BloomFilterRadius", "Post Processing", "Bloom Filter Radius", "Radius in texels of the tent filter used when upsampling the dual filter bloom mip chain", 1.0000f, 0.5000f, 4.0000f, 0.0100f, ConversionMode::None, 1.0000f);
+        Settings.AddSetting(&BloomFilterRadius);
+
         ManualExposure.Initialize(tweakBar, "ManualExposure", "Post Processing", "Manual Exposure", "Manual exposure value when auto-exposure is disabled", -2.5000f, -10.0000f, 10.0000f, 0.0100f, ConversionMode::None, 1.0000f);
         Settings.AddSetting(&ManualExposure);
 
+        ValidateBloom.Initialize(tweakBar, "ValidateBloom", "Debug", "Validate Bloom", "Runs the dual filter bloom on the CPU every frame, and asserts that it matches the GPU result", false);
+        Settings.AddSetting(&ValidateBloom);
+
+        ValidateEVSM.Initialize(tweakBar, "ValidateEVSM", "Debug", "Validate EVSM", "Reads back the shadow map depth of every cascade that's rendered, converts and blurs it on the CPU, and asserts that it matches the GPU EVSM map", false);
+        Settings.AddSetting(&ValidateEVSM);
+
+        ValidateDepthReduction.Initialize(tweakBar, "ValidateDepthReduction", "Debug", "Validate Depth Reduction", "Reads back the depth buffer and the GPU depth reduction every frame, and asserts that the reduction matches the CPU version", false);
+        Settings.AddSetting(&ValidateDepthReduction);
+
         TwHelper::SetOpened(tweakBar, "Anti Aliasing", true);
 
         TwHelper::SetOpened(tweakBar, "Scene Controls", true);
 
         TwHelper::SetOpened(tweakBar, "Post Processing", true);
 
+        TwHelper::SetOpened(tweakBar, "Debug", true);
+
         CBuffer.Initialize(device);
     }
 
@@ -314,6 +374,7 @@ namespace AppSettings
         CBuffer.Data.BloomExposure = BloomExposure;
         CBuffer.Data.BloomMagnitude = BloomMagnitude;
         CBuffer.Data.BloomBlurSigma = BloomBlurSigma;
+        CBuffer.Data.BloomFilterRadius = BloomFilterRadius;
         CBuffer.Data.ManualExposure = ManualExposure;
 
         CBuffer.ApplyChanges(context);
@@ -346,5 +407,10 @@ namespace AppSettings
         CubicB.SetEditable(generalCubic);
         CubicC.SetEditable(generalCubic);
         GaussianSigma.SetEditable(ResolveFilterType == FilterTypes::Gaussian);
+
+        bool dualFilterBloom = BloomMode == BloomModes::DualFilter;
+        BloomBlurSigma.SetEditable(!dualFilterBloom);
+        BloomMipCount.SetEditable(dualFilterBloom);
+        BloomFilterRadius.SetEditable(dualFilterBloom);
     }
 }
@@ -104,6 +104,14 @@ public class Settings
         Variance_Clip,
     }
 
+    enum BloomModes
+    {
+        Gaussian,
+
+        [EnumLabel("Dual Filter")]
+        DualFilter,
+    }
+
     public class AntiAliasing
     {
         MSAAModes MSAAMode = MSAAModes.MSAA4x;
@@ -193,6 +201,36 @@ public class Settings
     {
         Scenes CurrentScene = Scenes.RoboHand;
 
+        [DisplayName("Scene Memory Budget (MB)")]
+        [MinValue(16)]
+        [MaxValue(4096)]
+        [HelpText("Amount of GPU memory that loaded scenes can use before the least recently used scenes are unloaded")]
+        [UseAsShaderConstant(false)]
+        int SceneMemoryBudget = 256;
+
+        [DisplayName("Compress Vertices")]
+        [HelpText("Uses a quantized 20-byte vertex format in the vertex buffers, instead of full-precision floats")]
+        [UseAsShaderConstant(false)]
+        bool CompressVertices = true;
+
+        [DisplayName("Meshlet Culling")]
+        [HelpText("Culls clusters of triangles against the view frustum, the shadow cascades, and their normal cones, instead of drawing whole mesh parts")]
+        [UseAsShaderConstant(false)]
+        bool MeshletCulling = true;
+
+        [DisplayName("Occlusion Culling")]
+        [HelpText("Skips mesh parts that are hidden behind large occluders, using a low-resolution depth buffer that is rasterized on the CPU for the camera and for each shadow cascade")]
+        [UseAsShaderConstant(false)]
+        bool OcclusionCulling = true;
+
+        [DisplayName("LOD Error Threshold")]
+        [HelpText("Maximum screen-space error in pixels for drawing a simplified LOD of a mesh part, or 0 to always draw full detail")]
+        [MinValue(0.0f)]
+        [MaxValue(16.0f)]
+        [StepSize(0.25f)]
+        [UseAsShaderConstant(false)]
+        float LODErrorThreshold = 1.0f;
+
         [DisplayName("Light Direction")]
         [HelpText("The direction of the light")]
         Direction LightDirection = new Direction(-0.75f, 0.977f, -0.4f);
@@ -215,6 +253,18 @@ public class Settings
 
         bool EnableShadows = true;
 
+        [MinValue(2)]
+        [MaxValue(4)]
+        [HelpText("Number of frames that the shadow depth bounds readback is allowed to lag behind the GPU")]
+        [UseAsShaderConstant(false)]
+        int DepthReadbackLatency = 2;
+
+        [MinValue(1)]
+        [MaxValue(8)]
+        [HelpText("Maximum number of frames between updates of the far shadow cascades, which trades shadow latency for reduced rendering cost")]
+        [UseAsShaderConstant(false)]
+        int MaxCascadeUpdateInterval = 4;
+
         bool EnableNormalMaps = true;
 
         [MinValue(0.0f)]
@@ -281,6 +331,25 @@ public class Settings
         [HelpText("Sigma parameter of the Gaussian filter used in the bloom pass")]
         float BloomBlurSigma = 5.0f;
 
+        [DisplayName("Bloom Mode")]
+        [HelpText("Selects between a separable Gaussian blur and a downsample/upsample mip chain for the bloom pass")]
+        [UseAsShaderConstant(false)]
+        BloomModes BloomMode = BloomModes.Gaussian;
+
+        [DisplayName("Bloom Mip Count")]
+        [MinValue(1)]
+        [MaxValue(8)]
+        [HelpText("Number of levels in the dual filter bloom mip chain")]
+        [UseAsShaderConstant(false)]
+        int BloomMipCount = 6;
+
+        [DisplayName("Bloom Filter Radius")]
+        [MinValue(0.5f)]
+        [MaxValue(4.0f)]
+        [StepSize(0.01f)]
+        [HelpText("Radius in texels of the tent filter used when upsampling the dual filter bloom mip chain")]
+        float BloomFilterRadius = 1.0f;
+
         [MinValue(-10.0f)]
         [MaxValue(10.0f)]
         [StepSize(0.01f)]
@@ -288,6 +357,24 @@ public class Settings
         float ManualExposure = -2.5f;
     }
 
+    public class Debug
+    {
+        [DisplayName("Validate Bloom")]
+        [HelpText("Runs the dual filter bloom on the CPU every frame, and asserts that it matches the GPU result")]
+        [UseAsShaderConstant(false)]
+        bool ValidateBloom = false;
+
+        [DisplayName("Validate EVSM")]
+        [HelpText("Reads back the shadow map depth of every cascade that's rendered, converts and blurs it on the CPU, and asserts that it matches the GPU EVSM map")]
+        [UseAsShaderConstant(false)]
+        bool ValidateEVSM = false;
+
+        [DisplayName("Validate Depth Reduction")]
+        [HelpText("Reads back the depth buffer and the GPU depth reduction every frame, and asserts that the reduction matches the CPU version")]
+        [UseAsShaderConstant(false)]
+        bool ValidateDepthReduction = false;
+    }
+
     // No auto-exposure for this sample
     const bool EnableAutoExposure = false;
     const float KeyValue = 0.115f;
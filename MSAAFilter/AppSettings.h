@@ -85,6 +85,16 @@ enum class Scenes
 
 typedef EnumSettingT<Scenes> ScenesSetting;
 
+enum class BloomModes
+{
+    Gaussian = 0,
+    DualFilter = 1,
+
+    NumValues
+};
+
+typedef EnumSettingT<BloomModes> BloomModesSetting;
+
 namespace AppSettings
 {
     static const bool EnableAutoExposure = false;
@@ -118,12 +128,19 @@ namespace AppSettings
     extern FilterTypesSetting ReprojectionFilter;
     extern BoolSetting UseStandardReprojection;
     extern ScenesSetting CurrentScene;
+    extern IntSetting SceneMemoryBudget;
+    extern BoolSetting CompressVertices;
+    extern BoolSetting MeshletCulling;
+    extern BoolSetting OcclusionCulling;
+    extern FloatSetting LODErrorThreshold;
     extern DirectionSetting LightDirection;
     extern ColorSetting LightColor;
     extern BoolSetting EnableDirectLighting;
     extern BoolSetting EnableAmbientLighting;
     extern BoolSetting RenderBackground;
     extern BoolSetting EnableShadows;
+    extern IntSetting DepthReadbackLatency;
+    extern IntSetting MaxCascadeUpdateInterval;
     extern BoolSetting EnableNormalMaps;
     extern FloatSetting NormalMapIntensity;
     extern FloatSetting DiffuseIntensity;
@@ -137,7 +154,13 @@ namespace AppSettings
     extern FloatSetting BloomExposure;
     extern FloatSetting BloomMagnitude;
     extern FloatSetting BloomBlurSigma;
+    extern BloomModesSetting BloomMode;
+    extern IntSetting BloomMipCount;
+    extern FloatSetting BloomFilterRadius;
     extern FloatSetting ManualExposure;
+    extern BoolSetting ValidateBloom;
+    extern BoolSetting ValidateEVSM;
+    extern BoolSetting ValidateDepthReduction;
 
     struct AppSettingsCBuffer
     {
@@ -184,6 +207,7 @@ namespace AppSettings
         float BloomExposure;
         float BloomMagnitude;
         float BloomBlurSigma;
+        float BloomFilterRadius;
         float ManualExposure;
     };
 
@@ -43,6 +43,7 @@ cbuffer AppSettings : register(b7)
     float BloomExposure;
     float BloomMagnitude;
     float BloomBlurSigma;
+    float BloomFilterRadius;
     float ManualExposure;
 }
 
@@ -83,6 +84,9 @@ static const int Scenes_UIPlane = 2;
 static const int Scenes_Soldier = 3;
 static const int Scenes_Tower = 4;
 
+static const int BloomModes_Gaussian = 0;
+static const int BloomModes_DualFilter = 1;
+
 static const bool EnableAutoExposure = false;
 static const float KeyValue = 0.1150f;
 static const float AdaptationRate = 0.5000f;
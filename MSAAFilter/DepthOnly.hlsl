@@ -16,6 +16,9 @@ cbuffer VSConstants : register(b0)
     float4x4 World;
 	float4x4 View;
     float4x4 WorldViewProjection;
+    float4x4 PrevWorldViewProjection;
+    float3 PositionScale;
+    float3 PositionOffset;
 }
 
 // ================================================================================================
@@ -38,8 +41,14 @@ VSOutput VS(in VSInput input)
 {
     VSOutput output;
 
+    // Compressed positions are quantized to the mesh bounds
+    float3 positionOS = input.PositionOS.xyz;
+    #if CompressedVertices_
+        positionOS = positionOS * PositionScale + PositionOffset;
+    #endif
+
     // Calc the clip-space position
-    output.PositionCS = mul(input.PositionOS, WorldViewProjection);
+    output.PositionCS = mul(float4(positionOS, 1.0f), WorldViewProjection);
 
     return output;
 }
\ No newline at end of file
@@ -31,6 +31,12 @@ Texture2D<float2> ReductionMap : register(t0);
 
 RWTexture2D<float2> OutputMap : register(u0);
 
+#if MSAA_
+    RWTexture2DArray<float> DepthSamples : register(u0);
+#else
+    RWTexture2D<float> DepthSamples : register(u0);
+#endif
+
 cbuffer ReductionConstants : register(b0)
 {
     float4x4 Projection;
@@ -146,4 +152,21 @@ void DepthReductionCS(in uint3 GroupID : SV_GroupID, in uint3 GroupThreadID : SV
         maxDepth = depthsamples[0].y;
         OutputMap[GroupID.xy] = float2(minDepth, maxDepth);
     }
+}
+
+//=================================================================================================
+// Copies each MSAA sample of the depth map to its own slice, so that it can be read back
+//=================================================================================================
+[numthreads(ReductionTGSize, ReductionTGSize, 1)]
+void CopyDepthSamplesCS(in uint3 DispatchID : SV_DispatchThreadID)
+{
+    if(any(DispatchID.xy >= TextureSize))
+        return;
+
+    #if MSAA_
+        for(uint sIdx = 0; sIdx < NumSamples; ++sIdx)
+            DepthSamples[uint3(DispatchID.xy, sIdx)] = DepthMap.Load(DispatchID.xy, sIdx);
+    #else
+        DepthSamples[DispatchID.xy] = DepthMap[DispatchID.xy];
+    #endif
 }
\ No newline at end of file
@@ -21,6 +21,8 @@
 #include <Graphics\\SpriteRenderer.h>
 #include <Graphics\\Model.h>
 #include <Utility.h>
+#include <ChunkFile.h>
+#include <TaskScheduler.h>
 #include <Graphics\\Camera.h>
 #include <Graphics\\ShaderCompilation.h>
 #include <Graphics\\Profiler.h>
@@ -33,6 +35,9 @@ using std::wstring;
 static const float NearClip = 0.01f;
 static const float FarClip = 100.0f;
 
+// Offset along the light direction for the shadow ray from a picked point
+static const float PickShadowBias = 0.001f;
+
 static const float ModelScales[uint64(Scenes::NumValues)] = { 0.1f, 1.0f, 1.0f, 5.0f, 0.01f, };
 static const Float3 ModelPositions[uint64(Scenes::NumValues)] = { Float3(-1.0f, 2.0f, 0.0f), Float3(0.0f, 0.0f, 0.0f), Float3(0.0f, 0.0f, 0.0f), Float3(0.0f, 0.0f, 0.0f), Float3(0.0f, 0.0f, 0.0f) };
 
@@ -80,6 +85,175 @@ void MSAAFilter::AfterReset()
     postProcessor.AfterReset(deviceManager.BackBufferWidth(), deviceManager.BackBufferHeight());
 }
 
+// Loads the CPU data for a scene without creating any device resources, so that it can run as
+// a task
+static void LoadScene(Model& model, uint64 sceneIdx)
+{
+    if(sceneIdx == uint64(Scenes::BrickPlane))
+        model.GeneratePlaneScene(nullptr, Float2(10.0f, 10.0f), Float3(), Quaternion(),
+                                 L"Bricks.dds", L"Bricks_NML.dds");
+    else if(sceneIdx == uint64(Scenes::UIPlane))
+        model.GeneratePlaneScene(nullptr, Float2(10.0f, 10.0f), Float3(), Quaternion(),
+                                 L"UI.png", L"");
+    else if(sceneIdx == uint64(Scenes::RoboHand))
+        model.CreateFromMeshData(nullptr, ModelPaths[sceneIdx]);
+    else
+        model.CreateFromSDKMeshFile(nullptr, ModelPaths[sceneIdx], ModelNormalMapSuffix[sceneIdx], true);
+}
+
+// Kicks off a task that loads the CPU data for a scene. It's submitted as a background task so
+// that it only runs on a worker, and the main thread just polls it in UpdateScenes().
+void MSAAFilter::StartSceneLoad(uint64 sceneIdx)
+{
+    SceneSlot& scene = scenes[sceneIdx];
+    Assert_(scene.SceneModel == nullptr);
+
+    scene.SceneModel.reset(new Model());
+    Model* model = scene.SceneModel.get();
+    scene.LoadTask = SubmitBackgroundTask([model, sceneIdx]() { LoadScene(*model, sceneIdx); });
+}
+
+// Waits for a scene's load task, and creates its device resources on the main thread
+void MSAAFilter::FinishSceneLoad(uint64 sceneIdx)
+{
+    SceneSlot& scene = scenes[sceneIdx];
+    WaitForTask(scene.LoadTask);
+    scene.LoadTask = nullptr;
+
+    scene.SceneModel->SetVertexCompression(deviceManager.Device(), AppSettings::CompressVertices);
+    scene.SceneModel->CreateDeviceResources(deviceManager.Device());
+    scene.MemorySize = scene.SceneModel->MemorySize();
+    scene.Resident = true;
+
+    // Scenes that were preloaded and haven't been displayed yet are the first ones to be unloaded
+    scene.LastUsedFrame = 0;
+
+    scene.SceneModel->VertexCacheStatistics(scene.CacheStatsBefore, scene.CacheStatsAfter);
+}
+
+void MSAAFilter::UpdateScenes()
+{
+    const uint64 selectedScene = AppSettings::CurrentScene;
+    SceneSlot& selected = scenes[selectedScene];
+    if(selected.SceneModel == nullptr)
+        StartSceneLoad(selectedScene);
+
+    for(uint64 i = 0; i < uint64(Scenes::NumValues); ++i)
+        if(scenes[i].LoadTask != nullptr && TaskCompleted(scenes[i].LoadTask))
+            FinishSceneLoad(i);
+
+    // Re-create the vertex buffers of the loaded scenes with the new vertex layout. Scenes that
+    // are still loading pick up the setting when they finish.
+    if(AppSettings::CompressVertices.Changed())
+    {
+        for(uint64 i = 0; i < uint64(Scenes::NumValues); ++i)
+        {
+            SceneSlot& scene = scenes[i];
+            if(scene.Resident == false)
+                continue;
+
+            scene.SceneModel->SetVertexCompression(deviceManager.Device(), AppSettings::CompressVertices);
+            scene.MemorySize = scene.SceneModel->MemorySize();
+        }
+
+        if(scenes[displayedScene].Resident)
+            meshRenderer.SetModel(scenes[displayedScene].SceneModel.get());
+    }
+
+    // Keep displaying the previous scene until the selected one is ready
+    if(selected.Resident && selectedScene != displayedScene)
+    {
+        displayedScene = selectedScene;
+        meshRenderer.SetModel(selected.SceneModel.get());
+        AppSettings::ModelOrientation.SetValue(modelOrientations[displayedScene]);
+        pickResult = PickResult();
+    }
+
+    scenes[displayedScene].LastUsedFrame = frameCount;
+
+    // Unload the least recently used scenes until we're back under the budget. The displayed scene
+    // and the one being loaded are never unloaded.
+    const uint64 budget = uint64(AppSettings::SceneMemoryBudget) * 1024 * 1024;
+    while(true)
+    {
+        uint64 totalSize = 0;
+        uint64 lruScene = uint64(-1);
+        for(uint64 i = 0; i < uint64(Scenes::NumValues); ++i)
+        {
+            const SceneSlot& scene = scenes[i];
+            if(scene.Resident == false)
+                continue;
+
+            totalSize += scene.MemorySize;
+            if(i == displayedScene || i == selectedScene)
+                continue;
+            if(lruScene == uint64(-1) || scene.LastUsedFrame < scenes[lruScene].LastUsedFrame)
+                lruScene = i;
+        }
+
+        if(totalSize <= budget || lruScene == uint64(-1))
+            break;
+
+        SceneSlot& evicted = scenes[lruScene];
+        evicted.SceneModel.reset();
+        evicted.Resident = false;
+        evicted.MemorySize = 0;
+
+        // A reloaded scene starts with BVHs in object space
+        if(bvhScene == lruScene)
+            bvhScene = uint64(-1);
+    }
+}
+
+// Finds the closest triangle under the cursor using the mesh BVHs, and traces a shadow ray from
+// it towards the light. The BVHs are refit to the model transform when it's changed since the
+// last pick, and the first pick on a mesh that wasn't loaded with a BVH builds it.
+void MSAAFilter::PickTriangle(const MouseState& mouseState)
+{
+    std::vector<Mesh>& meshes = scenes[displayedScene].SceneModel->Meshes();
+    if(bvhScene != displayedScene || memcmp(&bvhTransform, &modelTransform, sizeof(Float4x4)) != 0)
+    {
+        for(uint64 i = 0; i < meshes.size(); ++i)
+            meshes[i].RefitBVH(modelTransform);
+
+        bvhScene = displayedScene;
+        bvhTransform = modelTransform;
+    }
+
+    // Unproject the cursor onto the far clip plane
+    Float3 farPos;
+    farPos.x = ((mouseState.X + 0.5f) / deviceManager.BackBufferWidth()) * 2.0f - 1.0f;
+    farPos.y = 1.0f - ((mouseState.Y + 0.5f) / deviceManager.BackBufferHeight()) * 2.0f;
+    farPos.z = 1.0f;
+    farPos = Float3::Transform(farPos, Float4x4::Invert(camera.ViewProjectionMatrix()));
+
+    const Float3 origin = camera.Position();
+    const Float3 direction = Float3::Normalize(farPos - origin);
+    float closestT = Float3::Length(farPos - origin);
+
+    pickResult = PickResult();
+    for(uint64 i = 0; i < meshes.size(); ++i)
+    {
+        BVHHit hit;
+        if(meshes[i].TriangleBVH().IntersectRay(origin, direction, closestT, hit))
+        {
+            closestT = hit.T;
+            pickResult.Valid = true;
+            pickResult.MeshIdx = i;
+            pickResult.TriangleID = hit.TriangleID;
+            pickResult.Distance = hit.T;
+        }
+    }
+
+    if(pickResult.Valid == false)
+        return;
+
+    const Float3 lightDir = Float3::Normalize(AppSettings::LightDirection);
+    const Float3 shadowOrigin = origin + direction * closestT + lightDir * PickShadowBias;
+    for(uint64 i = 0; i < meshes.size() && pickResult.Shadowed == false; ++i)
+        pickResult.Shadowed = meshes[i].TriangleBVH().RayOccluded(shadowOrigin, lightDir, FarClip);
+}
+
 void MSAAFilter::Initialize()
 {
     App::Initialize();
@@ -94,32 +268,24 @@ void MSAAFilter::Initialize()
     // Camera setup
     camera.SetPosition(Float3(0.0f, 2.5f, -10.0f));
 
-    // Load the scenes
+    // All of the scenes start loading in parallel, but only the initial scene is waited on. The
+    // rest finish in UpdateScenes(), where the ones that don't fit in the memory budget are
+    // unloaded again and then re-loaded when they're first selected.
+    displayedScene = AppSettings::CurrentScene;
     for(uint64 i = 0; i < uint64(Scenes::NumValues); ++i)
-    {
-        if(i == uint64(Scenes::BrickPlane))
-            models[i].GeneratePlaneScene(device, Float2(10.0f, 10.0f), Float3(), Quaternion(),
-                                         L"Bricks.dds", L"Bricks_NML.dds");
-        else if(i == uint64(Scenes::UIPlane))
-            models[i].GeneratePlaneScene(device, Float2(10.0f, 10.0f), Float3(), Quaternion(),
-                                         L"UI.png", L"");
-        else if(i == uint64(Scenes::RoboHand))
-            models[i].CreateFromMeshData(device, ModelPaths[i]);
-        else
-            models[i].CreateFromSDKMeshFile(device, ModelPaths[i], ModelNormalMapSuffix[i], true);
-    }
+        StartSceneLoad(i);
+    FinishSceneLoad(displayedScene);
 
     modelOrientations[uint64(Scenes::RoboHand)] = Quaternion(0.41f, -0.55f, -0.29f, 0.67f);
-    AppSettings::ModelOrientation.SetValue(modelOrientations[AppSettings::CurrentScene]);
+    AppSettings::ModelOrientation.SetValue(modelOrientations[displayedScene]);
 
     meshRenderer.Initialize(device, deviceManager.ImmediateContext());
-    meshRenderer.SetModel(&models[AppSettings::CurrentScene]);
+    meshRenderer.SetModel(scenes[displayedScene].SceneModel.get());
     skybox.Initialize(device);
 
     envMap = LoadTexture(device, L"..\\Content\\EnvMaps\\Ennis.dds");
 
-    FileReadSerializer serializer(L"..\\Content\\EnvMaps\\Ennis.shdata");
-    SerializeItem(serializer, envMapSH);
+    SerializeFromChunkFile(L"..\\Content\\EnvMaps\\Ennis.shdata", SHDataVersion, envMapSH);
 
     // Load shaders
     for(uint32 msaaMode = 0; msaaMode < uint32(MSAAModes::NumValues); ++msaaMode)
@@ -253,18 +419,18 @@ void MSAAFilter::Update(const Timer& timer)
 
     deviceManager.SetNumVSYNCIntervals(AppSettings::DoubleSyncInterval ? 2 : 1);
 
-    if(AppSettings::CurrentScene.Changed())
-    {
-        meshRenderer.SetModel(&models[AppSettings::CurrentScene]);
-        AppSettings::ModelOrientation.SetValue(modelOrientations[AppSettings::CurrentScene]);
-    }
+    UpdateScenes();
 
     Quaternion orientation = AppSettings::ModelOrientation;
     orientation = orientation * Quaternion::FromAxisAngle(Float3(0.0f, 1.0f, 0.0f), AppSettings::ModelRotationSpeed * timer.DeltaSecondsF());
     AppSettings::ModelOrientation.SetValue(orientation);
 
-    modelTransform = orientation.ToFloat4x4() * Float4x4::ScaleMatrix(ModelScales[AppSettings::CurrentScene]);
-    modelTransform.SetTranslation(ModelPositions[AppSettings::CurrentScene]);
+    modelTransform = orientation.ToFloat4x4() * Float4x4::ScaleMatrix(ModelScales[displayedScene]);
+    modelTransform.SetTranslation(ModelPositions[displayedScene]);
+
+    // Pick a triangle with the middle mouse button
+    if(mouseState.MButton.RisingEdge && mouseState.IsOverWindow)
+        PickTriangle(mouseState);
 }
 
 void MSAAFilter::RenderAA()
@@ -366,6 +532,7 @@ void MSAAFilter::RenderScene()
 
     ID3D11RenderTargetView* renderTargets[2] = { nullptr, nullptr };
     context->OMSetRenderTargets(1, renderTargets, depthBuffer.DSView);
+    meshRenderer.CullMainView(camera, modelTransform);
     meshRenderer.RenderDepth(context, camera, modelTransform, false);
 
     meshRenderer.ReduceDepth(context, depthBuffer, camera);
@@ -452,6 +619,32 @@ void MSAAFilter::RenderHUD()
     vsyncText += deviceManager.VSYNCEnabled() ? L"Enabled" : L"Disabled";
     spriteRenderer.RenderText(font, vsyncText.c_str(), transform, XMFLOAT4(1, 1, 0, 1));
 
+    const SceneSlot& scene = scenes[displayedScene];
+    if(scene.CacheStatsAfter.ATVR > 0.0f)
+    {
+        transform._42 += 25.0f;
+        wstring cacheText(L"Vertex Cache ACMR: ");
+        cacheText += ToString(scene.CacheStatsBefore.ACMR) + L" -> " + ToString(scene.CacheStatsAfter.ACMR);
+        cacheText += L", ATVR: " + ToString(scene.CacheStatsBefore.ATVR) + L" -> " + ToString(scene.CacheStatsAfter.ATVR);
+        spriteRenderer.RenderText(font, cacheText.c_str(), transform, XMFLOAT4(1, 1, 0, 1));
+    }
+
+    if(pickResult.Valid)
+    {
+        transform._42 += 25.0f;
+        wstring pickText(L"Picked: Mesh ");
+        pickText += ToString(pickResult.MeshIdx) + L", Triangle " + ToString(pickResult.TriangleID);
+        pickText += L", Distance " + ToString(pickResult.Distance);
+        pickText += pickResult.Shadowed ? L" (Shadowed)" : L" (Lit)";
+        spriteRenderer.RenderText(font, pickText.c_str(), transform, XMFLOAT4(1, 1, 0, 1));
+    }
+
+    if(displayedScene != uint64(AppSettings::CurrentScene))
+    {
+        transform._42 += 25.0f;
+        spriteRenderer.RenderText(font, L"Loading scene...", transform, XMFLOAT4(1, 1, 0, 1));
+    }
+
     Profiler::GlobalProfiler.EndFrame(spriteRenderer, font);
 
     spriteRenderer.End();
@@ -14,6 +14,7 @@
 
 #include <App.h>
 #include <InterfacePointers.h>
+#include <Input.h>
 #include <Graphics\\Camera.h>
 #include <Graphics\\Model.h>
 #include <Graphics\\SpriteFont.h>
@@ -21,6 +22,7 @@
 #include <Graphics\\Skybox.h>
 #include <Graphics\\GraphicsTypes.h>
 #include <Graphics\\ShaderCompilation.h>
+#include <TaskScheduler.h>
 
 #include "PostProcessor.h"
 #include "MeshRenderer.h"
@@ -46,13 +48,42 @@ protected:
     RenderTarget2D velocityTarget;
     uint64 frameCount = 0;
 
-    // Model
-    Model models[uint64(Scenes::NumValues)];
+    // Scenes are preloaded in parallel at startup, and the least recently used ones are unloaded
+    // once the memory budget is exceeded. Unloaded scenes are loaded again when they're selected.
+    struct SceneSlot
+    {
+        std::unique_ptr<Model> SceneModel;
+        TaskHandle LoadTask;
+        bool Resident = false;
+        uint64 LastUsedFrame = 0;
+        uint64 MemorySize = 0;
+        VertexCacheStats CacheStatsBefore;
+        VertexCacheStats CacheStatsAfter;
+    };
+
+    SceneSlot scenes[uint64(Scenes::NumValues)];
+    uint64 displayedScene = 0;
     MeshRenderer meshRenderer;
 
     Float4x4 modelTransform;
     Quaternion modelOrientations[uint64(Scenes::NumValues)];
 
+    // The triangle that was last picked with the middle mouse button
+    struct PickResult
+    {
+        bool Valid = false;
+        uint64 MeshIdx = 0;
+        uint32 TriangleID = 0;
+        float Distance = 0.0f;
+        bool Shadowed = false;
+    };
+
+    PickResult pickResult;
+
+    // The scene and transform that the mesh BVHs were last refit to
+    uint64 bvhScene = uint64(-1);
+    Float4x4 bvhTransform;
+
     ID3D11ShaderResourceViewPtr envMap;
     SH9Color envMapSH;
 
@@ -91,6 +122,11 @@ protected:
 
     void CreateRenderTargets();
 
+    void StartSceneLoad(uint64 sceneIdx);
+    void FinishSceneLoad(uint64 sceneIdx);
+    void UpdateScenes();
+    void PickTriangle(const MouseState& mouseState);
+
     void RenderScene();
     void RenderBackgroundVelocity();
     void RenderAA();
@@ -30,6 +30,8 @@ cbuffer VSConstants : register(b0)
 	float4x4 View;
     float4x4 WorldViewProjection;
     float4x4 PrevWorldViewProjection;
+    float3 PositionScale;
+    float3 PositionOffset;
 }
 
 cbuffer PSConstants : register(b0)
@@ -65,6 +67,23 @@ SamplerState LinearSampler : register(s2);
 //=================================================================================================
 // Input/Output structs
 //=================================================================================================
+#if CompressedVertices_
+
+// Positions are quantized to the mesh bounds and have the bitangent sign in w, while normals and
+// tangents are octahedral-encoded
+struct VSInput
+{
+    float4 PositionOS 		    : POSITION;
+    float2 NormalOS 		    : NORMAL;
+
+    #if UseNormalMapping_
+        float2 UV               : TEXCOORD;
+        float2 TangentOS        : TANGENT;
+    #endif
+};
+
+#else
+
 struct VSInput
 {
     float3 PositionOS 		    : POSITION;
@@ -77,6 +96,8 @@ struct VSInput
     #endif
 };
 
+#endif
+
 struct VSOutput
 {
     float4 PositionCS 		    : SV_Position;
@@ -128,28 +149,56 @@ struct PSOutput
 //=================================================================================================
 // Vertex Shader
 //=================================================================================================
+
+//-------------------------------------------------------------------------------------------------
+// Decodes a unit vector that was encoded onto an unfolded octahedron
+//-------------------------------------------------------------------------------------------------
+float3 DecodeOctahedral(in float2 e)
+{
+    float3 v = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    if(v.z < 0.0f)
+        v.xy = (1.0f - abs(v.yx)) * (v.xy >= 0.0f ? 1.0f : -1.0f);
+    return normalize(v);
+}
+
 VSOutput VS(in VSInput input, in uint VertexID : SV_VertexID)
 {
     VSOutput output;
 
+    #if CompressedVertices_
+        float3 positionOS = input.PositionOS.xyz * PositionScale + PositionOffset;
+        float3 normalOS = DecodeOctahedral(input.NormalOS);
+        #if UseNormalMapping_
+            float3 tangentOS = DecodeOctahedral(input.TangentOS);
+            float3 bitangentOS = cross(normalOS, tangentOS) * (input.PositionOS.w * 2.0f - 1.0f);
+        #endif
+    #else
+        float3 positionOS = input.PositionOS;
+        float3 normalOS = input.NormalOS;
+        #if UseNormalMapping_
+            float3 tangentOS = input.TangentOS;
+            float3 bitangentOS = input.BitangentOS;
+        #endif
+    #endif
+
     // Calc the world-space position
-    output.PositionWS = mul(float4(input.PositionOS, 1.0f), World).xyz;
+    output.PositionWS = mul(float4(positionOS, 1.0f), World).xyz;
 
 	// Calc the view-space depth
 	output.DepthVS = mul(float4(output.PositionWS, 1.0f), View).z;
 
     // Calc the clip-space position
-    output.PositionCS = mul(float4(input.PositionOS, 1.0f), WorldViewProjection);
+    output.PositionCS = mul(float4(positionOS, 1.0f), WorldViewProjection);
 
 	// Rotate the normal into world space
-    output.NormalWS = normalize(mul(input.NormalOS, (float3x3)World));
+    output.NormalWS = normalize(mul(normalOS, (float3x3)World));
 
-    output.PrevPosition = mul(float4(input.PositionOS, 1.0f), PrevWorldViewProjection).xyw;
+    output.PrevPosition = mul(float4(positionOS, 1.0f), PrevWorldViewProjection).xyw;
 
     #if UseNormalMapping_
         output.UV = input.UV;
-        output.TangentWS = normalize(mul(input.TangentOS, (float3x3)World));
-        output.BitangentWS = normalize(mul(input.BitangentOS, (float3x3)World));
+        output.TangentWS = normalize(mul(tangentOS, (float3x3)World));
+        output.BitangentWS = normalize(mul(bitangentOS, (float3x3)World));
     #endif
 
     return output;
@@ -14,12 +14,14 @@
 
 #include <Exceptions.h>
 #include <Utility.h>
+#include <TaskScheduler.h>
 #include <Graphics\\ShaderCompilation.h>
 #include <App.h>
 #include <Graphics\\Textures.h>
 
 #include "AppSettings.h"
 #include "SharedConstants.h"
+#include "ShadowReference.h"
 
 // Constants
 static const float ShadowNearClip = 1.0f;
@@ -33,20 +35,33 @@ static const uint32 ShadowMapSize = 1024;
 static const uint32 ShadowMSAASamples = 4;
 static const uint32 ShadowAnisotropy = 16;
 static const bool EnableShadowMips = true;
+static const uint64 DepthBoundsBatchSize = 4096;
+static const uint64 InvalidReadbackFrame = uint64(-1);
+static const float CascadeRefitEpsilon = 0.0001f;
+static const float DepthBoundsPadding = 0.01f;
+static const float EVSMValidationTolerance = 0.001f;
+static const float EVSMValidationFloor = 0.000001f;
+static const float DepthReductionValidationTolerance = 2.0f / 0xFFFF;
+static const float MinOccluderRadius = 8.0f;
 
 void MeshRenderer::LoadShaders()
 {
     // Load the mesh shaders
-    meshDepthVS = CompileVSFromFile(device, L"DepthOnly.hlsl", "VS", "vs_5_0");
-
     CompileOptions opts;
-    opts.Add("UseNormalMapping_", 0);
-
-    meshVS[0] = CompileVSFromFile(device, L"Mesh.hlsl", "VS", "vs_5_0", opts);
+    for(uint32 compressedVertices = 0; compressedVertices < 2; ++compressedVertices)
+    {
+        opts.Reset();
+        opts.Add("CompressedVertices_", compressedVertices);
+        meshDepthVS[compressedVertices] = CompileVSFromFile(device, L"DepthOnly.hlsl", "VS", "vs_5_0", opts);
 
-    opts.Reset();
-    opts.Add("UseNormalMapping_", 1);
-    meshVS[1] = CompileVSFromFile(device, L"Mesh.hlsl", "VS", "vs_5_0", opts);
+        for(uint32 useNormalMapping = 0; useNormalMapping < 2; ++useNormalMapping)
+        {
+            opts.Reset();
+            opts.Add("UseNormalMapping_", useNormalMapping);
+            opts.Add("CompressedVertices_", compressedVertices);
+            meshVS[useNormalMapping][compressedVertices] = CompileVSFromFile(device, L"Mesh.hlsl", "VS", "vs_5_0", opts);
+        }
+    }
 
     for(uint32 useNormalMapping = 0; useNormalMapping < 2; ++useNormalMapping)
     {
@@ -86,6 +101,13 @@ void MeshRenderer::LoadShaders()
     depthReductionInitialCS[1] = CompileCSFromFile(device, L"DepthReduction.hlsl", "DepthReductionInitialCS", "cs_5_0", opts);
 
     depthReductionCS = CompileCSFromFile(device, L"DepthReduction.hlsl", "DepthReductionCS");
+
+    for(uint32 msaa = 0; msaa < 2; ++msaa)
+    {
+        opts.Reset();
+        opts.Add("MSAA_", msaa);
+        copyDepthSamplesCS[msaa] = CompileCSFromFile(device, L"DepthReduction.hlsl", "CopyDepthSamplesCS", "cs_5_0", opts);
+    }
 }
 
 void MeshRenderer::CreateShadowMaps()
@@ -111,20 +133,153 @@ void MeshRenderer::SetModel(const Model* model)
     meshInputLayouts.clear();
     meshDepthInputLayouts.clear();
 
-    VertexShaderPtr vs = AppSettings::UseNormalMapping() ? meshVS[1] : meshVS[0];
+    const uint64 nmlMapIdx = AppSettings::UseNormalMapping() ? 1 : 0;
 
     for(uint64 i = 0; i < model->Meshes().size(); ++i)
     {
         const Mesh& mesh = model->Meshes()[i];
+        const uint64 compressedIdx = mesh.CompressedVertices() ? 1 : 0;
+
+        VertexShaderPtr vs = meshVS[nmlMapIdx][compressedIdx];
         ID3D11InputLayoutPtr inputLayout;
         DXCall(device->CreateInputLayout(mesh.InputElements(), mesh.NumInputElements(),
                vs->ByteCode->GetBufferPointer(), vs->ByteCode->GetBufferSize(), &inputLayout));
         meshInputLayouts.push_back(inputLayout);
 
+        VertexShaderPtr depthVS = meshDepthVS[compressedIdx];
         DXCall(device->CreateInputLayout(mesh.InputElements(), mesh.NumInputElements(),
-               meshDepthVS->ByteCode->GetBufferPointer(), meshDepthVS->ByteCode->GetBufferSize(), &inputLayout));
+               depthVS->ByteCode->GetBufferPointer(), depthVS->ByteCode->GetBufferSize(), &inputLayout));
         meshDepthInputLayouts.push_back(inputLayout);
     }
+
+    ComputePartBounds();
+
+    for(uint32 i = 0; i < NumCascades; ++i)
+        cascades[i].Rendered = false;
+}
+
+// Gathers the bounds of each mesh part, along with the unique positions referenced by the part
+// and the ranges of the part's meshlets and LODs
+void MeshRenderer::ComputePartBounds()
+{
+    partBounds.clear();
+    partPositionsX.clear();
+    partPositionsY.clear();
+    partPositionsZ.clear();
+    partCentersX.clear();
+    partCentersY.clear();
+    partCentersZ.clear();
+    partExtentsX.clear();
+    partExtentsY.clear();
+    partExtentsZ.clear();
+    partRadii.clear();
+
+    std::vector<uint64> vertexMarkers;
+    for(uint64 meshIdx = 0; meshIdx < model->Meshes().size(); ++meshIdx)
+    {
+        const Mesh& mesh = model->Meshes()[meshIdx];
+        const uint8* vertices = mesh.Vertices();
+        const uint32 stride = mesh.VertexStride();
+        const uint16* indices16 = reinterpret_cast<const uint16*>(mesh.Indices());
+        const uint32* indices32 = reinterpret_cast<const uint32*>(mesh.Indices());
+        const bool use32BitIndices = mesh.IndexBufferType() == IndexType::Index32Bit;
+
+        vertexMarkers.assign(mesh.NumVertices(), uint64(-1));
+
+        // The meshlets and LODs are sorted by part
+        const std::vector<Meshlet>& meshlets = mesh.Meshlets();
+        const std::vector<MeshLOD>& lods = mesh.LODs();
+        uint32 meshletIdx = 0;
+        uint32 lodIdx = 0;
+
+        for(uint64 partIdx = 0; partIdx < mesh.MeshParts().size(); ++partIdx)
+        {
+            const MeshPart& part = mesh.MeshParts()[partIdx];
+
+            PartBounds bounds;
+            bounds.MeshIdx = uint32(meshIdx);
+            bounds.MeshPartIdx = uint32(partIdx);
+            bounds.PositionStart = partPositionsX.size();
+
+            bounds.MeshletStart = meshletIdx;
+            while(meshletIdx < meshlets.size() && meshlets[meshletIdx].PartIdx == partIdx)
+                ++meshletIdx;
+            bounds.NumMeshlets = meshletIdx - bounds.MeshletStart;
+
+            bounds.LODStart = lodIdx;
+            while(lodIdx < lods.size() && lods[lodIdx].PartIdx == partIdx)
+                ++lodIdx;
+            bounds.NumLODs = lodIdx - bounds.LODStart;
+
+            XMVECTOR mins = XMVectorReplicate(REAL_MAX);
+            XMVECTOR maxes = XMVectorReplicate(-REAL_MAX);
+            for(uint32 i = 0; i < part.IndexCount; ++i)
+            {
+                const uint32 idx = use32BitIndices ? indices32[part.IndexStart + i] : indices16[part.IndexStart + i];
+                if(vertexMarkers[idx] == partIdx)
+                    continue;
+                vertexMarkers[idx] = partIdx;
+
+                const Float3& position = *reinterpret_cast<const Float3*>(vertices + idx * stride);
+                partPositionsX.push_back(position.x);
+                partPositionsY.push_back(position.y);
+                partPositionsZ.push_back(position.z);
+
+                mins = XMVectorMin(mins, position.ToSIMD());
+                maxes = XMVectorMax(maxes, position.ToSIMD());
+            }
+
+            bounds.NumPositions = partPositionsX.size() - bounds.PositionStart;
+
+            // Use the bounds that were computed or loaded with the mesh when it has them
+            float radius = 0.0f;
+            if(partIdx < mesh.PartBounds().size())
+            {
+                const MeshPartBounds& meshBounds = mesh.PartBounds()[partIdx];
+                bounds.Min = meshBounds.Min;
+                bounds.Max = meshBounds.Max;
+                radius = meshBounds.SphereRadius;
+            }
+            else
+            {
+                bounds.Min = mins;
+                bounds.Max = maxes;
+                radius = Float3::Length((bounds.Max - bounds.Min) * 0.5f);
+            }
+
+            const Float3 center = (bounds.Min + bounds.Max) * 0.5f;
+            const Float3 extents = (bounds.Max - bounds.Min) * 0.5f;
+            partCentersX.push_back(center.x);
+            partCentersY.push_back(center.y);
+            partCentersZ.push_back(center.z);
+            partExtentsX.push_back(extents.x);
+            partExtentsY.push_back(extents.y);
+            partExtentsZ.push_back(extents.z);
+            partRadii.push_back(radius);
+
+            // Pad to a full SIMD batch by repeating the first position
+            while(bounds.NumPositions > 0 && partPositionsX.size() % 4 != 0)
+            {
+                partPositionsX.push_back(partPositionsX[bounds.PositionStart]);
+                partPositionsY.push_back(partPositionsY[bounds.PositionStart]);
+                partPositionsZ.push_back(partPositionsZ[bounds.PositionStart]);
+            }
+
+            partBounds.push_back(bounds);
+        }
+    }
+
+    // Pad the SoA bounds to a full SIMD batch. The padding is never read back.
+    while(partCentersX.size() % 4 != 0)
+    {
+        partCentersX.push_back(0.0f);
+        partCentersY.push_back(0.0f);
+        partCentersZ.push_back(0.0f);
+        partExtentsX.push_back(0.0f);
+        partExtentsY.push_back(0.0f);
+        partExtentsZ.push_back(0.0f);
+        partRadii.push_back(0.0f);
+    }
 }
 
 // Loads resources
@@ -153,8 +308,11 @@ void MeshRenderer::Initialize(ID3D11Device* device, ID3D11DeviceContext* context
     DXCall(device->CreateSamplerState(&sampDesc, &evsmSampler));
 
     // Create the staging textures for reading back the reduced depth buffer
-    for(uint32 i = 0; i < ReadbackLatency; ++i)
+    for(uint32 i = 0; i < MaxReadbackLatency; ++i)
+    {
         reductionStagingTextures[i].Initialize(device, 1, 1, DXGI_FORMAT_R16G16_UNORM);
+        reductionReadbackFrames[i] = InvalidReadbackFrame;
+    }
 
     specularLookupTexture = LoadTexture(device, L"..\\Content\\Textures\\SpecularLookup.dds");
 
@@ -253,58 +411,434 @@ void MeshRenderer::ReduceDepth(ID3D11DeviceContext* context, DepthStencilBuffer&
         context->CSSetShaderResources(0, 1, srvs);
     }
 
-    // Copy to a staging texture
-    ID3D11Texture2D* lastTarget = depthReductionTargets[depthReductionTargets.size() - 1].Texture;
-    context->CopyResource(reductionStagingTextures[currFrame % ReadbackLatency].Texture, lastTarget);
-
-    ++currFrame;
+    // Start over if the size of the ring changed. With only one slot the copy would overwrite the
+    // previous frame's result before the GPU is done with it, so there's always at least two.
+    const uint32 latency = Clamp<uint32>(AppSettings::DepthReadbackLatency, 2, MaxReadbackLatency);
+    if(latency != readbackLatency)
+    {
+        for(uint32 i = 0; i < MaxReadbackLatency; ++i)
+            reductionReadbackFrames[i] = InvalidReadbackFrame;
+        readbackLatency = latency;
+    }
 
-    if(currFrame >= ReadbackLatency)
+    // Poll the ring for the most recent result that the GPU has finished with, without waiting.
+    // If nothing is ready we keep using the last good value.
+    for(uint32 i = 1; i <= readbackLatency; ++i)
     {
-        StagingTexture2D& stagingTexture = reductionStagingTextures[currFrame % ReadbackLatency];
+        if(currFrame < i)
+            break;
 
+        const uint64 frame = currFrame - i;
+        const uint32 slot = frame % readbackLatency;
+        if(reductionReadbackFrames[slot] != frame || frame < lastReadbackFrame)
+            continue;
+
+        StagingTexture2D& stagingTexture = reductionStagingTextures[slot];
         uint32 pitch;
-        const uint16* texData = reinterpret_cast<uint16*>(stagingTexture.Map(context, 0, pitch));
+        const uint16* texData = reinterpret_cast<uint16*>(stagingTexture.TryMap(context, 0, pitch));
+        if(texData == nullptr)
+            continue;
+
         shadowDepthBounds.x = texData[0] / static_cast<float>(0xffff);
         shadowDepthBounds.y = texData[1] / static_cast<float>(0xffff);
-
         stagingTexture.Unmap(context, 0);
+
+        reductionReadbackFrames[slot] = InvalidReadbackFrame;
+        lastReadbackFrame = frame;
+        break;
     }
-    else
+
+    // Copy to a staging texture
+    const uint32 slot = currFrame % readbackLatency;
+    ID3D11Texture2D* lastTarget = depthReductionTargets[depthReductionTargets.size() - 1].Texture;
+    context->CopyResource(reductionStagingTextures[slot].Texture, lastTarget);
+    reductionReadbackFrames[slot] = currFrame;
+
+    if(AppSettings::ValidateDepthReduction)
+        ValidateDepthReduction(context, depthBuffer, camera, reductionStagingTextures[slot]);
+
+    ++currFrame;
+}
+
+// Waits for this frame's GPU depth reduction, and compares it with the CPU version. The staging
+// texture is only read, so the ring still picks up the result as usual.
+void MeshRenderer::ValidateDepthReduction(ID3D11DeviceContext* context, DepthStencilBuffer& depthBuffer,
+                                          const Camera& camera, StagingTexture2D& stagingTexture)
+{
+    PIXEvent event(L"Depth Reduction Validation");
+
+    TextureData<float> depthSamples;
+    ReadDepthSamples(context, depthBuffer, depthSamples);
+    const Float2 cpuBounds = ShadowReference::ReduceDepth(depthSamples, camera.ProjectionMatrix(),
+                                                          camera.NearClip(), camera.FarClip());
+
+    uint32 pitch = 0;
+    const uint16* texData = reinterpret_cast<const uint16*>(stagingTexture.Map(context, 0, pitch));
+    const Float2 gpuBounds = Float2(texData[0] / static_cast<float>(0xffff), texData[1] / static_cast<float>(0xffff));
+    stagingTexture.Unmap(context, 0);
+
+    AssertMsg_(std::abs(gpuBounds.x - cpuBounds.x) <= DepthReductionValidationTolerance
+               && std::abs(gpuBounds.y - cpuBounds.y) <= DepthReductionValidationTolerance,
+               "CPU depth bounds (%f, %f) don't match the GPU depth bounds (%f, %f)",
+               cpuBounds.x, cpuBounds.y, gpuBounds.x, gpuBounds.y);
+}
+
+// Returns the min and max view-space Z of a range of SoA positions, 4 at a time
+static Float2 ComputeViewZRange(const float* posX, const float* posY, const float* posZ,
+                                uint64 numPositions, Float3 zAxis, float zOffset)
+{
+    const XMVECTOR axisX = XMVectorReplicate(zAxis.x);
+    const XMVECTOR axisY = XMVectorReplicate(zAxis.y);
+    const XMVECTOR axisZ = XMVectorReplicate(zAxis.z);
+    const XMVECTOR offset = XMVectorReplicate(zOffset);
+
+    XMVECTOR mins = XMVectorReplicate(REAL_MAX);
+    XMVECTOR maxes = XMVectorReplicate(-REAL_MAX);
+    for(uint64 i = 0; i < numPositions; i += 4)
     {
-        shadowDepthBounds = Float2(0.0f, 1.0f);
+        XMVECTOR viewZ = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(posX + i)), axisX, offset);
+        viewZ = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(posY + i)), axisY, viewZ);
+        viewZ = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(posZ + i)), axisZ, viewZ);
+        mins = XMVectorMin(mins, viewZ);
+        maxes = XMVectorMax(maxes, viewZ);
     }
+
+    Float4 minZ = mins;
+    Float4 maxZ = maxes;
+    return Float2(std::min(std::min(minZ.x, minZ.y), std::min(minZ.z, minZ.w)),
+                  std::max(std::max(maxZ.x, maxZ.y), std::max(maxZ.z, maxZ.w)));
 }
 
-// Computes shadow depth bounds on the CPU using the mesh vertex positions
-void MeshRenderer::ComputeShadowDepthBounds(const Camera& camera)
+// Computes shadow depth bounds on the CPU using the mesh vertex positions. Parts whose AABB lies
+// within the depth range of the other parts are skipped, and the rest have their vertices
+// transformed in SoA batches spread across multiple threads.
+void MeshRenderer::ComputeShadowDepthBounds(const Camera& camera, const Float4x4& world)
 {
-    Float4x4 viewMatrix = camera.ViewMatrix();
+    const Float4x4 worldView = world * camera.ViewMatrix();
     const float nearClip = camera.NearClip();
     const float farClip = camera.FarClip();
     const float clipDist = farClip - nearClip;
 
-    float minDepth = 1.0f;
-    float maxDepth = 0.0f;
-    const uint64 numMeshes = model->Meshes().size();
-    for(uint64 meshIdx = 0; meshIdx < numMeshes; ++meshIdx)
+    // View-space Z is linear in the object-space position, so we only need the third column
+    const Float3 zAxis = Float3(worldView._13, worldView._23, worldView._33);
+    const float zOffset = worldView._43;
+
+    // Get a conservative Z range for each part from its AABB corners
+    const uint64 numParts = partBounds.size();
+    std::vector<Float2> partZRanges(numParts);
+    uint64 nearestPart = uint64(-1);
+    uint64 furthestPart = uint64(-1);
+    for(uint64 partIdx = 0; partIdx < numParts; ++partIdx)
     {
-        const Mesh& mesh = model->Meshes()[meshIdx];
-        const uint64 numVerts = mesh.NumVertices();
-        const uint64 stride = mesh.VertexStride();
-        const uint8* vertices = mesh.Vertices();
-        for(uint64 i = 0; i < numVerts; ++i)
+        const PartBounds& bounds = partBounds[partIdx];
+        if(bounds.NumPositions == 0)
+            continue;
+
+        Float2 zRange = Float2(zOffset, zOffset);
+        for(uint32 axis = 0; axis < 3; ++axis)
+        {
+            const float a = zAxis[axis] * bounds.Min[axis];
+            const float b = zAxis[axis] * bounds.Max[axis];
+            zRange.x += std::min(a, b);
+            zRange.y += std::max(a, b);
+        }
+        partZRanges[partIdx] = zRange;
+
+        if(nearestPart == uint64(-1) || zRange.x < partZRanges[nearestPart].x)
+            nearestPart = partIdx;
+        if(furthestPart == uint64(-1) || zRange.y > partZRanges[furthestPart].y)
+            furthestPart = partIdx;
+    }
+
+    if(nearestPart == uint64(-1))
+    {
+        shadowDepthBounds = Float2(1.0f, 0.0f);
+        return;
+    }
+
+    auto transformPart = [&](uint64 partIdx, uint64 start, uint64 count)
+    {
+        const uint64 offset = partBounds[partIdx].PositionStart + start;
+        return ComputeViewZRange(&partPositionsX[offset], &partPositionsY[offset], &partPositionsZ[offset],
+                                 count, zAxis, zOffset);
+    };
+
+    // Start with tight bounds for the parts that reach the furthest in each direction
+    Float2 zBounds = transformPart(nearestPart, 0, partBounds[nearestPart].NumPositions);
+    if(furthestPart != nearestPart)
+    {
+        const Float2 furthestRange = transformPart(furthestPart, 0, partBounds[furthestPart].NumPositions);
+        zBounds.x = std::min(zBounds.x, furthestRange.x);
+        zBounds.y = std::max(zBounds.y, furthestRange.y);
+    }
+
+    // Parts that are fully enclosed by the current bounds can't extend them, so only the
+    // remaining parts need their vertices transformed
+    struct Batch
+    {
+        uint64 PartIdx;
+        uint64 Start;
+        uint64 Count;
+    };
+
+    std::vector<Batch> batches;
+    for(uint64 partIdx = 0; partIdx < numParts; ++partIdx)
+    {
+        const PartBounds& bounds = partBounds[partIdx];
+        if(bounds.NumPositions == 0 || partIdx == nearestPart || partIdx == furthestPart)
+            continue;
+        if(partZRanges[partIdx].x >= zBounds.x && partZRanges[partIdx].y <= zBounds.y)
+            continue;
+
+        for(uint64 start = 0; start < bounds.NumPositions; start += DepthBoundsBatchSize)
+            batches.push_back({ partIdx, start, std::min(bounds.NumPositions - start, DepthBoundsBatchSize) });
+    }
+
+    std::vector<Float2> batchRanges(batches.size());
+    ParallelFor(batches.size(), 1, [&](uint64 start, uint64 end)
+    {
+        for(uint64 batchIdx = start; batchIdx < end; ++batchIdx)
+        {
+            const Batch& batch = batches[batchIdx];
+            batchRanges[batchIdx] = transformPart(batch.PartIdx, batch.Start, batch.Count);
+        }
+    });
+
+    for(uint64 batchIdx = 0; batchIdx < batches.size(); ++batchIdx)
+    {
+        zBounds.x = std::min(zBounds.x, batchRanges[batchIdx].x);
+        zBounds.y = std::max(zBounds.y, batchRanges[batchIdx].y);
+    }
+
+    shadowDepthBounds.x = Saturate((zBounds.x - nearClip) / clipDist);
+    shadowDepthBounds.y = Saturate((zBounds.y - nearClip) / clipDist);
+}
+
+// Returns the number of pixels covered by an object-space unit at the closest point on the
+// part's AABB, or REAL_MAX if the view position is inside of the AABB
+float MeshRenderer::PixelsPerUnit(const PartBounds& bounds, const LODMetric& metric) const
+{
+    if(metric.Orthographic)
+        return metric.ErrorScale;
+
+    const XMVECTOR viewPos = metric.ViewPosition.ToSIMD();
+    const XMVECTOR closest = XMVectorClamp(viewPos, bounds.Min.ToSIMD(), bounds.Max.ToSIMD());
+    const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(viewPos, closest)));
+    if(distance <= 0.0f)
+        return REAL_MAX;
+
+    return metric.ErrorScale / distance;
+}
+
+// Picks the least detailed LOD of a part whose error is below the threshold in pixels. Returns 0
+// for the full-detail part.
+uint32 MeshRenderer::SelectLOD(const PartBounds& bounds, const LODMetric& metric) const
+{
+    const float threshold = AppSettings::LODErrorThreshold;
+    if(bounds.NumLODs == 0 || threshold <= 0.0f)
+        return 0;
+
+    const float pixelsPerUnit = PixelsPerUnit(bounds, metric);
+    if(pixelsPerUnit == REAL_MAX)
+        return 0;
+
+    const Mesh& mesh = model->Meshes()[bounds.MeshIdx];
+    uint32 lodIdx = 0;
+    while(lodIdx < bounds.NumLODs && mesh.LODs()[bounds.LODStart + lodIdx].Error * pixelsPerUnit <= threshold)
+        ++lodIdx;
+
+    return lodIdx;
+}
+
+// Rasterizes the parts that passed the volume test and that are large enough in the occlusion
+// buffer to hide other parts. Occluders use the least detailed LOD whose error is below the
+// threshold at the resolution of the buffer. Returns the largest object-space error of the
+// occluders, since the simplified occluders can be in front of the full-detail parts.
+float MeshRenderer::RasterizeOccluders(const std::vector<uint8>& partVisible, const LODMetric& lodMetric,
+                                       const OcclusionView& occlusion) const
+{
+    LODMetric occluderMetric = lodMetric;
+    occluderMetric.ErrorScale *= occlusion.ResolutionScale;
+
+    std::vector<Occluder> occluders;
+    float maxError = 0.0f;
+    for(uint64 boundsIdx = 0; boundsIdx < partBounds.size(); ++boundsIdx)
+    {
+        const PartBounds& bounds = partBounds[boundsIdx];
+        if(bounds.NumPositions == 0 || partVisible[boundsIdx] == 0)
+            continue;
+
+        if(PixelsPerUnit(bounds, occluderMetric) * partRadii[boundsIdx] < MinOccluderRadius)
+            continue;
+
+        const Mesh& mesh = model->Meshes()[bounds.MeshIdx];
+        const MeshPart& part = mesh.MeshParts()[bounds.MeshPartIdx];
+
+        Occluder occluder;
+        occluder.Positions = mesh.Vertices();
+        occluder.PositionStride = mesh.VertexStride();
+        occluder.Indices = mesh.Indices();
+        occluder.IndexSize = mesh.IndexSize();
+        occluder.IndexStart = part.IndexStart;
+        occluder.IndexCount = part.IndexCount;
+
+        const uint32 lodIdx = SelectLOD(bounds, occluderMetric);
+        if(lodIdx > 0)
         {
-            const Float3& position = *reinterpret_cast<const Float3*>(vertices);
-            float viewSpaceZ = Float3::Transform(position, viewMatrix).z;
-            float depth = Saturate((viewSpaceZ - nearClip) / clipDist);
-            minDepth = std::min(minDepth, depth);
-            maxDepth = std::max(maxDepth, depth);
-            vertices += stride;
+            const MeshLOD& lod = mesh.LODs()[bounds.LODStart + lodIdx - 1];
+            occluder.IndexStart = lod.IndexStart;
+            occluder.IndexCount = lod.IndexCount;
+            maxError = std::max(maxError, lod.Error);
         }
+
+        occluders.push_back(occluder);
     }
 
-    shadowDepthBounds = Float2(minDepth, maxDepth);
+    // Shadow maps are rendered without back-face culling or depth clipping
+    occlusion.Buffer->Rasterize(occlusion.WorldViewProjection, occluders.data(), occluders.size(),
+                                occlusion.ShadowRendering == false, occlusion.ShadowRendering);
+
+    return maxError;
+}
+
+// Culls the part bounds against the volume and the occluders, and then either selects a simplified
+// LOD for the part or culls its meshlets. Adjacent visible meshlets are merged into a single range
+// so that they can be drawn together.
+void MeshRenderer::CullParts(const CullVolume& volume, const LODMetric& lodMetric, const OcclusionView& occlusion,
+                             std::vector<DrawRange>& drawList) const
+{
+    drawList.clear();
+
+    // Test the bounds of all parts against the volume 4 at a time
+    std::vector<uint8> partVisible(partCentersX.size());
+    BoundsVisibleSoA(volume, partCentersX.data(), partCentersY.data(), partCentersZ.data(), partExtentsX.data(),
+                     partExtentsY.data(), partExtentsZ.data(), partRadii.data(), partVisible.size(), partVisible.data());
+
+    float occluderError = 0.0f;
+    if(occlusion.Buffer != nullptr)
+        occluderError = RasterizeOccluders(partVisible, lodMetric, occlusion);
+
+    const bool cullMeshlets = AppSettings::MeshletCulling;
+    for(uint64 boundsIdx = 0; boundsIdx < partBounds.size(); ++boundsIdx)
+    {
+        const PartBounds& bounds = partBounds[boundsIdx];
+        if(bounds.NumPositions == 0 || partVisible[boundsIdx] == 0)
+            continue;
+
+        if(occlusion.Buffer != nullptr)
+        {
+            const Float3 padding = Float3(occluderError);
+            if(occlusion.Buffer->BoundsVisible(bounds.Min - padding, bounds.Max + padding) == false)
+                continue;
+        }
+
+        const Mesh& mesh = model->Meshes()[bounds.MeshIdx];
+        const MeshPart& part = mesh.MeshParts()[bounds.MeshPartIdx];
+
+        DrawRange range;
+        range.MeshIdx = bounds.MeshIdx;
+        range.PartIdx = bounds.MeshPartIdx;
+
+        const uint32 lodIdx = SelectLOD(bounds, lodMetric);
+        if(lodIdx > 0)
+        {
+            const MeshLOD& lod = mesh.LODs()[bounds.LODStart + lodIdx - 1];
+            range.IndexStart = lod.IndexStart;
+            range.IndexCount = lod.IndexCount;
+            drawList.push_back(range);
+            continue;
+        }
+
+        if(cullMeshlets == false || bounds.NumMeshlets == 0)
+        {
+            range.IndexStart = part.IndexStart;
+            range.IndexCount = part.IndexCount;
+            drawList.push_back(range);
+            continue;
+        }
+
+        for(uint32 meshletIdx = bounds.MeshletStart; meshletIdx < bounds.MeshletStart + bounds.NumMeshlets; ++meshletIdx)
+        {
+            const Meshlet& meshlet = mesh.Meshlets()[meshletIdx];
+            if(MeshletVisible(volume, meshlet) == false)
+                continue;
+
+            if(range.IndexCount > 0 && range.IndexStart + range.IndexCount == meshlet.IndexStart)
+            {
+                range.IndexCount += meshlet.IndexCount;
+                continue;
+            }
+
+            if(range.IndexCount > 0)
+                drawList.push_back(range);
+            range.IndexStart = meshlet.IndexStart;
+            range.IndexCount = meshlet.IndexCount;
+        }
+
+        if(range.IndexCount > 0)
+            drawList.push_back(range);
+    }
+}
+
+// Culls the meshlets against the camera frustum, and culls the ones that are entirely back-facing.
+// The culling happens in object space, so the camera position is transformed by the inverse of
+// the world matrix. LODs are selected by their projected error in pixels. The resulting draw list
+// is used for both the depth prepass and the main pass, so the occluders are only rasterized once
+// per frame.
+void MeshRenderer::CullMainView(const Camera& camera, const Float4x4& world)
+{
+    const Float4x4 worldViewProjection = world * camera.ViewProjectionMatrix();
+    const Float3 cameraPosOS = Float3::Transform(camera.Position(), Float4x4::Invert(world));
+    const CullVolume volume = FrustumCullVolume(worldViewProjection, cameraPosOS);
+
+    const float backBufferHeight = float(GlobalApp->DeviceManager().BackBufferHeight());
+    LODMetric lodMetric;
+    lodMetric.ViewPosition = cameraPosOS;
+    lodMetric.ErrorScale = camera.ProjectionMatrix()._22 * 0.5f * backBufferHeight;
+
+    OcclusionView occlusion;
+    if(AppSettings::OcclusionCulling)
+    {
+        occlusion.Buffer = &mainOcclusionBuffer;
+        occlusion.WorldViewProjection = worldViewProjection;
+        occlusion.ResolutionScale = OcclusionBuffer::Height / backBufferHeight;
+    }
+
+    CullParts(volume, lodMetric, occlusion, mainDrawList);
+}
+
+// Culls the mesh parts and meshlets against a shadow cascade, and outputs the index ranges that
+// can cast shadows into it. The cascade volume is extruded towards the light, so only the far
+// plane is tested along the light direction. Back-facing meshlets still cast shadows, so the
+// normal cones aren't used. Occlusion culling happens from the light's point of view, since a
+// caster that's hidden from the camera can still cast a visible shadow. A caster that's hidden
+// from the light behind other casters doesn't change the nearest depths in the shadow map.
+void MeshRenderer::CullShadowCasters(const OrthographicCamera& shadowCamera, const Float4x4& world,
+                                     OcclusionBuffer* occlusionBuffer, std::vector<DrawRange>& drawList) const
+{
+    const Float4 lightPlanes[5] =
+    {
+        Float4(1.0f, 0.0f, 0.0f, -shadowCamera.MinX()),
+        Float4(-1.0f, 0.0f, 0.0f, shadowCamera.MaxX()),
+        Float4(0.0f, 1.0f, 0.0f, -shadowCamera.MinY()),
+        Float4(0.0f, -1.0f, 0.0f, shadowCamera.MaxY()),
+        Float4(0.0f, 0.0f, -1.0f, shadowCamera.FarClip()),
+    };
+
+    const CullVolume volume = ViewSpaceCullVolume(lightPlanes, 5, world * shadowCamera.ViewMatrix());
+
+    // The projection is orthographic, so a LOD's error is scaled by the size of a shadow map texel
+    LODMetric lodMetric;
+    lodMetric.ErrorScale = Float3::Length(world.Right()) * ShadowMapSize / (shadowCamera.MaxY() - shadowCamera.MinY());
+    lodMetric.Orthographic = true;
+
+    OcclusionView occlusion;
+    occlusion.Buffer = occlusionBuffer;
+    occlusion.WorldViewProjection = world * shadowCamera.ViewProjectionMatrix();
+    occlusion.ResolutionScale = float(OcclusionBuffer::Height) / ShadowMapSize;
+    occlusion.ShadowRendering = true;
+
+    CullParts(volume, lodMetric, occlusion, drawList);
 }
 
 // Convert to an EVSM map
@@ -398,9 +932,97 @@ void MeshRenderer::ConvertToEVSM(ID3D11DeviceContext* context, uint32 cascadeIdx
         srvs[0] = NULL;
         context->PSSetShaderResources(0, 1, srvs);
     }
+}
 
-    if(EnableShadowMips && cascadeIdx == NumCascades - 1)
-        context->GenerateMips(varianceShadowMap.SRView);
+// Reads back every sample of a depth buffer, with one slice per MSAA sample. This waits for the
+// GPU, so it's only used for validating against the CPU reference implementations.
+void MeshRenderer::ReadDepthSamples(ID3D11DeviceContext* context, DepthStencilBuffer& depthBuffer,
+                                    TextureData<float>& samples)
+{
+    const uint32 numSamples = std::max<uint32>(depthBuffer.MultiSamples, 1);
+    const uint32 width = depthBuffer.Width;
+    const uint32 height = depthBuffer.Height;
+
+    RenderTarget2D sampleTarget;
+    sampleTarget.Initialize(device, width, height, DXGI_FORMAT_R32_FLOAT, 1, 1, 0, false, true, numSamples);
+
+    reductionConstants.Data.TextureSize.x = width;
+    reductionConstants.Data.TextureSize.y = height;
+    reductionConstants.Data.NumSamples = numSamples;
+    reductionConstants.ApplyChanges(context);
+    reductionConstants.SetCS(context, 0);
+
+    SetCSInputs(context, depthBuffer.SRView);
+    SetCSOutputs(context, sampleTarget.UAView);
+    SetCSShader(context, copyDepthSamplesCS[numSamples > 1 ? 1 : 0]);
+    context->Dispatch(DispatchSize(ReductionTGSize, width), DispatchSize(ReductionTGSize, height), 1);
+    ClearCSInputs(context);
+    ClearCSOutputs(context);
+
+    StagingTexture2D stagingTexture;
+    stagingTexture.Initialize(device, width, height, DXGI_FORMAT_R32_FLOAT, 1, 1, 0, numSamples);
+    context->CopyResource(stagingTexture.Texture, sampleTarget.Texture);
+
+    samples.Init(width, height, numSamples);
+    for(uint32 sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+    {
+        uint32 pitch = 0;
+        const uint8* srcData = reinterpret_cast<const uint8*>(stagingTexture.Map(context, sampleIdx, pitch));
+        float* dstData = &samples.Texels[uint64(sampleIdx) * width * height];
+        for(uint32 y = 0; y < height; ++y)
+            memcpy(dstData + y * width, srcData + y * pitch, width * sizeof(float));
+        stagingTexture.Unmap(context, sampleIdx);
+    }
+}
+
+// Converts and blurs the depth of the cascades that were rendered this frame on the CPU, and
+// compares the results with mip 0 of the GPU EVSM map
+void MeshRenderer::ValidateEVSM(const std::vector<uint32>& cascadeIndices,
+                                const std::vector<TextureData<float>>& cascadeDepths)
+{
+    PIXEvent event(L"EVSM Validation");
+
+    const uint32 numCascades = uint32(cascadeIndices.size());
+    if(numCascades == 0)
+        return;
+
+    TextureData<Float4> gpuEVSM;
+    GetTextureData(device, varianceShadowMap.SRView, gpuEVSM);
+
+    ShadowReference::EVSMParams params;
+    params.PositiveExponent = PositiveExponent;
+    params.NegativeExponent = NegativeExponent;
+    params.FilterSize = FilterSize;
+    params.SampleRadius = SampleRadius;
+
+    std::vector<Float3> cascadeScales(numCascades);
+    for(uint32 i = 0; i < numCascades; ++i)
+        cascadeScales[i] = meshPSConstants.Data.CascadeScales[cascadeIndices[i]].To3D();
+
+    std::vector<TextureData<Float4>> cpuEVSM(numCascades);
+    ShadowReference::ProcessEVSMCascades(cascadeDepths.data(), cascadeScales.data(), numCascades, params,
+                                         cpuEVSM.data());
+
+    const uint64 sliceSize = uint64(gpuEVSM.Width) * gpuEVSM.Height;
+    for(uint32 i = 0; i < numCascades; ++i)
+    {
+        Assert_(cpuEVSM[i].Texels.size() == sliceSize);
+        const Float4* gpuTexels = &gpuEVSM.Texels[cascadeIndices[i] * sliceSize];
+
+        float maxError = 0.0f;
+        for(uint64 texelIdx = 0; texelIdx < sliceSize; ++texelIdx)
+        {
+            const Float4& gpu = gpuTexels[texelIdx];
+            const Float4& cpu = cpuEVSM[i].Texels[texelIdx];
+            maxError = std::max(maxError, std::abs(gpu.x - cpu.x) / (std::abs(cpu.x) + EVSMValidationFloor));
+            maxError = std::max(maxError, std::abs(gpu.y - cpu.y) / (std::abs(cpu.y) + EVSMValidationFloor));
+            maxError = std::max(maxError, std::abs(gpu.z - cpu.z) / (std::abs(cpu.z) + EVSMValidationFloor));
+            maxError = std::max(maxError, std::abs(gpu.w - cpu.w) / (std::abs(cpu.w) + EVSMValidationFloor));
+        }
+
+        AssertMsg_(maxError <= EVSMValidationTolerance, "CPU and GPU EVSM maps for cascade %u differ by %f",
+                   cascadeIndices[i], maxError);
+    }
 }
 
 // Renders all meshes in the model, with shadows
@@ -461,30 +1083,36 @@ void MeshRenderer::Render(ID3D11DeviceContext* context, const Camera& camera, co
     context->DSSetShader(nullptr, nullptr, 0);
     context->HSSetShader(nullptr, nullptr, 0);
     context->GSSetShader(nullptr, nullptr, 0);
-    context->VSSetShader(meshVS[nmlMapIdx], nullptr, 0);
     context->PSSetShader(meshPS[nmlMapIdx][centroidIdx], nullptr, 0);
 
-    // Draw all meshes
-    uint32 partCount = 0;
-    for(uint64 meshIdx = 0; meshIdx < model->Meshes().size(); ++meshIdx)
+    // Draw the visible meshlets from CullMainView(), which are sorted by mesh and part
+    uint32 currMeshIdx = uint32(-1);
+    uint32 currPartIdx = uint32(-1);
+    for(const DrawRange& range : mainDrawList)
     {
-        const Mesh& mesh = model->Meshes()[meshIdx];
-
-        // Set the vertices and indices
-        ID3D11Buffer* vertexBuffers[1] = { mesh.VertexBuffer() };
-        UINT vertexStrides[1] = { mesh.VertexStride() };
-        UINT offsets[1] = { 0 };
-        context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
-        context->IASetIndexBuffer(mesh.IndexBuffer(), mesh.IndexBufferFormat(), 0);
-        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-        // Set the input layout
-        context->IASetInputLayout(meshInputLayouts[meshIdx]);
+        const Mesh& mesh = model->Meshes()[range.MeshIdx];
+        if(range.MeshIdx != currMeshIdx)
+        {
+            // Set the vertices and indices
+            ID3D11Buffer* vertexBuffers[1] = { mesh.VertexBuffer() };
+            UINT vertexStrides[1] = { mesh.VertexBufferStride() };
+            UINT offsets[1] = { 0 };
+            context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
+            context->IASetIndexBuffer(mesh.IndexBuffer(), mesh.IndexBufferFormat(), 0);
+            context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+            // Set the input layout and vertex shader
+            context->IASetInputLayout(meshInputLayouts[range.MeshIdx]);
+            context->VSSetShader(meshVS[nmlMapIdx][mesh.CompressedVertices() ? 1 : 0], nullptr, 0);
+            ApplyMeshVSConstants(context, mesh);
+
+            currMeshIdx = range.MeshIdx;
+            currPartIdx = uint32(-1);
+        }
 
-        // Draw all parts
-        for(uint64 partIdx = 0; partIdx < mesh.MeshParts().size(); ++partIdx)
+        if(range.PartIdx != currPartIdx)
         {
-            const MeshPart& part = mesh.MeshParts()[partIdx];
+            const MeshPart& part = mesh.MeshParts()[range.PartIdx];
             const MeshMaterial& material = model->Materials()[part.MaterialIdx];
 
             // Set the textures
@@ -498,8 +1126,10 @@ void MeshRenderer::Render(ID3D11DeviceContext* context, const Camera& camera, co
             };
 
             context->PSSetShaderResources(0, 5, psTextures);
-            context->DrawIndexed(part.IndexCount, part.IndexStart, 0);
+            currPartIdx = range.PartIdx;
         }
+
+        context->DrawIndexed(range.IndexCount, range.IndexStart, 0);
     }
 
     ID3D11ShaderResourceView* nullSRVs[5] = { nullptr };
@@ -508,7 +1138,7 @@ void MeshRenderer::Render(ID3D11DeviceContext* context, const Camera& camera, co
 
 // Renders all meshes using depth-only rendering
 void MeshRenderer::RenderDepth(ID3D11DeviceContext* context, const Camera& camera,
-    const Float4x4& world, bool shadowRendering)
+    const Float4x4& world, bool shadowRendering, const std::vector<DrawRange>* drawList)
 {
     PIXEvent event(L"Mesh Depth Rendering");
 
@@ -530,28 +1160,58 @@ void MeshRenderer::RenderDepth(ID3D11DeviceContext* context, const Camera& camer
     meshVSConstants.SetVS(context, 0);
 
     // Set shaders
-    context->VSSetShader(meshDepthVS, nullptr, 0);
     context->PSSetShader(nullptr, nullptr, 0);
     context->GSSetShader(nullptr, nullptr, 0);
     context->DSSetShader(nullptr, nullptr, 0);
     context->HSSetShader(nullptr, nullptr, 0);
 
+    // Depth passes for the main camera draw the same list as the main pass
+    if(drawList == nullptr && shadowRendering == false)
+        drawList = &mainDrawList;
+
+    if(drawList != nullptr)
+    {
+        // Only draw the ranges in the list, which are sorted by mesh
+        uint32 currMeshIdx = uint32(-1);
+        for(const DrawRange& range : *drawList)
+        {
+            const Mesh& mesh = model->Meshes()[range.MeshIdx];
+            if(range.MeshIdx != currMeshIdx)
+            {
+                ID3D11Buffer* vertexBuffers[1] = { mesh.VertexBuffer() };
+                UINT vertexStrides[1] = { mesh.VertexBufferStride() };
+                UINT offsets[1] = { 0 };
+                context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
+                context->IASetIndexBuffer(mesh.IndexBuffer(), mesh.IndexBufferFormat(), 0);
+                context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+                context->IASetInputLayout(meshDepthInputLayouts[range.MeshIdx]);
+                context->VSSetShader(meshDepthVS[mesh.CompressedVertices() ? 1 : 0], nullptr, 0);
+                ApplyMeshVSConstants(context, mesh);
+                currMeshIdx = range.MeshIdx;
+            }
+
+            context->DrawIndexed(range.IndexCount, range.IndexStart, 0);
+        }
+
+        return;
+    }
 
-    uint32 partCount = 0;
     for(uint32 meshIdx = 0; meshIdx < model->Meshes().size(); ++meshIdx)
     {
         const Mesh& mesh = model->Meshes()[meshIdx];
 
         // Set the vertices and indices
         ID3D11Buffer* vertexBuffers[1] = { mesh.VertexBuffer() };
-        UINT vertexStrides[1] = { mesh.VertexStride() };
+        UINT vertexStrides[1] = { mesh.VertexBufferStride() };
         UINT offsets[1] = { 0 };
         context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
         context->IASetIndexBuffer(mesh.IndexBuffer(), mesh.IndexBufferFormat(), 0);
         context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-        // Set the input layout
+        // Set the input layout and vertex shader
         context->IASetInputLayout(meshDepthInputLayouts[meshIdx]);
+        context->VSSetShader(meshDepthVS[mesh.CompressedVertices() ? 1 : 0], nullptr, 0);
+        ApplyMeshVSConstants(context, mesh);
 
         // Draw all parts
         for(uint64 partIdx = 0; partIdx < mesh.MeshParts().size(); ++partIdx)
@@ -562,25 +1222,71 @@ void MeshRenderer::RenderDepth(ID3D11DeviceContext* context, const Camera& camer
     }
 }
 
-// Renders meshes using cascaded shadow mapping
-void MeshRenderer::RenderShadowMap(ID3D11DeviceContext* context, const Camera& camera,
-                                   const Float4x4& world)
+// Updates the constants used for decoding compressed vertex positions
+void MeshRenderer::ApplyMeshVSConstants(ID3D11DeviceContext* context, const Mesh& mesh)
 {
-    PIXEvent event(L"Mesh Shadow Map Rendering");
+    meshVSConstants.Data.PositionScale = mesh.PositionScale();
+    meshVSConstants.Data.PositionOffset = mesh.PositionOffset();
+    meshVSConstants.ApplyChanges(context);
+}
 
-    // Get the current render targets + viewport
-    ID3D11RenderTargetView* renderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = { NULL };
-    ID3D11DepthStencilView* depthStencil = NULL;
-    context->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, renderTargets, &depthStencil);
+// Returns true if the camera, light, or depth bounds have changed enough that the cascades need
+// to be re-fit
+bool MeshRenderer::CascadeFitChanged(const PerspectiveCamera& camera) const
+{
+    if(cascadeFit.Valid == false)
+        return true;
+
+    if(Float3::Length(camera.Position() - cascadeFit.CameraPos) > CascadeRefitEpsilon)
+        return true;
+
+    const Quaternion& orientation = camera.Orientation();
+    const Quaternion& fitOrientation = cascadeFit.CameraOrientation;
+    const float orientationDot = orientation.x * fitOrientation.x + orientation.y * fitOrientation.y
+                               + orientation.z * fitOrientation.z + orientation.w * fitOrientation.w;
+    if(std::abs(orientationDot) < 1.0f - CascadeRefitEpsilon)
+        return true;
+
+    if(camera.FieldOfView() != cascadeFit.FieldOfView || camera.AspectRatio() != cascadeFit.AspectRatio
+       || camera.NearClip() != cascadeFit.NearClip || camera.FarClip() != cascadeFit.FarClip)
+        return true;
+
+    if(Float3::Dot(AppSettings::LightDirection, cascadeFit.LightDir) < 1.0f - CascadeRefitEpsilon)
+        return true;
+
+    // The fitted depth bounds are padded, so we only need to refit if the actual bounds leave
+    // them or shrink significantly
+    const Float2 fitBounds = cascadeFit.DepthBounds;
+    if(shadowDepthBounds.x < fitBounds.x || shadowDepthBounds.y > fitBounds.y)
+        return true;
+    if(shadowDepthBounds.x - fitBounds.x > DepthBoundsPadding * 2.0f)
+        return true;
+    if(fitBounds.y - shadowDepthBounds.y > DepthBoundsPadding * 2.0f)
+        return true;
+
+    return false;
+}
 
-    uint32 numViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
-    D3D11_VIEWPORT oldViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
-    context->RSGetViewports(&numViewports, oldViewports);
+// Fits a bounding sphere to each cascade's slice of the view frustum, and snaps the sphere
+// center to shadow map texels in light space. This keeps the cascade matrices identical while
+// the camera moves within a texel, so that the cached shadow maps can be re-used.
+void MeshRenderer::FitCascades(const PerspectiveCamera& camera)
+{
+    cascadeFit.CameraPos = camera.Position();
+    cascadeFit.CameraOrientation = camera.Orientation();
+    cascadeFit.FieldOfView = camera.FieldOfView();
+    cascadeFit.AspectRatio = camera.AspectRatio();
+    cascadeFit.NearClip = camera.NearClip();
+    cascadeFit.FarClip = camera.FarClip();
+    cascadeFit.LightDir = AppSettings::LightDirection;
+    cascadeFit.DepthBounds.x = Saturate(shadowDepthBounds.x - DepthBoundsPadding);
+    cascadeFit.DepthBounds.y = Saturate(shadowDepthBounds.y + DepthBoundsPadding);
+    cascadeFit.Valid = true;
 
     const float sMapSize = static_cast<float>(ShadowMapSize);
 
-    const float MinDistance = shadowDepthBounds.x;
-    const float MaxDistance = shadowDepthBounds.y;
+    const float MinDistance = cascadeFit.DepthBounds.x;
+    const float MaxDistance = cascadeFit.DepthBounds.y;
 
     // Compute the split distances based on the partitioning mode
     float CascadeSplits[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
@@ -608,131 +1314,134 @@ void MeshRenderer::RenderShadowMap(ID3D11DeviceContext* context, const Camera& c
         }
     }
 
-    Float3 c0Extents;
-    Float4x4 c0Matrix;
-
-    // Render the meshes to each cascade
-    for(uint32 cascadeIdx = 0; cascadeIdx < NumCascades; ++cascadeIdx)
+    // Get the 8 points of the view frustum in world space
+    XMVECTOR frustumCornersWS[8] =
     {
-        PIXEvent cascadeEvent((L"Rendering Shadow Map Cascade " + ToString(cascadeIdx)).c_str());
+        XMVectorSet(-1.0f,  1.0f, 0.0f, 1.0f),
+        XMVectorSet( 1.0f,  1.0f, 0.0f, 1.0f),
+        XMVectorSet( 1.0f, -1.0f, 0.0f, 1.0f),
+        XMVectorSet(-1.0f, -1.0f, 0.0f, 1.0f),
+        XMVectorSet(-1.0f,  1.0f, 1.0f, 1.0f),
+        XMVectorSet( 1.0f,  1.0f, 1.0f, 1.0f),
+        XMVectorSet( 1.0f, -1.0f, 1.0f, 1.0f),
+        XMVectorSet(-1.0f, -1.0f, 1.0f, 1.0f),
+    };
 
-        // Set the viewport
-        D3D11_VIEWPORT viewport;
-        viewport.TopLeftX = 0.0f;
-        viewport.TopLeftY = 0.0f;
-        viewport.Width = sMapSize;
-        viewport.Height = sMapSize;
-        viewport.MinDepth = 0.0f;
-        viewport.MaxDepth = 1.0f;
-        context->RSSetViewports(1, &viewport);
+    // Use the projection without the TAA jitter, so that the fit doesn't depend on the frame
+    const XMMATRIX projection = XMMatrixPerspectiveFovLH(camera.FieldOfView(), camera.AspectRatio(),
+                                                         camera.NearClip(), camera.FarClip());
+    XMVECTOR det;
+    XMMATRIX invViewProj = XMMatrixInverse(&det, XMMatrixMultiply(camera.ViewMatrix().ToSIMD(), projection));
+    for(uint32 i = 0; i < 8; ++i)
+        frustumCornersWS[i] = XMVector3TransformCoord(frustumCornersWS[i], invViewProj);
 
-        // Set the shadow map as the depth target
-        ID3D11DepthStencilView* dsv = shadowMap.DSView;
-        ID3D11RenderTargetView* nullRenderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = { NULL };
-        context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, nullRenderTargets, dsv);
-        context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
+    // Use a fixed up vector so that the light's basis doesn't rotate with the camera
+    Float3 upDir = Float3(0.0f, 1.0f, 0.0f);
+    if(std::abs(AppSettings::LightDirection.Value().y) > 0.99f)
+        upDir = Float3(0.0f, 0.0f, 1.0f);
 
-        // Get the 8 points of the view frustum in world space
-        XMVECTOR frustumCornersWS[8] =
-        {
-            XMVectorSet(-1.0f,  1.0f, 0.0f, 1.0f),
-            XMVectorSet( 1.0f,  1.0f, 0.0f, 1.0f),
-            XMVectorSet( 1.0f, -1.0f, 0.0f, 1.0f),
-            XMVectorSet(-1.0f, -1.0f, 0.0f, 1.0f),
-            XMVectorSet(-1.0f,  1.0f, 1.0f, 1.0f),
-            XMVectorSet( 1.0f,  1.0f, 1.0f, 1.0f),
-            XMVectorSet( 1.0f, -1.0f, 1.0f, 1.0f),
-            XMVectorSet(-1.0f, -1.0f, 1.0f, 1.0f),
-        };
+    const XMMATRIX lightBasis = XMMatrixLookAtLH(XMVectorZero(), (-AppSettings::LightDirection.Value()).ToSIMD(),
+                                                 upDir.ToSIMD());
+    const XMMATRIX invLightBasis = XMMatrixTranspose(lightBasis);
 
+    for(uint32 cascadeIdx = 0; cascadeIdx < NumCascades; ++cascadeIdx)
+    {
         float prevSplitDist = cascadeIdx == 0 ? MinDistance : CascadeSplits[cascadeIdx - 1];
         float splitDist = CascadeSplits[cascadeIdx];
 
-        XMVECTOR det;
-        XMMATRIX invViewProj = XMMatrixInverse(&det, camera.ViewProjectionMatrix().ToSIMD());
-        for(uint32 i = 0; i < 8; ++i)
-            frustumCornersWS[i] = XMVector3TransformCoord(frustumCornersWS[i], invViewProj);
-
         // Get the corners of the current cascade slice of the view frustum
+        XMVECTOR sliceCornersWS[8];
         for(uint32 i = 0; i < 4; ++i)
         {
             XMVECTOR cornerRay = XMVectorSubtract(frustumCornersWS[i + 4], frustumCornersWS[i]);
             XMVECTOR nearCornerRay = XMVectorScale(cornerRay, prevSplitDist);
             XMVECTOR farCornerRay = XMVectorScale(cornerRay, splitDist);
-            frustumCornersWS[i + 4] = XMVectorAdd(frustumCornersWS[i], farCornerRay);
-            frustumCornersWS[i] = XMVectorAdd(frustumCornersWS[i], nearCornerRay);
+            sliceCornersWS[i + 4] = XMVectorAdd(frustumCornersWS[i], farCornerRay);
+            sliceCornersWS[i] = XMVectorAdd(frustumCornersWS[i], nearCornerRay);
         }
 
+        for(uint32 i = 0; i < 8; ++i)
+            cascades[cascadeIdx].SliceCorners[i] = sliceCornersWS[i];
+
         // Calculate the centroid of the view frustum slice
         XMVECTOR frustumCenterVec = XMVectorZero();
         for(uint32 i = 0; i < 8; ++i)
-            frustumCenterVec = XMVectorAdd(frustumCenterVec, frustumCornersWS[i]);
+            frustumCenterVec = XMVectorAdd(frustumCenterVec, sliceCornersWS[i]);
         frustumCenterVec = XMVectorScale(frustumCenterVec, 1.0f / 8.0f);
-        Float3 frustumCenter = frustumCenterVec;
-
-        // Pick the up vector to use for the light camera
-        Float3 upDir = camera.Right();
-
-        Float3 minExtents;
-        Float3 maxExtents;
 
+        // Fit a sphere around the slice, with the radius rounded up so that it stays constant
+        // as the camera rotates
+        float sphereRadius = 0.0f;
+        for(uint32 i = 0; i < 8; ++i)
         {
-            // Create a temporary view matrix for the light
-            Float3 lightCameraPos = frustumCenter;
-            Float3 lookAt = frustumCenter - AppSettings::LightDirection;
-            XMMATRIX lightView = XMMatrixLookAtLH(lightCameraPos.ToSIMD(), lookAt.ToSIMD(), upDir.ToSIMD());
-
-            // Calculate an AABB around the frustum corners
-            XMVECTOR mins = XMVectorSet(REAL_MAX, REAL_MAX, REAL_MAX, REAL_MAX);
-            XMVECTOR maxes = XMVectorSet(-REAL_MAX, -REAL_MAX, -REAL_MAX, -REAL_MAX);
-            for(uint32 i = 0; i < 8; ++i)
-            {
-                XMVECTOR corner = XMVector3TransformCoord(frustumCornersWS[i], lightView);
-                mins = XMVectorMin(mins, corner);
-                maxes = XMVectorMax(maxes, corner);
-            }
-
-            minExtents = mins;
-            maxExtents = maxes;
+            float dist = XMVectorGetX(XMVector3Length(XMVectorSubtract(sliceCornersWS[i], frustumCenterVec)));
+            sphereRadius = std::max(sphereRadius, dist);
         }
+        sphereRadius = std::ceil(sphereRadius * 16.0f) / 16.0f;
 
-        // Adjust the min/max to accommodate the filtering size
-        float scale = (ShadowMapSize + FilterSize) / static_cast<float>(ShadowMapSize);
-        minExtents.x *= scale;
-        minExtents.y *= scale;
-        maxExtents.x *= scale;
-        maxExtents.x *= scale;
+        // Adjust the radius to accommodate the filtering size
+        sphereRadius *= (ShadowMapSize + FilterSize) / static_cast<float>(ShadowMapSize);
 
-        Float3 cascadeExtents = maxExtents - minExtents;
+        // Snap the center to texel-sized increments in light space
+        const float texelSize = (sphereRadius * 2.0f) / sMapSize;
+        XMVECTOR centerLS = XMVector3TransformCoord(frustumCenterVec, lightBasis);
+        centerLS = XMVectorScale(XMVectorFloor(XMVectorScale(centerLS, 1.0f / texelSize)), texelSize);
+        const Float3 frustumCenter = XMVector3TransformCoord(centerLS, invLightBasis);
 
         // Get position of the shadow camera
-        Float3 shadowCameraPos = frustumCenter + AppSettings::LightDirection.Value() * -minExtents.z;
+        Float3 shadowCameraPos = frustumCenter + AppSettings::LightDirection.Value() * sphereRadius;
 
         // Come up with a new orthographic camera for the shadow caster
-        OrthographicCamera shadowCamera(minExtents.x, minExtents.y, maxExtents.x,
-            maxExtents.y, 0.0f, cascadeExtents.z);
+        OrthographicCamera& shadowCamera = cascades[cascadeIdx].Camera;
+        shadowCamera = OrthographicCamera(-sphereRadius, -sphereRadius, sphereRadius, sphereRadius,
+                                          0.0f, sphereRadius * 2.0f);
         shadowCamera.SetLookAt(shadowCameraPos, frustumCenter, upDir);
 
-        // Draw the mesh with depth only, using the new shadow camera
-        RenderDepth(context, shadowCamera, world, true);
-
-        // Apply the scale/offset matrix, which transforms from [-1,1]
-        // post-projection space to [0,1] UV space
-        XMMATRIX texScaleBias;
-        texScaleBias.r[0] = XMVectorSet(0.5f,  0.0f, 0.0f, 0.0f);
-        texScaleBias.r[1] = XMVectorSet(0.0f, -0.5f, 0.0f, 0.0f);
-        texScaleBias.r[2] = XMVectorSet(0.0f,  0.0f, 1.0f, 0.0f);
-        texScaleBias.r[3] = XMVectorSet(0.5f,  0.5f, 0.0f, 1.0f);
-        XMMATRIX shadowMatrix = shadowCamera.ViewProjectionMatrix().ToSIMD();
-        shadowMatrix = XMMatrixMultiply(shadowMatrix, texScaleBias);
-
         // Store the split distance in terms of view space depth
         const float clipDist = camera.FarClip() - camera.NearClip();
         meshPSConstants.Data.CascadeSplits[cascadeIdx] = camera.NearClip() + splitDist * clipDist;
+    }
+}
+
+// Returns true if the cascade's current slice of the view frustum is inside of the region that
+// its cached map was rendered for, including the border that's reserved for filtering. Otherwise
+// the cached map can't be used with the current split distances.
+bool MeshRenderer::CachedCascadeCoversSlice(uint32 cascadeIdx) const
+{
+    const ShadowCascade& cascade = cascades[cascadeIdx];
+    const float maxExtent = ShadowMapSize / (ShadowMapSize + FilterSize);
+    const XMMATRIX renderedViewProjection = cascade.RenderedViewProjection.ToSIMD();
+    for(uint32 i = 0; i < 8; ++i)
+    {
+        const Float3 corner = XMVector3TransformCoord(cascade.SliceCorners[i].ToSIMD(), renderedViewProjection);
+        if(std::abs(corner.x) > maxExtent || std::abs(corner.y) > maxExtent || corner.z < 0.0f || corner.z > 1.0f)
+            return false;
+    }
+
+    return true;
+}
+
+// Computes the shadow matrix and the cascade offsets/scales from the matrices that each cascade
+// was last rendered with, so that cascades which weren't updated this frame are still sampled
+// with the projection that matches their cached shadow map
+void MeshRenderer::UpdateCascadeConstants()
+{
+    // Apply the scale/offset matrix, which transforms from [-1,1]
+    // post-projection space to [0,1] UV space
+    XMMATRIX texScaleBias;
+    texScaleBias.r[0] = XMVectorSet(0.5f,  0.0f, 0.0f, 0.0f);
+    texScaleBias.r[1] = XMVectorSet(0.0f, -0.5f, 0.0f, 0.0f);
+    texScaleBias.r[2] = XMVectorSet(0.0f,  0.0f, 1.0f, 0.0f);
+    texScaleBias.r[3] = XMVectorSet(0.5f,  0.5f, 0.0f, 1.0f);
+
+    Float4x4 c0Matrix;
+    for(uint32 cascadeIdx = 0; cascadeIdx < NumCascades; ++cascadeIdx)
+    {
+        XMMATRIX shadowMatrix = cascades[cascadeIdx].RenderedViewProjection.ToSIMD();
+        shadowMatrix = XMMatrixMultiply(shadowMatrix, texScaleBias);
 
         if(cascadeIdx == 0)
         {
-            c0Extents = cascadeExtents;
             c0Matrix = shadowMatrix;
             meshPSConstants.Data.ShadowMatrix = XMMatrixTranspose(shadowMatrix);
             meshPSConstants.Data.CascadeOffsets[0] = Float4(0.0f, 0.0f, 0.0f, 0.0f);
@@ -755,10 +1464,127 @@ void MeshRenderer::RenderShadowMap(ID3D11DeviceContext* context, const Camera& c
             meshPSConstants.Data.CascadeOffsets[cascadeIdx] = Float4(-cascadeCorner, 0.0f);
             meshPSConstants.Data.CascadeScales[cascadeIdx] = Float4(cascadeScale, 1.0f);
         }
+    }
+}
+
+// Renders meshes using cascaded shadow mapping
+void MeshRenderer::RenderShadowMap(ID3D11DeviceContext* context, const PerspectiveCamera& camera,
+                                   const Float4x4& world)
+{
+    PIXEvent event(L"Mesh Shadow Map Rendering");
+
+    if(CascadeFitChanged(camera))
+        FitCascades(camera);
+
+    // A cascade's cached map is invalid if the light or the mesh transform have changed since it
+    // was rendered, in which case it always needs to be re-rendered. Cascades that only need to
+    // follow the camera are updated on a staggered schedule, with the far cascades updated less
+    // often. Until then their cached map is re-projected using the matrix it was rendered with,
+    // as long as that map still covers the cascade's new slice of the view frustum.
+    const uint32 maxUpdateInterval = std::max<uint32>(AppSettings::MaxCascadeUpdateInterval, 1);
+    bool cascadeDirty[NumCascades] = { };
+    uint32 numDirtyCascades = 0;
+    for(uint32 cascadeIdx = 0; cascadeIdx < NumCascades; ++cascadeIdx)
+    {
+        ShadowCascade& cascade = cascades[cascadeIdx];
+        const bool cacheInvalid = cascade.Rendered == false || cascade.RenderedWorld != world
+                                  || cascade.RenderedLightDir != cascadeFit.LightDir
+                                  || AppSettings::LODErrorThreshold.Changed()
+                                  || AppSettings::MeshletCulling.Changed()
+                                  || AppSettings::OcclusionCulling.Changed();
+        const bool cascadeMoved = cascade.RenderedViewProjection != cascade.Camera.ViewProjectionMatrix();
+        const uint32 updateInterval = std::min<uint32>(1 << cascadeIdx, maxUpdateInterval);
+        const bool updateScheduled = (shadowFrameIdx + cascadeIdx) % updateInterval == 0;
+
+        cascadeDirty[cascadeIdx] = cacheInvalid || (cascadeMoved && (updateScheduled || CachedCascadeCoversSlice(cascadeIdx) == false));
+        if(cascadeDirty[cascadeIdx])
+        {
+            cascade.RenderedViewProjection = cascade.Camera.ViewProjectionMatrix();
+            cascade.RenderedWorld = world;
+            cascade.RenderedLightDir = cascadeFit.LightDir;
+            cascade.Rendered = true;
+            ++numDirtyCascades;
+        }
+    }
+
+    ++shadowFrameIdx;
+
+    if(numDirtyCascades == 0)
+        return;
+
+    UpdateCascadeConstants();
+
+    // Get the current render targets + viewport
+    ID3D11RenderTargetView* renderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = { NULL };
+    ID3D11DepthStencilView* depthStencil = NULL;
+    context->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, renderTargets, &depthStencil);
+
+    uint32 numViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+    D3D11_VIEWPORT oldViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+    context->RSGetViewports(&numViewports, oldViewports);
+
+    const float sMapSize = static_cast<float>(ShadowMapSize);
+
+    // Cull the mesh parts and meshlets against the dirty cascades in parallel
+    ParallelFor(NumCascades, 1, [&](uint64 start, uint64 end)
+    {
+        for(uint64 cascadeIdx = start; cascadeIdx < end; ++cascadeIdx)
+        {
+            if(cascadeDirty[cascadeIdx] == false)
+                continue;
+
+            OcclusionBuffer* occlusionBuffer = AppSettings::OcclusionCulling ? &cascadeOcclusionBuffers[cascadeIdx] : nullptr;
+            CullShadowCasters(cascades[cascadeIdx].Camera, world, occlusionBuffer, cascadeDrawLists[cascadeIdx]);
+        }
+    });
+
+    // Render the meshes to each dirty cascade
+    std::vector<uint32> validationCascades;
+    std::vector<TextureData<float>> validationDepths;
+    for(uint32 cascadeIdx = 0; cascadeIdx < NumCascades; ++cascadeIdx)
+    {
+        if(cascadeDirty[cascadeIdx] == false)
+            continue;
+
+        PIXEvent cascadeEvent((L"Rendering Shadow Map Cascade " + ToString(cascadeIdx)).c_str());
+
+        const ShadowCascade& cascade = cascades[cascadeIdx];
+
+        // Set the viewport
+        D3D11_VIEWPORT viewport;
+        viewport.TopLeftX = 0.0f;
+        viewport.TopLeftY = 0.0f;
+        viewport.Width = sMapSize;
+        viewport.Height = sMapSize;
+        viewport.MinDepth = 0.0f;
+        viewport.MaxDepth = 1.0f;
+        context->RSSetViewports(1, &viewport);
+
+        // Set the shadow map as the depth target
+        ID3D11DepthStencilView* dsv = shadowMap.DSView;
+        ID3D11RenderTargetView* nullRenderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = { NULL };
+        context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, nullRenderTargets, dsv);
+        context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH|D3D11_CLEAR_STENCIL, 1.0f, 0);
+
+        // Draw the visible meshlets with depth only, using the cascade's shadow camera
+        RenderDepth(context, cascade.Camera, world, true, &cascadeDrawLists[cascadeIdx]);
 
         ConvertToEVSM(context, cascadeIdx, meshPSConstants.Data.CascadeScales[cascadeIdx].To3D());
+
+        if(AppSettings::ValidateEVSM)
+        {
+            validationCascades.push_back(cascadeIdx);
+            validationDepths.push_back(TextureData<float>());
+            ReadDepthSamples(context, shadowMap, validationDepths.back());
+        }
     }
 
+    if(AppSettings::ValidateEVSM)
+        ValidateEVSM(validationCascades, validationDepths);
+
+    if(EnableShadowMips)
+        context->GenerateMips(varianceShadowMap.SRView);
+
     // Restore the previous render targets and viewports
     context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, renderTargets, depthStencil);
     context->RSSetViewports(D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE, oldViewports);
@@ -768,4 +1594,4 @@ void MeshRenderer::RenderShadowMap(ID3D11DeviceContext* context, const Camera& c
             renderTargets[i]->Release();
     if(depthStencil != NULL)
         depthStencil->Release();
-}
\ No newline at end of file
+}
@@ -13,10 +13,12 @@
 #include <PCH.h>
 
 #include <Graphics\\Model.h>
+#include <Graphics\\OcclusionCulling.h>
 #include <Graphics\\GraphicsTypes.h>
 #include <Graphics\\DeviceStates.h>
 #include <Graphics\\Camera.h>
 #include <Graphics\\SH.h>
+#include <Graphics\\Textures.h>
 #include <Graphics\\ShaderCompilation.h>
 
 #include "AppSettings.h"
@@ -32,15 +34,28 @@ protected:
 
     // Constants
     static const uint32 NumCascades = 4;
-    static const uint32 ReadbackLatency = 1;
+    static const uint32 MaxReadbackLatency = 4;
 
 public:
 
+    // A range of indices from a mesh part, made up of one or more adjacent visible meshlets
+    struct DrawRange
+    {
+        uint32 MeshIdx = 0;
+        uint32 PartIdx = 0;
+        uint32 IndexStart = 0;
+        uint32 IndexCount = 0;
+    };
+
     void Initialize(ID3D11Device* device, ID3D11DeviceContext* context);
     void SetModel(const Model* model);
 
+    // Culls the main view into the draw list used by both the depth prepass and the main pass,
+    // and needs to be called once per frame before either of them
+    void CullMainView(const Camera& camera, const Float4x4& world);
+
     void RenderDepth(ID3D11DeviceContext* context, const Camera& camera, const Float4x4& world,
-                     bool shadowRendering);
+                     bool shadowRendering, const std::vector<DrawRange>* drawList = nullptr);
     void Render(ID3D11DeviceContext* context, const Camera& camera, const Float4x4& world,
                 ID3D11ShaderResourceView* envMap, const SH9Color& envMapSH,
                 Float2 JitterOffset);
@@ -52,9 +67,9 @@ public:
     void ReduceDepth(ID3D11DeviceContext* context, DepthStencilBuffer& depthBuffer,
                      const Camera& camera);
 
-    void ComputeShadowDepthBounds(const Camera& camera);
+    void ComputeShadowDepthBounds(const Camera& camera, const Float4x4& world);
 
-    void RenderShadowMap(ID3D11DeviceContext* context, const Camera& camera,
+    void RenderShadowMap(ID3D11DeviceContext* context, const PerspectiveCamera& camera,
                          const Float4x4& world);
 
 protected:
@@ -62,6 +77,62 @@ protected:
     void LoadShaders();
     void CreateShadowMaps();
     void ConvertToEVSM(ID3D11DeviceContext* context, uint32 cascadeIdx, Float3 cascadeScale);
+    void ReadDepthSamples(ID3D11DeviceContext* context, DepthStencilBuffer& depthBuffer,
+                          TextureData<float>& samples);
+    void ValidateEVSM(const std::vector<uint32>& cascadeIndices,
+                      const std::vector<TextureData<float>>& cascadeDepths);
+    void ValidateDepthReduction(ID3D11DeviceContext* context, DepthStencilBuffer& depthBuffer,
+                                const Camera& camera, StagingTexture2D& stagingTexture);
+    void ComputePartBounds();
+    bool CascadeFitChanged(const PerspectiveCamera& camera) const;
+    void FitCascades(const PerspectiveCamera& camera);
+    bool CachedCascadeCoversSlice(uint32 cascadeIdx) const;
+    void UpdateCascadeConstants();
+    void ApplyMeshVSConstants(ID3D11DeviceContext* context, const Mesh& mesh);
+
+    // Per-part AABB's, along with the positions referenced by each part stored in SoA order and
+    // padded to a multiple of 4, and the ranges of the part's meshlets and LODs in the mesh
+    struct PartBounds
+    {
+        Float3 Min;
+        Float3 Max;
+        uint64 PositionStart = 0;
+        uint64 NumPositions = 0;
+        uint32 MeshIdx = 0;
+        uint32 MeshPartIdx = 0;
+        uint32 MeshletStart = 0;
+        uint32 NumMeshlets = 0;
+        uint32 LODStart = 0;
+        uint32 NumLODs = 0;
+    };
+
+    // Converts the object-space error of a LOD into pixels. For perspective views the error is
+    // also divided by the distance to the view position.
+    struct LODMetric
+    {
+        Float3 ViewPosition;
+        float ErrorScale = 0.0f;
+        bool Orthographic = false;
+    };
+
+    // The buffer to rasterize occluders into and test parts against, or null to disable occlusion
+    // culling. Occluders are selected with the LOD metric scaled to the resolution of the buffer.
+    struct OcclusionView
+    {
+        OcclusionBuffer* Buffer = nullptr;
+        Float4x4 WorldViewProjection;
+        float ResolutionScale = 1.0f;
+        bool ShadowRendering = false;
+    };
+
+    float PixelsPerUnit(const PartBounds& bounds, const LODMetric& metric) const;
+    uint32 SelectLOD(const PartBounds& bounds, const LODMetric& metric) const;
+    float RasterizeOccluders(const std::vector<uint8>& partVisible, const LODMetric& lodMetric,
+                             const OcclusionView& occlusion) const;
+    void CullParts(const CullVolume& volume, const LODMetric& lodMetric, const OcclusionView& occlusion,
+                   std::vector<DrawRange>& drawList) const;
+    void CullShadowCasters(const OrthographicCamera& shadowCamera, const Float4x4& world,
+                           OcclusionBuffer* occlusionBuffer, std::vector<DrawRange>& drawList) const;
 
     ID3D11DevicePtr device;
 
@@ -79,12 +150,13 @@ protected:
     ID3D11RasterizerStatePtr shadowRSState;
     ID3D11SamplerStatePtr evsmSampler;
 
+    // Vertex shaders are indexed by [normal mapping][compressed vertices]
     std::vector<ID3D11InputLayoutPtr> meshInputLayouts;
-    VertexShaderPtr meshVS[2];
+    VertexShaderPtr meshVS[2][2];
     PixelShaderPtr meshPS[2][2];
 
     std::vector<ID3D11InputLayoutPtr> meshDepthInputLayouts;
-    VertexShaderPtr meshDepthVS;
+    VertexShaderPtr meshDepthVS[2];
 
     VertexShaderPtr fullScreenVS;
     PixelShaderPtr evsmConvertPS;
@@ -93,12 +165,70 @@ protected:
 
     ComputeShaderPtr depthReductionInitialCS[2];
     ComputeShaderPtr depthReductionCS;
+    ComputeShaderPtr copyDepthSamplesCS[2];
     std::vector<RenderTarget2D> depthReductionTargets;
-    StagingTexture2D reductionStagingTextures[ReadbackLatency];
-    uint32 currFrame = 0;
+    StagingTexture2D reductionStagingTextures[MaxReadbackLatency];
+    uint64 reductionReadbackFrames[MaxReadbackLatency];
+    uint64 lastReadbackFrame = 0;
+    uint32 readbackLatency = 0;
+    uint64 currFrame = 0;
 
     Float2 shadowDepthBounds = Float2(0.0f, 1.0f);
 
+    std::vector<PartBounds> partBounds;
+    std::vector<float> partPositionsX;
+    std::vector<float> partPositionsY;
+    std::vector<float> partPositionsZ;
+
+    // Part AABB centers, extents, and bounding sphere radii in SoA order, padded to a multiple of 4
+    std::vector<float> partCentersX;
+    std::vector<float> partCentersY;
+    std::vector<float> partCentersZ;
+    std::vector<float> partExtentsX;
+    std::vector<float> partExtentsY;
+    std::vector<float> partExtentsZ;
+    std::vector<float> partRadii;
+
+    // The index ranges that are visible to the camera and to each shadow cascade, sorted by mesh
+    // and part
+    std::vector<DrawRange> mainDrawList;
+    std::vector<DrawRange> cascadeDrawLists[NumCascades];
+
+    // Occluders rasterized for the camera and for each cascade, from the light's point of view
+    OcclusionBuffer mainOcclusionBuffer;
+    OcclusionBuffer cascadeOcclusionBuffers[NumCascades];
+
+    // The inputs that the cascades were last fit with. The projection is tracked by its parameters,
+    // since the camera's projection matrix has the TAA jitter applied to it.
+    struct CascadeFitState
+    {
+        Float3 CameraPos;
+        Quaternion CameraOrientation;
+        float FieldOfView = 0.0f;
+        float AspectRatio = 0.0f;
+        float NearClip = 0.0f;
+        float FarClip = 0.0f;
+        Float3 LightDir;
+        Float2 DepthBounds;
+        bool Valid = false;
+    };
+
+    // The fitted camera for each cascade and the corners of its slice of the view frustum, along
+    // with the state that its EVSM map was last rendered with
+    struct ShadowCascade
+    {
+        OrthographicCamera Camera = OrthographicCamera(-1.0f, -1.0f, 1.0f, 1.0f, 0.0f, 1.0f);
+        Float3 SliceCorners[8];
+        Float4x4 RenderedViewProjection;
+        Float4x4 RenderedWorld;
+        Float3 RenderedLightDir;
+        bool Rendered = false;
+    };
+
+    CascadeFitState cascadeFit;
+    ShadowCascade cascades[NumCascades];
+    uint64 shadowFrameIdx = 0;
+
     ID3D11ShaderResourceViewPtr specularLookupTexture;
 
     Float4x4 prevWVP;
@@ -113,6 +243,8 @@ protected:
         Float4Align Float4x4 View;
         Float4Align Float4x4 WorldViewProjection;
         Float4Align Float4x4 PrevWorldViewProjection;
+        Float4Align Float3 PositionScale;
+        Float4Align Float3 PositionOffset;
     };
 
     struct MeshPSConstants
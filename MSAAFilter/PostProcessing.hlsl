@@ -154,6 +154,59 @@ float4 BlurV(in PSInput input) : SV_Target
     return Blur(input, float2(0, 1), BloomBlurSigma);
 }
 
+// 13-tap downsample used to build the dual filter bloom mip chain. Combines 5 overlapping
+// 4x4 box filters, with the center box weighted the most.
+float4 BloomDownsample(in PSInput input) : SV_Target
+{
+    float2 texelSize = 1.0f / InputSize0;
+    float2 uv = input.TexCoord;
+
+    float3 a = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2(-2.0f, -2.0f), 0.0f).xyz;
+    float3 b = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2( 0.0f, -2.0f), 0.0f).xyz;
+    float3 c = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2( 2.0f, -2.0f), 0.0f).xyz;
+    float3 d = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2(-1.0f, -1.0f), 0.0f).xyz;
+    float3 e = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2( 1.0f, -1.0f), 0.0f).xyz;
+    float3 f = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2(-2.0f,  0.0f), 0.0f).xyz;
+    float3 g = InputTexture0.SampleLevel(LinearSampler, uv, 0.0f).xyz;
+    float3 h = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2( 2.0f,  0.0f), 0.0f).xyz;
+    float3 i = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2(-1.0f,  1.0f), 0.0f).xyz;
+    float3 j = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2( 1.0f,  1.0f), 0.0f).xyz;
+    float3 k = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2(-2.0f,  2.0f), 0.0f).xyz;
+    float3 l = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2( 0.0f,  2.0f), 0.0f).xyz;
+    float3 m = InputTexture0.SampleLevel(LinearSampler, uv + texelSize * float2( 2.0f,  2.0f), 0.0f).xyz;
+
+    float3 result = (d + e + i + j) * (0.5f / 4.0f);
+    result += (a + b + f + g) * (0.125f / 4.0f);
+    result += (b + c + g + h) * (0.125f / 4.0f);
+    result += (f + g + k + l) * (0.125f / 4.0f);
+    result += (g + h + l + m) * (0.125f / 4.0f);
+
+    return float4(result, 1.0f);
+}
+
+// Upsamples the lower mip of the bloom chain with a 3x3 tent filter, and averages it
+// with the current level of the chain
+float4 BloomUpsample(in PSInput input) : SV_Target
+{
+    float2 offset = BloomFilterRadius / InputSize0;
+    float2 uv = input.TexCoord;
+
+    float3 upsampled = InputTexture0.SampleLevel(LinearSampler, uv, 0.0f).xyz * 4.0f;
+    upsampled += InputTexture0.SampleLevel(LinearSampler, uv + offset * float2( 0.0f, -1.0f), 0.0f).xyz * 2.0f;
+    upsampled += InputTexture0.SampleLevel(LinearSampler, uv + offset * float2(-1.0f,  0.0f), 0.0f).xyz * 2.0f;
+    upsampled += InputTexture0.SampleLevel(LinearSampler, uv + offset * float2( 1.0f,  0.0f), 0.0f).xyz * 2.0f;
+    upsampled += InputTexture0.SampleLevel(LinearSampler, uv + offset * float2( 0.0f,  1.0f), 0.0f).xyz * 2.0f;
+    upsampled += InputTexture0.SampleLevel(LinearSampler, uv + offset * float2(-1.0f, -1.0f), 0.0f).xyz;
+    upsampled += InputTexture0.SampleLevel(LinearSampler, uv + offset * float2( 1.0f, -1.0f), 0.0f).xyz;
+    upsampled += InputTexture0.SampleLevel(LinearSampler, uv + offset * float2(-1.0f,  1.0f), 0.0f).xyz;
+    upsampled += InputTexture0.SampleLevel(LinearSampler, uv + offset * float2( 1.0f,  1.0f), 0.0f).xyz;
+    upsampled /= 16.0f;
+
+    float3 current = InputTexture1.SampleLevel(PointSampler, uv, 0.0f).xyz;
+
+    return float4((current + upsampled) * 0.5f, 1.0f);
+}
+
 // Applies exposure and tone mapping to the input
 float4 ToneMap(in PSInput input) : SV_Target0
 {
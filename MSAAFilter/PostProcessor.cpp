@@ -19,6 +19,9 @@
 // Constants
 static const uint32 TGSize = 16;
 static const uint32 LumMapSize = 1024;
+static const uint32 MaxBloomMips = 8;
+static const float BloomValidationTolerance = 0.1f;
+static const float BloomValidationFloor = 0.01f;
 
 void PostProcessor::Initialize(ID3D11Device* device)
 {
@@ -32,6 +35,8 @@ void PostProcessor::Initialize(ID3D11Device* device)
     blurH = CompilePSFromFile(device, L"PostProcessing.hlsl", "BlurH");
     blurV = CompilePSFromFile(device, L"PostProcessing.hlsl", "BlurV");
     bloom = CompilePSFromFile(device, L"PostProcessing.hlsl", "Bloom");
+    bloomDownsample = CompilePSFromFile(device, L"PostProcessing.hlsl", "BloomDownsample");
+    bloomUpsample = CompilePSFromFile(device, L"PostProcessing.hlsl", "BloomUpsample");
     sharpen = CompilePSFromFile(device, L"PostProcessing.hlsl", "Sharpen");
 
     reduceLuminanceInitial = CompileCSFromFile(device, L"LuminanceReduction.hlsl",
@@ -172,6 +177,19 @@ TempRenderTarget* PostProcessor::Bloom(ID3D11ShaderResourceView* input)
     outputs.push_back(bloomTarget->RTView);
     PostProcess(bloom, L"Bloom Initial Pass");
 
+    if(AppSettings::BloomMode == BloomModes::DualFilter)
+    {
+        if(AppSettings::ValidateBloom == false)
+            return BloomDualFilter(bloomTarget);
+
+        // The input has to be read back before the mip chain re-uses its render target
+        TextureData<Float4> input;
+        GetTextureData(device, bloomTarget->SRView, input);
+        TempRenderTarget* result = BloomDualFilter(bloomTarget);
+        ValidateBloomDualFilter(input, result);
+        return result;
+    }
+
     // Blur it
     for(uint64 i = 0; i < 2; ++i)
     {
@@ -185,6 +203,120 @@ TempRenderTarget* PostProcessor::Bloom(ID3D11ShaderResourceView* input)
     return bloomTarget;
 }
 
+// Blurs the bloom input by progressively downsampling it into a mip chain, and then upsampling
+// back up the chain with a tent filter. The cost is proportional to the pixel count, and not
+// to the blur radius.
+TempRenderTarget* PostProcessor::BloomDualFilter(TempRenderTarget* bloomTarget)
+{
+    TempRenderTarget* mipChain[MaxBloomMips] = { bloomTarget };
+    const uint32 targetNumMips = Clamp<uint32>(AppSettings::BloomMipCount, 1, MaxBloomMips);
+
+    uint32 numMips = 1;
+    while(numMips < targetNumMips)
+    {
+        TempRenderTarget* src = mipChain[numMips - 1];
+        if(src->Width == 1 && src->Height == 1)
+            break;
+
+        TempRenderTarget* dst = GetTempRenderTarget(std::max<uint32>(src->Width / 2, 1),
+                                                    std::max<uint32>(src->Height / 2, 1), src->Format);
+        PostProcess(src->SRView, dst->RTView, bloomDownsample, L"Bloom Downsample");
+        mipChain[numMips++] = dst;
+    }
+
+    TempRenderTarget* upsampled = mipChain[numMips - 1];
+    for(int64 mip = int64(numMips) - 2; mip >= 0; --mip)
+    {
+        TempRenderTarget* current = mipChain[mip];
+        TempRenderTarget* dst = GetTempRenderTarget(current->Width, current->Height, current->Format);
+        inputs.push_back(upsampled->SRView);
+        inputs.push_back(current->SRView);
+        outputs.push_back(dst->RTView);
+        PostProcess(bloomUpsample, L"Bloom Upsample");
+
+        upsampled->InUse = false;
+        current->InUse = false;
+        upsampled = dst;
+    }
+
+    return upsampled;
+}
+
+// CPU version of BloomDualFilter, using temp texture data for the mip chain
+void PostProcessor::BloomDualFilterCPU(const TextureData<Float4>& input, TextureData<Float4>& output)
+{
+    Assert_(&input != &output);
+
+    TempTextureData* tempMips[MaxBloomMips] = { nullptr };
+    const TextureData<Float4>* mipChain[MaxBloomMips] = { &input };
+    const uint32 targetNumMips = Clamp<uint32>(AppSettings::BloomMipCount, 1, MaxBloomMips);
+
+    uint32 numMips = 1;
+    while(numMips < targetNumMips)
+    {
+        const TextureData<Float4>* src = mipChain[numMips - 1];
+        if(src->Width == 1 && src->Height == 1)
+            break;
+
+        TempTextureData* dst = GetTempTextureData(std::max<uint32>(src->Width / 2, 1),
+                                                  std::max<uint32>(src->Height / 2, 1));
+        DownsampleTextureData(*src, dst->Data);
+        tempMips[numMips] = dst;
+        mipChain[numMips++] = &dst->Data;
+    }
+
+    if(numMips == 1)
+    {
+        output = input;
+        return;
+    }
+
+    const TextureData<Float4>* upsampled = mipChain[numMips - 1];
+    TempTextureData* upsampledTemp = tempMips[numMips - 1];
+    for(int64 mip = int64(numMips) - 2; mip >= 0; --mip)
+    {
+        const TextureData<Float4>* current = mipChain[mip];
+        TempTextureData* dst = mip > 0 ? GetTempTextureData(current->Width, current->Height) : nullptr;
+        TextureData<Float4>& dstData = mip > 0 ? dst->Data : output;
+        UpsampleTextureData(*upsampled, *current, AppSettings::BloomFilterRadius, dstData);
+
+        upsampledTemp->InUse = false;
+        if(tempMips[mip] != nullptr)
+            tempMips[mip]->InUse = false;
+
+        upsampled = &dstData;
+        upsampledTemp = dst;
+    }
+}
+
+// Compares the GPU dual filter bloom against the CPU version. The GPU mip chain is stored as
+// R11G11B10_FLOAT with only 5-6 bits of mantissa, so the comparison uses a relative tolerance.
+void PostProcessor::ValidateBloomDualFilter(const TextureData<Float4>& input, TempRenderTarget* gpuOutput)
+{
+    PIXEvent pixEvent(L"Bloom Validation");
+
+    TextureData<Float4> gpuResult;
+    GetTextureData(device, gpuOutput->SRView, gpuResult);
+
+    TempTextureData* cpuResult = GetTempTextureData(input.Width, input.Height);
+    BloomDualFilterCPU(input, cpuResult->Data);
+    Assert_(cpuResult->Data.Texels.size() == gpuResult.Texels.size());
+
+    float maxError = 0.0f;
+    for(uint64 i = 0; i < gpuResult.Texels.size(); ++i)
+    {
+        const Float4& gpu = gpuResult.Texels[i];
+        const Float4& cpu = cpuResult->Data.Texels[i];
+        maxError = std::max(maxError, std::abs(gpu.x - cpu.x) / (std::abs(cpu.x) + BloomValidationFloor));
+        maxError = std::max(maxError, std::abs(gpu.y - cpu.y) / (std::abs(cpu.y) + BloomValidationFloor));
+        maxError = std::max(maxError, std::abs(gpu.z - cpu.z) / (std::abs(cpu.z) + BloomValidationFloor));
+    }
+
+    AssertMsg_(maxError <= BloomValidationTolerance, "CPU and GPU dual filter bloom differ by %f", maxError);
+
+    cpuResult->InUse = false;
+}
+
 void PostProcessor::ToneMap(ID3D11ShaderResourceView* input,
                             ID3D11ShaderResourceView* bloom,
                             ID3D11RenderTargetView* output)
@@ -32,10 +32,14 @@ public:
 
     ID3D11ShaderResourceView* AdaptedLuminance() { return adaptedLuminance; }
 
+    void BloomDualFilterCPU(const TextureData<Float4>& input, TextureData<Float4>& output);
+
 protected:
 
     void CalcAvgLuminance(ID3D11ShaderResourceView* input);
     TempRenderTarget* Bloom(ID3D11ShaderResourceView* input);
+    TempRenderTarget* BloomDualFilter(TempRenderTarget* bloomTarget);
+    void ValidateBloomDualFilter(const TextureData<Float4>& input, TempRenderTarget* gpuOutput);
     void ToneMap(ID3D11ShaderResourceView* input,
                  ID3D11ShaderResourceView* bloom,
                  ID3D11RenderTargetView* output);
@@ -48,6 +52,8 @@ protected:
     PixelShaderPtr bloom;
     PixelShaderPtr blurH;
     PixelShaderPtr blurV;
+    PixelShaderPtr bloomDownsample;
+    PixelShaderPtr bloomUpsample;
     PixelShaderPtr sharpen;
 
     std::vector<RenderTarget2D> reductionTargets;
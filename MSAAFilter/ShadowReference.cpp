@@ -0,0 +1,237 @@
+//=================================================================================================
+//
+//  MSAA Filtering 2.0 Sample
+//  by MJP
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include <PCH.h>
+
+#include "ShadowReference.h"
+
+#include <Exceptions.h>
+#include <Utility.h>
+#include <TaskScheduler.h>
+
+#include "SharedConstants.h"
+
+namespace ShadowReference
+{
+
+// Constants
+static const float MaxEVSMExponent = 42.0f;
+static const float Log2E = 1.44269504f;
+
+// Matches GetEVSMExponents in EVSM.hlsl
+static Float2 GetEVSMExponents(float positiveExponent, float negativeExponent, Float3 cascadeScale)
+{
+    return Float2(std::min(positiveExponent / cascadeScale.z, MaxEVSMExponent),
+                  std::min(negativeExponent / cascadeScale.z, MaxEVSMExponent));
+}
+
+// Matches ConvertToEVSM in EVSMConvert.hlsl. Each SIMD lane works on a different texel, and the
+// moments get transposed back to one Float4 per texel once all samples have been accumulated.
+void ConvertToEVSM(const TextureData<float>& depthMap, Float3 cascadeScale, const EVSMParams& params,
+                   TextureData<Float4>& evsmMap)
+{
+    const uint32 numSamples = std::max<uint32>(depthMap.NumSlices, 1);
+    const uint64 numTexels = uint64(depthMap.Width) * depthMap.Height;
+    Assert_(depthMap.Texels.size() == numTexels * numSamples);
+
+    evsmMap.Init(depthMap.Width, depthMap.Height, 1);
+
+    const Float2 exponents = GetEVSMExponents(params.PositiveExponent, params.NegativeExponent, cascadeScale);
+
+    // XMVectorExp is base 2, so fold log2(e) into the exponents
+    const XMVECTOR posScale = XMVectorReplicate(exponents.x * Log2E);
+    const XMVECTOR negScale = XMVectorReplicate(-exponents.y * Log2E);
+    const XMVECTOR sampleWeight = XMVectorReplicate(1.0f / numSamples);
+    const XMVECTOR two = XMVectorReplicate(2.0f);
+    const XMVECTOR negOne = XMVectorReplicate(-1.0f);
+
+    for(uint64 texelIdx = 0; texelIdx < numTexels; texelIdx += 4)
+    {
+        const uint64 numValid = std::min<uint64>(numTexels - texelIdx, 4);
+
+        XMVECTOR pos = XMVectorZero();
+        XMVECTOR neg = XMVectorZero();
+        XMVECTOR pos2 = XMVectorZero();
+        XMVECTOR neg2 = XMVectorZero();
+        for(uint32 sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+        {
+            const float* src = &depthMap.Texels[sampleIdx * numTexels + texelIdx];
+            float depths[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            for(uint64 i = 0; i < numValid; ++i)
+                depths[i] = src[i];
+
+            // Rescale depth into [-1, 1]
+            XMVECTOR depth = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(depths)), two, negOne);
+
+            XMVECTOR warpedPos = XMVectorExp(XMVectorMultiply(depth, posScale));
+            XMVECTOR warpedNeg = XMVectorNegate(XMVectorExp(XMVectorMultiply(depth, negScale)));
+
+            pos = XMVectorMultiplyAdd(warpedPos, sampleWeight, pos);
+            neg = XMVectorMultiplyAdd(warpedNeg, sampleWeight, neg);
+            pos2 = XMVectorMultiplyAdd(XMVectorMultiply(warpedPos, warpedPos), sampleWeight, pos2);
+            neg2 = XMVectorMultiplyAdd(XMVectorMultiply(warpedNeg, warpedNeg), sampleWeight, neg2);
+        }
+
+        XMMATRIX moments = XMMatrixTranspose(XMMATRIX(pos, neg, pos2, neg2));
+        for(uint64 i = 0; i < numValid; ++i)
+            evsmMap.Texels[texelIdx + i] = Float4(moments.r[i]);
+    }
+}
+
+// Precomputes the box filter weights used by BlurEVSM in EVSMConvert.hlsl
+static void ComputeBlurKernel(float filterSize, uint32 sampleRadius, std::vector<float>& kernel)
+{
+    const float radius = filterSize / 2.0f;
+    kernel.resize(sampleRadius * 2 + 1);
+    for(int32 i = -int32(sampleRadius); i <= int32(sampleRadius); ++i)
+        kernel[i + sampleRadius] = Saturate((radius + 0.5f) - std::abs(float(i))) / filterSize;
+}
+
+// Samples past the lower edge are clamped, while samples past the upper edge read as zero. This
+// matches the out-of-bounds loads done by the shader.
+static void BlurEVSMPass(const TextureData<Float4>& src, const std::vector<float>& kernel, bool vertical,
+                         TextureData<Float4>& dst)
+{
+    const int32 width = int32(src.Width);
+    const int32 height = int32(src.Height);
+    const int32 sampleRadius = int32(kernel.size() / 2);
+
+    dst.Init(src.Width, src.Height, 1);
+
+    for(int32 y = 0; y < height; ++y)
+    {
+        for(int32 x = 0; x < width; ++x)
+        {
+            XMVECTOR sum = XMVectorZero();
+            for(int32 i = -sampleRadius; i <= sampleRadius; ++i)
+            {
+                const int32 sampleX = vertical ? x : std::max(x + i, 0);
+                const int32 sampleY = vertical ? std::max(y + i, 0) : y;
+                if(sampleX >= width || sampleY >= height)
+                    continue;
+
+                XMVECTOR sample = src.Texels[sampleY * width + sampleX].ToSIMD();
+                sum = XMVectorMultiplyAdd(sample, XMVectorReplicate(kernel[i + sampleRadius]), sum);
+            }
+
+            dst.Texels[y * width + x] = Float4(sum);
+        }
+    }
+}
+
+// Matches the separable blur done by MeshRenderer::ConvertToEVSM
+void BlurEVSM(TextureData<Float4>& evsmMap, Float3 cascadeScale, const EVSMParams& params)
+{
+    const float filterSizeU = std::max(params.FilterSize * cascadeScale.x, 1.0f);
+    const float filterSizeV = std::max(params.FilterSize * cascadeScale.y, 1.0f);
+    if(filterSizeU <= 1.0f && filterSizeV <= 1.0f)
+        return;
+
+    std::vector<float> kernel;
+    TextureData<Float4> temp;
+
+    ComputeBlurKernel(filterSizeU, params.SampleRadius, kernel);
+    BlurEVSMPass(evsmMap, kernel, false, temp);
+
+    ComputeBlurKernel(filterSizeV, params.SampleRadius, kernel);
+    BlurEVSMPass(temp, kernel, true, evsmMap);
+}
+
+void ProcessEVSMCascades(const TextureData<float>* depthMaps, const Float3* cascadeScales,
+                         uint32 numCascades, const EVSMParams& params, TextureData<Float4>* evsmMaps)
+{
+    ParallelFor(numCascades, 1, [&](uint64 start, uint64 end)
+    {
+        for(uint64 cascadeIdx = start; cascadeIdx < end; ++cascadeIdx)
+        {
+            ConvertToEVSM(depthMaps[cascadeIdx], cascadeScales[cascadeIdx], params, evsmMaps[cascadeIdx]);
+            BlurEVSM(evsmMaps[cascadeIdx], cascadeScales[cascadeIdx], params);
+        }
+    });
+}
+
+// Matches DepthReductionInitialCS followed by DepthReductionCS in DepthReduction.hlsl, with each
+// thread group reducing a tile of the previous pass. The GPU version stores the results as
+// R16G16_UNORM, so it will only match to within 1 / 65535.
+Float2 ReduceDepth(const TextureData<float>& depthMap, const Float4x4& projection,
+                   float nearClip, float farClip)
+{
+    const uint32 width = depthMap.Width;
+    const uint32 height = depthMap.Height;
+    const uint32 numSamples = std::max<uint32>(depthMap.NumSlices, 1);
+    const uint64 sliceSize = uint64(width) * height;
+    Assert_(depthMap.Texels.size() == sliceSize * numSamples);
+
+    // Initial pass, which converts to linear Z and ignores texels at the far plane
+    TextureData<Float2> reduction;
+    reduction.Init(DispatchSize(ReductionTGSize, width), DispatchSize(ReductionTGSize, height), 1);
+    for(uint32 tileY = 0; tileY < reduction.Height; ++tileY)
+    {
+        for(uint32 tileX = 0; tileX < reduction.Width; ++tileX)
+        {
+            Float2 tileDepth = Float2(1.0f, 0.0f);
+            for(uint32 y = 0; y < ReductionTGSize; ++y)
+            {
+                for(uint32 x = 0; x < ReductionTGSize; ++x)
+                {
+                    const uint32 sampleX = std::min(tileX * ReductionTGSize + x, width - 1);
+                    const uint32 sampleY = std::min(tileY * ReductionTGSize + y, height - 1);
+                    for(uint32 sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+                    {
+                        float depth = depthMap.Texels[sampleIdx * sliceSize + sampleY * width + sampleX];
+                        if(depth < 1.0f)
+                        {
+                            depth = projection._43 / (depth - projection._33);
+                            depth = Saturate((depth - nearClip) / (farClip - nearClip));
+                            tileDepth.x = std::min(tileDepth.x, depth);
+                            tileDepth.y = std::max(tileDepth.y, depth);
+                        }
+                    }
+                }
+            }
+
+            reduction.Texels[tileY * reduction.Width + tileX] = tileDepth;
+        }
+    }
+
+    // Keep reducing until we're down to 1 texel
+    while(reduction.Width > 1 || reduction.Height > 1)
+    {
+        TextureData<Float2> nextReduction;
+        nextReduction.Init(DispatchSize(ReductionTGSize, reduction.Width),
+                           DispatchSize(ReductionTGSize, reduction.Height), 1);
+        for(uint32 tileY = 0; tileY < nextReduction.Height; ++tileY)
+        {
+            for(uint32 tileX = 0; tileX < nextReduction.Width; ++tileX)
+            {
+                Float2 tileDepth = Float2(1.0f, 0.0f);
+                for(uint32 y = 0; y < ReductionTGSize; ++y)
+                {
+                    for(uint32 x = 0; x < ReductionTGSize; ++x)
+                    {
+                        const uint32 sampleX = std::min(tileX * ReductionTGSize + x, reduction.Width - 1);
+                        const uint32 sampleY = std::min(tileY * ReductionTGSize + y, reduction.Height - 1);
+                        const Float2& depth = reduction.Texels[sampleY * reduction.Width + sampleX];
+                        tileDepth.x = std::min(tileDepth.x, depth.x);
+                        tileDepth.y = std::max(tileDepth.y, depth.y);
+                    }
+                }
+
+                nextReduction.Texels[tileY * nextReduction.Width + tileX] = tileDepth;
+            }
+        }
+
+        reduction = std::move(nextReduction);
+    }
+
+    return reduction.Texels[0];
+}
+
+}
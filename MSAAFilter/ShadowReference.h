@@ -0,0 +1,48 @@
+//=================================================================================================
+//
+//  MSAA Filtering 2.0 Sample
+//  by MJP
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include <PCH.h>
+
+#include <SF11_Math.h>
+#include <Graphics\\Textures.h>
+
+using namespace SampleFramework11;
+
+// CPU implementations of the shadow map processing that MeshRenderer does on the GPU. These are
+// used for validating changes to the shadow filtering, and for measuring the cost of different
+// exponents and filter sizes without needing a GPU.
+namespace ShadowReference
+{
+
+struct EVSMParams
+{
+    float PositiveExponent = 40.0f;
+    float NegativeExponent = 8.0f;
+    float FilterSize = 7.0f;
+    uint32 SampleRadius = 3;
+};
+
+// Depth maps have one slice per MSAA sample, with depth values in [0, 1]
+void ConvertToEVSM(const TextureData<float>& depthMap, Float3 cascadeScale, const EVSMParams& params,
+                   TextureData<Float4>& evsmMap);
+
+void BlurEVSM(TextureData<Float4>& evsmMap, Float3 cascadeScale, const EVSMParams& params);
+
+// Converts and blurs all cascades in parallel
+void ProcessEVSMCascades(const TextureData<float>* depthMaps, const Float3* cascadeScales,
+                         uint32 numCascades, const EVSMParams& params, TextureData<Float4>* evsmMaps);
+
+// Returns the min and max linear depth of the depth map, normalized to the near/far clip range
+Float2 ReduceDepth(const TextureData<float>& depthMap, const Float4x4& projection,
+                   float nearClip, float farClip);
+
+}
@@ -12,10 +12,12 @@
 #include "App.h"
 #include "Exceptions.h"
 #include "Graphics\\Profiler.h"
+#include "Graphics\\ModelCache.h"
 #include "SF11_Math.h"
 #include "FileIO.h"
 #include "Settings.h"
 #include "TwHelper.h"
+#include "TaskScheduler.h"
 
 // AppSettings framework
 namespace AppSettings
@@ -50,6 +52,8 @@ int32 App::Run()
 {
     try
     {
+        InitializeTaskScheduler();
+
         if(createConsole)
         {
             Win32Call(AllocConsole());
@@ -141,6 +145,9 @@ int32 App::Run()
 
     ShutdownShaders();
 
+    FlushModelCache();
+    ShutdownTaskScheduler();
+
     TwCall(TwTerminate());
 
     if(createConsole)
@@ -0,0 +1,243 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "ChunkFile.h"
+
+namespace SampleFramework11
+{
+
+static uint64 AlignChunkOffset(uint64 offset)
+{
+    return (offset + ChunkAlignment - 1) & ~(ChunkAlignment - 1);
+}
+
+// Table entries from version 1 files, which didn't support compression
+struct ChunkTableEntryV1
+{
+    uint32 ID = 0;
+    uint32 Index = 0;
+    uint64 Offset = 0;
+    uint64 Size = 0;
+    Hash Checksum;
+};
+
+// GenerateHash takes an int for the length, so large chunks are hashed in pieces that are each
+// seeded with the hash of the previous piece
+static Hash ChunkChecksum(const void* data, uint64 size)
+{
+    const uint8* bytes = reinterpret_cast<const uint8*>(data);
+    Hash hash = GenerateHash(bytes, int(std::min<uint64>(size, INT_MAX)), 0);
+    for(uint64 offset = INT_MAX; offset < size; offset += INT_MAX)
+        hash = GenerateHash(bytes + offset, int(std::min<uint64>(size - offset, INT_MAX)), uint32(hash.A));
+
+    return hash;
+}
+
+// == ChunkFileWriter =============================================================================
+
+ChunkFileWriter::ChunkFileWriter(uint32 contentVersion_) : contentVersion(contentVersion_)
+{
+}
+
+void ChunkFileWriter::AddChunk(uint32 id, uint32 index, const void* data, uint64 size, bool compress)
+{
+    Chunk chunk;
+    chunk.ID = id;
+    chunk.Index = index;
+    chunk.RawSize = size;
+
+    if(compress && size > 0)
+    {
+        CompressBlocks(data, size, chunk.Data);
+        chunk.Compressed = chunk.Data.size() < size;
+    }
+
+    if(chunk.Compressed == false)
+    {
+        const uint8* bytes = reinterpret_cast<const uint8*>(data);
+        chunk.Data.assign(bytes, bytes + size);
+    }
+
+    chunks.push_back(std::move(chunk));
+}
+
+void ChunkFileWriter::Write(const wchar* filePath) const
+{
+    ChunkFileHeader header;
+    header.ContentVersion = contentVersion;
+    header.NumChunks = uint32(chunks.size());
+
+    std::vector<ChunkTableEntry> table(chunks.size());
+    uint64 offset = AlignChunkOffset(sizeof(ChunkFileHeader) + sizeof(ChunkTableEntry) * chunks.size());
+    for(uint64 i = 0; i < chunks.size(); ++i)
+    {
+        const Chunk& chunk = chunks[i];
+        ChunkTableEntry& entry = table[i];
+        entry.ID = chunk.ID;
+        entry.Index = chunk.Index;
+        entry.Offset = offset;
+        entry.Size = chunk.Data.size();
+        entry.RawSize = chunk.RawSize;
+        entry.Flags = chunk.Compressed ? CompressedChunkFlag : 0;
+        entry.Checksum = ChunkChecksum(chunk.Data.data(), chunk.Data.size());
+        offset = AlignChunkOffset(offset + entry.Size);
+    }
+
+    std::vector<uint8> fileData(size_t(offset), 0);
+    memcpy(fileData.data(), &header, sizeof(ChunkFileHeader));
+    if(table.size() > 0)
+        memcpy(fileData.data() + sizeof(ChunkFileHeader), table.data(), sizeof(ChunkTableEntry) * table.size());
+
+    for(uint64 i = 0; i < chunks.size(); ++i)
+        if(chunks[i].Data.size() > 0)
+            memcpy(fileData.data() + table[i].Offset, chunks[i].Data.data(), chunks[i].Data.size());
+
+    File file(filePath, FileOpenMode::Write);
+    file.Write(fileData.size(), fileData.data());
+}
+
+// == ChunkFileReader =============================================================================
+
+ChunkFileReader::ChunkFileReader(const wchar* filePath_) : filePath(filePath_), mapping(new MappedFile(filePath_))
+{
+    if(mapping->Size() < sizeof(ChunkFileHeader))
+        return;
+
+    memcpy(&header, mapping->Data(), sizeof(ChunkFileHeader));
+    if(header.Magic != ChunkFileMagic)
+        return;
+
+    if(header.ContainerVersion != ChunkFileVersion && header.ContainerVersion != 1)
+        throw Exception(L"Unsupported chunk file version in file " + filePath);
+
+    const uint64 entrySize = header.ContainerVersion == 1 ? sizeof(ChunkTableEntryV1) : sizeof(ChunkTableEntry);
+    const uint64 tableEnd = sizeof(ChunkFileHeader) + entrySize * uint64(header.NumChunks);
+    if(tableEnd > mapping->Size())
+        throw Exception(L"Chunk file " + filePath + L" is truncated");
+
+    table.resize(header.NumChunks);
+    const uint8* tableData = mapping->Data() + sizeof(ChunkFileHeader);
+    for(uint32 i = 0; i < header.NumChunks; ++i)
+    {
+        if(header.ContainerVersion == 1)
+        {
+            ChunkTableEntryV1 entryV1;
+            memcpy(&entryV1, tableData + i * entrySize, sizeof(ChunkTableEntryV1));
+            table[i].ID = entryV1.ID;
+            table[i].Index = entryV1.Index;
+            table[i].Offset = entryV1.Offset;
+            table[i].Size = entryV1.Size;
+            table[i].RawSize = entryV1.Size;
+            table[i].Checksum = entryV1.Checksum;
+        }
+        else
+        {
+            memcpy(&table[i], tableData + i * entrySize, sizeof(ChunkTableEntry));
+        }
+    }
+
+    for(uint32 i = 0; i < header.NumChunks; ++i)
+        if(table[i].Offset > mapping->Size() || table[i].Size > mapping->Size() - table[i].Offset)
+            throw Exception(L"Chunk file " + filePath + L" is truncated");
+
+    isChunkFile = true;
+}
+
+bool ChunkFileReader::HasChunk(uint32 id, uint32 index) const
+{
+    for(uint32 i = 0; i < header.NumChunks && isChunkFile; ++i)
+        if(table[i].ID == id && table[i].Index == index)
+            return true;
+
+    return false;
+}
+
+bool ChunkFileReader::ChunkCompressed(uint32 id, uint32 index) const
+{
+    return (FindChunk(id, index).Flags & CompressedChunkFlag) != 0;
+}
+
+const uint8* ChunkFileReader::ChunkData(uint32 id, uint32 index, uint64& size) const
+{
+    const ChunkTableEntry& entry = FindChunk(id, index);
+    Assert_((entry.Flags & CompressedChunkFlag) == 0);
+    if(entry.Flags & CompressedChunkFlag)
+        throw Exception(L"Compressed chunks in " + filePath + L" can't be referenced in place");
+
+    ValidateChunk(entry);
+    size = entry.Size;
+    return mapping->Data() + entry.Offset;
+}
+
+void ChunkFileReader::ReadChunk(uint32 id, uint32 index, std::vector<uint8>& data) const
+{
+    const ChunkTableEntry& entry = FindChunk(id, index);
+    ValidateChunk(entry);
+
+    const uint8* chunkData = mapping->Data() + entry.Offset;
+    if(entry.Flags & CompressedChunkFlag)
+    {
+        DecompressBlocks(chunkData, entry.Size, data);
+        if(data.size() != entry.RawSize)
+            throw Exception(L"Chunk file " + filePath + L" is corrupted");
+    }
+    else
+    {
+        data.assign(chunkData, chunkData + entry.Size);
+    }
+}
+
+void ChunkFileReader::ReadChunk(uint32 id, uint32 index, RawView<uint8>& view) const
+{
+    if(ChunkCompressed(id, index))
+    {
+        view.Map(nullptr, 0, nullptr);
+        ReadChunk(id, index, view.Storage);
+        return;
+    }
+
+    uint64 size = 0;
+    const uint8* data = ChunkData(id, index, size);
+    view.Map(data, size, mapping);
+}
+
+MappedFileReadSerializer ChunkFileReader::ChunkSerializer(uint32 id, uint32 index) const
+{
+    const ChunkTableEntry& entry = FindChunk(id, index);
+    if(entry.Flags & CompressedChunkFlag)
+    {
+        std::shared_ptr<std::vector<uint8>> buffer(new std::vector<uint8>());
+        ReadChunk(id, index, *buffer);
+        return MappedFileReadSerializer(buffer);
+    }
+
+    ValidateChunk(entry);
+    return MappedFileReadSerializer(mapping, entry.Offset, entry.Size);
+}
+
+const ChunkTableEntry& ChunkFileReader::FindChunk(uint32 id, uint32 index) const
+{
+    Assert_(isChunkFile);
+    for(uint32 i = 0; i < header.NumChunks; ++i)
+        if(table[i].ID == id && table[i].Index == index)
+            return table[i];
+
+    throw Exception(L"Chunk file " + filePath + L" is missing a required chunk");
+}
+
+void ChunkFileReader::ValidateChunk(const ChunkTableEntry& entry) const
+{
+    const Hash checksum = ChunkChecksum(mapping->Data() + entry.Offset, entry.Size);
+    if((checksum == entry.Checksum) == false)
+        throw Exception(L"Chunk file " + filePath + L" is corrupted");
+}
+
+}
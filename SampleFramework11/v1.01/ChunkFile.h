@@ -0,0 +1,177 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "PCH.h"
+
+#include "Exceptions.h"
+#include "FileIO.h"
+#include "MurmurHash.h"
+#include "Serialization.h"
+
+namespace SampleFramework11
+{
+
+// Binary container made up of a header, a table of contents, and a set of aligned chunks. Every
+// chunk is identified by a four-character code plus an index, and has its own checksum that's
+// only validated when the chunk is accessed. Chunks can optionally be block-compressed, in which
+// case the checksum covers the compressed data.
+
+static const uint32 ChunkFileMagic = 0x464B4843;     // 'CHKF'
+static const uint32 ChunkFileVersion = 2;
+static const uint64 ChunkAlignment = 64;
+
+inline uint32 MakeChunkID(char a, char b, char c, char d)
+{
+    return uint32(a) | (uint32(b) << 8) | (uint32(c) << 16) | (uint32(d) << 24);
+}
+
+struct ChunkFileHeader
+{
+    uint32 Magic = ChunkFileMagic;
+    uint32 ContainerVersion = ChunkFileVersion;
+    uint32 ContentVersion = 0;
+    uint32 NumChunks = 0;
+};
+
+static const uint32 CompressedChunkFlag = 0x1;
+
+struct ChunkTableEntry
+{
+    uint32 ID = 0;
+    uint32 Index = 0;
+    uint64 Offset = 0;
+    uint64 Size = 0;
+    uint64 RawSize = 0;
+    uint32 Flags = 0;
+    uint32 Padding = 0;
+    Hash Checksum;
+};
+
+class ChunkFileWriter
+{
+
+public:
+
+    explicit ChunkFileWriter(uint32 contentVersion);
+
+    // Compressed chunks are stored uncompressed if compression doesn't make them any smaller
+    void AddChunk(uint32 id, uint32 index, const void* data, uint64 size, bool compress = false);
+
+    template<typename T> void AddSerializedChunk(uint32 id, uint32 index, T& item, bool compress = false)
+    {
+        std::vector<uint8> buffer;
+        SerializeToMemory(item, buffer);
+        AddChunk(id, index, buffer.data(), buffer.size(), compress);
+    }
+
+    // Assembles the file in memory and writes it with a single write
+    void Write(const wchar* filePath) const;
+
+private:
+
+    struct Chunk
+    {
+        uint32 ID = 0;
+        uint32 Index = 0;
+        uint64 RawSize = 0;
+        bool Compressed = false;
+        std::vector<uint8> Data;
+    };
+
+    uint32 contentVersion = 0;
+    std::vector<Chunk> chunks;
+};
+
+class ChunkFileReader
+{
+
+public:
+
+    // Maps the file. Use IsChunkFile() to check whether it's actually a chunk file, since older
+    // files may be raw serialized streams.
+    explicit ChunkFileReader(const wchar* filePath);
+
+    bool IsChunkFile() const { return isChunkFile; }
+    uint32 ContentVersion() const { return header.ContentVersion; }
+
+    bool HasChunk(uint32 id, uint32 index = 0) const;
+    bool ChunkCompressed(uint32 id, uint32 index = 0) const;
+
+    // Returns a pointer into the mapping after validating the chunk's checksum. Only valid for
+    // uncompressed chunks, which are referenced in place.
+    const uint8* ChunkData(uint32 id, uint32 index, uint64& size) const;
+
+    // Copies or decompresses a chunk into a buffer, after validating its checksum
+    void ReadChunk(uint32 id, uint32 index, std::vector<uint8>& data) const;
+
+    // Uncompressed chunks are referenced in place, keeping the mapping alive through the view.
+    // Compressed chunks are decompressed into the view's storage.
+    void ReadChunk(uint32 id, uint32 index, RawView<uint8>& view) const;
+
+    // Returns a serializer that reads from a chunk, after validating its checksum
+    MappedFileReadSerializer ChunkSerializer(uint32 id, uint32 index) const;
+
+    template<typename T> void ReadSerializedChunk(uint32 id, uint32 index, T& item) const
+    {
+        MappedFileReadSerializer serializer = ChunkSerializer(id, index);
+        SerializeItem(serializer, item);
+    }
+
+    // Reads the whole file as a raw serialized stream, for files written before the container
+    template<typename T> void ReadLegacy(T& item) const
+    {
+        MappedFileReadSerializer serializer(mapping, 0, mapping->Size());
+        SerializeItem(serializer, item);
+    }
+
+    const std::shared_ptr<MappedFile>& Mapping() const { return mapping; }
+
+private:
+
+    const ChunkTableEntry& FindChunk(uint32 id, uint32 index) const;
+    void ValidateChunk(const ChunkTableEntry& entry) const;
+
+    std::wstring filePath;
+    std::shared_ptr<MappedFile> mapping;
+    ChunkFileHeader header;
+    std::vector<ChunkTableEntry> table;
+    bool isChunkFile = false;
+};
+
+// Convenience functions for storing a single serialized item in a chunk file. Reading falls back
+// to the raw serialized stream for files that predate the container.
+static const uint32 SerializedItemChunkID = 0x4D455449;  // 'ITEM'
+
+template<typename T>
+void SerializeToChunkFile(const wchar* filePath, uint32 contentVersion, T& item)
+{
+    ChunkFileWriter writer(contentVersion);
+    writer.AddSerializedChunk(SerializedItemChunkID, 0, item);
+    writer.Write(filePath);
+}
+
+template<typename T>
+void SerializeFromChunkFile(const wchar* filePath, uint32 contentVersion, T& item)
+{
+    ChunkFileReader reader(filePath);
+    if(reader.IsChunkFile() == false)
+    {
+        reader.ReadLegacy(item);
+        return;
+    }
+
+    if(reader.ContentVersion() != contentVersion)
+        throw Exception(std::wstring(L"Unsupported version in file ") + filePath);
+
+    reader.ReadSerializedChunk(SerializedItemChunkID, 0, item);
+}
+
+}
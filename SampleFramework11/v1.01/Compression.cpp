@@ -0,0 +1,182 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "Compression.h"
+#include "Exceptions.h"
+#include "TaskScheduler.h"
+
+namespace SampleFramework11
+{
+
+static const uint32 BlockStreamMagic = 0x5A4B4C42;   // 'BLKZ'
+static const uint32 StoredBlockFlag = 0x1;
+
+struct BlockStreamHeader
+{
+    uint32 Magic = BlockStreamMagic;
+    uint32 BlockSize = 0;
+    uint64 RawSize = 0;
+    uint64 NumBlocks = 0;
+};
+
+struct BlockEntry
+{
+    uint64 Offset = 0;
+    uint32 Size = 0;
+    uint32 Flags = 0;
+};
+
+// Deflate can't expand data by more than this, so it bounds the raw size of a compressed block
+static const uint64 MaxDeflateRatio = 1032;
+
+// Reads the header and checks it and the block table against the size of the stream, so that a
+// corrupted stream is rejected before anything is allocated for it
+static BlockStreamHeader ReadBlockStreamHeader(const void* data, uint64 size)
+{
+    if(IsBlockCompressed(data, size) == false)
+        throw Exception(L"Invalid block-compressed stream");
+
+    BlockStreamHeader header;
+    memcpy(&header, data, sizeof(BlockStreamHeader));
+    if(header.BlockSize == 0 || header.BlockSize > MaxCompressionBlockSize)
+        throw Exception(L"Invalid block-compressed stream");
+
+    const uint64 maxNumBlocks = (size - sizeof(BlockStreamHeader)) / sizeof(BlockEntry);
+    const uint64 numBlocks = header.RawSize / header.BlockSize + (header.RawSize % header.BlockSize != 0 ? 1 : 0);
+    if(header.NumBlocks != numBlocks || header.NumBlocks > maxNumBlocks)
+        throw Exception(L"Invalid block-compressed stream");
+
+    const uint8* src = reinterpret_cast<const uint8*>(data);
+    const uint64 tableEnd = sizeof(BlockStreamHeader) + sizeof(BlockEntry) * header.NumBlocks;
+    for(uint64 i = 0; i < header.NumBlocks; ++i)
+    {
+        BlockEntry entry;
+        memcpy(&entry, src + sizeof(BlockStreamHeader) + sizeof(BlockEntry) * i, sizeof(BlockEntry));
+        if(entry.Offset < tableEnd || entry.Offset > size || entry.Size > size - entry.Offset)
+            throw Exception(L"Invalid block-compressed stream");
+
+        const uint64 blockRawSize = std::min<uint64>(header.BlockSize, header.RawSize - i * header.BlockSize);
+        if(entry.Flags & StoredBlockFlag)
+        {
+            if(entry.Size != blockRawSize)
+                throw Exception(L"Invalid block-compressed stream");
+        }
+        else if(blockRawSize > entry.Size * MaxDeflateRatio)
+        {
+            throw Exception(L"Invalid block-compressed stream");
+        }
+    }
+
+    return header;
+}
+
+void CompressBlocks(const void* data, uint64 size, std::vector<uint8>& output, uint64 blockSize)
+{
+    Assert_(blockSize > 0 && blockSize <= MaxCompressionBlockSize);
+
+    BlockStreamHeader header;
+    header.BlockSize = uint32(blockSize);
+    header.RawSize = size;
+    header.NumBlocks = (size + blockSize - 1) / blockSize;
+
+    std::vector<BlockEntry> entries(size_t(header.NumBlocks));
+    std::vector<std::vector<uint8>> blocks(size_t(header.NumBlocks));
+
+    const uint8* src = reinterpret_cast<const uint8*>(data);
+    ParallelFor(header.NumBlocks, 1, [&](uint64 start, uint64 end)
+    {
+        for(uint64 i = start; i < end; ++i)
+        {
+            const uint8* blockSrc = src + i * blockSize;
+            const uint64 blockRawSize = std::min(blockSize, size - i * blockSize);
+
+            std::vector<uint8>& block = blocks[i];
+            block.resize(size_t(DeflateBound(blockRawSize)));
+            uint64 compressedSize = block.size();
+            if(DeflateCompress(blockSrc, blockRawSize, block.data(), compressedSize) && compressedSize < blockRawSize)
+            {
+                block.resize(size_t(compressedSize));
+            }
+            else
+            {
+                block.assign(blockSrc, blockSrc + blockRawSize);
+                entries[i].Flags = StoredBlockFlag;
+            }
+
+            entries[i].Size = uint32(block.size());
+        }
+    });
+
+    uint64 offset = sizeof(BlockStreamHeader) + sizeof(BlockEntry) * entries.size();
+    for(uint64 i = 0; i < entries.size(); ++i)
+    {
+        entries[i].Offset = offset;
+        offset += entries[i].Size;
+    }
+
+    output.resize(size_t(offset));
+    memcpy(output.data(), &header, sizeof(BlockStreamHeader));
+    if(entries.size() > 0)
+        memcpy(output.data() + sizeof(BlockStreamHeader), entries.data(), sizeof(BlockEntry) * entries.size());
+    for(uint64 i = 0; i < blocks.size(); ++i)
+        if(blocks[i].size() > 0)
+            memcpy(output.data() + entries[i].Offset, blocks[i].data(), blocks[i].size());
+}
+
+bool IsBlockCompressed(const void* data, uint64 size)
+{
+    if(size < sizeof(BlockStreamHeader))
+        return false;
+
+    BlockStreamHeader header;
+    memcpy(&header, data, sizeof(BlockStreamHeader));
+    return header.Magic == BlockStreamMagic;
+}
+
+uint64 BlockDecompressedSize(const void* data, uint64 size)
+{
+    return ReadBlockStreamHeader(data, size).RawSize;
+}
+
+void DecompressBlocks(const void* data, uint64 size, void* output, uint64 outputSize)
+{
+    const BlockStreamHeader header = ReadBlockStreamHeader(data, size);
+    if(header.RawSize != outputSize)
+        throw Exception(L"Invalid block-compressed stream");
+
+    const uint8* src = reinterpret_cast<const uint8*>(data);
+    uint8* dst = reinterpret_cast<uint8*>(output);
+    ParallelFor(header.NumBlocks, 1, [&](uint64 start, uint64 end)
+    {
+        for(uint64 i = start; i < end; ++i)
+        {
+            BlockEntry entry;
+            memcpy(&entry, src + sizeof(BlockStreamHeader) + sizeof(BlockEntry) * i, sizeof(BlockEntry));
+
+            uint8* blockDst = dst + i * header.BlockSize;
+            const uint64 blockRawSize = std::min<uint64>(header.BlockSize, header.RawSize - i * header.BlockSize);
+            if(entry.Flags & StoredBlockFlag)
+                memcpy(blockDst, src + entry.Offset, size_t(blockRawSize));
+            else if(DeflateDecompress(src + entry.Offset, entry.Size, blockDst, blockRawSize) == false)
+            {
+                throw Exception(L"Failed to decompress a block-compressed stream");
+            }
+        }
+    });
+}
+
+void DecompressBlocks(const void* data, uint64 size, std::vector<uint8>& output)
+{
+    output.resize(size_t(BlockDecompressedSize(data, size)));
+    DecompressBlocks(data, size, output.data(), output.size());
+}
+
+}
@@ -0,0 +1,38 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "PCH.h"
+
+namespace SampleFramework11
+{
+
+// Block-compressed streams. The data is split into fixed-size blocks that are deflated
+// independently, so that both compression and decompression can be spread across the task
+// scheduler. Blocks that don't compress are stored as-is.
+
+static const uint64 DefaultCompressionBlockSize = 256 * 1024;
+static const uint64 MaxCompressionBlockSize = 64 * 1024 * 1024;
+
+void CompressBlocks(const void* data, uint64 size, std::vector<uint8>& output,
+                    uint64 blockSize = DefaultCompressionBlockSize);
+
+bool IsBlockCompressed(const void* data, uint64 size);
+uint64 BlockDecompressedSize(const void* data, uint64 size);
+
+void DecompressBlocks(const void* data, uint64 size, void* output, uint64 outputSize);
+void DecompressBlocks(const void* data, uint64 size, std::vector<uint8>& output);
+
+// Raw deflate codec, implemented with the copy of miniz that's embedded in TinyEXR.cpp
+uint64 DeflateBound(uint64 size);
+bool DeflateCompress(const void* src, uint64 srcSize, void* dst, uint64& dstSize);
+bool DeflateDecompress(const void* src, uint64 srcSize, void* dst, uint64 dstSize);
+
+}
@@ -11,9 +11,64 @@
 
 #include "FileIO.h"
 
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <errno.h>
+#endif
+
 namespace SampleFramework11
 {
 
+#if !defined(_WIN32)
+
+// Converts a path to a UTF-8 path with forward slashes
+static std::string NativePath(const wchar* filePath)
+{
+    std::string path;
+    for(const wchar* c = filePath; *c != 0; ++c)
+    {
+        uint32 cp = uint32(*c);
+        if(cp == '\\')
+            cp = '/';
+
+        if(cp < 0x80)
+            path += char(cp);
+        else if(cp < 0x800)
+        {
+            path += char(0xC0 | (cp >> 6));
+            path += char(0x80 | (cp & 0x3F));
+        }
+        else if(cp < 0x10000)
+        {
+            path += char(0xE0 | (cp >> 12));
+            path += char(0x80 | ((cp >> 6) & 0x3F));
+            path += char(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            path += char(0xF0 | (cp >> 18));
+            path += char(0x80 | ((cp >> 12) & 0x3F));
+            path += char(0x80 | ((cp >> 6) & 0x3F));
+            path += char(0x80 | (cp & 0x3F));
+        }
+    }
+
+    return path;
+}
+
+static std::wstring ErrnoString()
+{
+    const std::string message = strerror(errno);
+    return std::wstring(message.begin(), message.end());
+}
+
+#endif
+
+#if defined(_WIN32)
+
 // Returns true if a file exits
 bool FileExists(const wchar* filePath)
 {
@@ -37,6 +92,74 @@ bool DirectoryExists(const wchar* dirPath)
     return (fileAttr != INVALID_FILE_ATTRIBUTES && (fileAttr & FILE_ATTRIBUTE_DIRECTORY));
 }
 
+// Creates a directory if it doesn't already exist. The parent directory needs to exist.
+void EnsureDirectoryExists(const wchar* dirPath)
+{
+    Assert_(dirPath);
+
+    if(CreateDirectory(dirPath, nullptr) == FALSE)
+    {
+        const DWORD error = GetLastError();
+        if(error != ERROR_ALREADY_EXISTS)
+            throw Win32Exception(error);
+    }
+}
+
+// Gets the last written timestamp of the file
+uint64 GetFileTimestamp(const wchar* filePath)
+{
+    Assert_(filePath);
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    Win32Call(GetFileAttributesEx(filePath, GetFileExInfoStandard, &attributes));
+    return attributes.ftLastWriteTime.dwLowDateTime | (uint64(attributes.ftLastWriteTime.dwHighDateTime) << 32);
+}
+
+#else
+
+// Returns true if a file exits
+bool FileExists(const wchar* filePath)
+{
+    if(filePath == NULL)
+        return false;
+
+    struct stat fileStats;
+    return stat(NativePath(filePath).c_str(), &fileStats) == 0;
+}
+
+// Returns true if a directory exists
+bool DirectoryExists(const wchar* dirPath)
+{
+    if(dirPath == NULL)
+        return false;
+
+    struct stat fileStats;
+    return stat(NativePath(dirPath).c_str(), &fileStats) == 0 && S_ISDIR(fileStats.st_mode);
+}
+
+// Creates a directory if it doesn't already exist. The parent directory needs to exist.
+void EnsureDirectoryExists(const wchar* dirPath)
+{
+    Assert_(dirPath);
+
+    if(mkdir(NativePath(dirPath).c_str(), 0755) != 0 && errno != EEXIST)
+        throw Exception(std::wstring(L"Failed to create directory ") + dirPath + L":\n" + ErrnoString());
+}
+
+// Gets the last written timestamp of the file, in nanoseconds
+uint64 GetFileTimestamp(const wchar* filePath)
+{
+    Assert_(filePath);
+
+    struct stat fileStats;
+    if(stat(NativePath(filePath).c_str(), &fileStats) != 0)
+        throw Exception(std::wstring(L"Failed to get the timestamp of file ") + filePath + L":\n" + ErrnoString());
+
+    return uint64(fileStats.st_mtim.tv_sec) * 1000000000ull + uint64(fileStats.st_mtim.tv_nsec);
+}
+
+#endif
+
 
 // Returns the directory containing a file
 std::wstring GetDirectoryFromFilePath(const wchar* filePath_)
@@ -44,7 +167,7 @@ std::wstring GetDirectoryFromFilePath(const wchar* filePath_)
     Assert_(filePath_);
 
     std::wstring filePath(filePath_);
-    size_t idx = filePath.rfind(L'\\');
+    size_t idx = filePath.find_last_of(L"\\/");
     if(idx != std::wstring::npos)
         return filePath.substr(0, idx + 1);
     else
@@ -103,14 +226,15 @@ std::wstring GetFileExtension(const wchar* filePath_)
         return std::wstring(L"");
 }
 
-// Gets the last written timestamp of the file
-uint64 GetFileTimestamp(const wchar* filePath)
+// Appends a file or directory name to a directory path, adding a separator if needed
+std::wstring CombinePaths(const wchar* dirPath, const wchar* name)
 {
-    Assert_(filePath);
+    Assert_(dirPath && name);
 
-    WIN32_FILE_ATTRIBUTE_DATA attributes;
-    Win32Call(GetFileAttributesEx(filePath, GetFileExInfoStandard, &attributes));
-    return attributes.ftLastWriteTime.dwLowDateTime | (uint64(attributes.ftLastWriteTime.dwHighDateTime) << 32);
+    std::wstring path(dirPath);
+    if(path.length() > 0 && path.back() != L'\\' && path.back() != L'/')
+        path += L'\\';
+    return path + name;
 }
 
 // Returns the contents of a file as a string
@@ -133,8 +257,24 @@ void WriteStringAsFile(const wchar* filePath, const std::string& data)
     file.Write(data.length(), data.c_str());
 }
 
+// Reads the entire contents of a file from a task
+TaskHandle ReadFileAsync(const wchar* filePath, std::vector<uint8>& data)
+{
+    const std::wstring path(filePath);
+    std::vector<uint8>* dst = &data;
+    return SubmitTask([path, dst]()
+    {
+        File file(path.c_str(), FileOpenMode::Read);
+        dst->resize(size_t(file.Size()));
+        if(dst->size() > 0)
+            file.Read(dst->size(), dst->data());
+    });
+}
+
 // == File ========================================================================================
 
+#if defined(_WIN32)
+
 File::File() : fileHandle(INVALID_HANDLE_VALUE), openMode(FileOpenMode::Read)
 {
 }
@@ -206,13 +346,55 @@ void File::Read(uint64 size, void* data) const
     Win32Call(ReadFile(fileHandle, data, static_cast<DWORD>(size), &bytesRead, NULL));
 }
 
+void File::ReadAt(uint64 offset, uint64 size, void* data) const
+{
+    Assert_(fileHandle != INVALID_HANDLE_VALUE);
+    Assert_(openMode == FileOpenMode::Read);
+
+    // ReadFile moves the file pointer of a synchronous handle even when it's given an offset
+    const LARGE_INTEGER zero = { };
+    LARGE_INTEGER position = { };
+    Win32Call(SetFilePointerEx(fileHandle, zero, &position, FILE_CURRENT));
+
+    uint8* bytes = reinterpret_cast<uint8*>(data);
+    while(size > 0)
+    {
+        OVERLAPPED overlapped = { };
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        const DWORD readSize = static_cast<DWORD>(std::min<uint64>(size, 0xFFFFFFFF));
+        DWORD bytesRead = 0;
+        Win32Call(ReadFile(fileHandle, bytes, readSize, &bytesRead, &overlapped));
+        if(bytesRead != readSize)
+            throw Exception(L"Attempted to read past the end of a file");
+
+        bytes += readSize;
+        offset += readSize;
+        size -= readSize;
+    }
+
+    Win32Call(SetFilePointerEx(fileHandle, position, nullptr, FILE_BEGIN));
+}
+
 void File::Write(uint64 size, const void* data) const
 {
     Assert_(fileHandle != INVALID_HANDLE_VALUE);
     Assert_(openMode == FileOpenMode::Write);
 
-    DWORD bytesWritten = 0;
-    Win32Call(WriteFile(fileHandle, data, static_cast<DWORD>(size), &bytesWritten, NULL));
+    // WriteFile is limited to 4GB per call, so anything larger needs to be split up
+    const uint8* bytes = reinterpret_cast<const uint8*>(data);
+    while(size > 0)
+    {
+        const DWORD writeSize = static_cast<DWORD>(std::min<uint64>(size, 0xFFFFFFFF));
+        DWORD bytesWritten = 0;
+        Win32Call(WriteFile(fileHandle, bytes, writeSize, &bytesWritten, NULL));
+        if(bytesWritten != writeSize)
+            throw Exception(L"Failed to write all of the data to a file");
+
+        bytes += writeSize;
+        size -= writeSize;
+    }
 }
 
 uint64 File::Size() const
@@ -225,4 +407,247 @@ uint64 File::Size() const
     return fileSize.QuadPart;
 }
 
+#else
+
+File::File() : fileDescriptor(-1), openMode(FileOpenMode::Read)
+{
+}
+
+File::File(const wchar* filePath, FileOpenMode openMode) : fileDescriptor(-1),
+                                                           openMode(FileOpenMode::Read)
+{
+    Open(filePath, openMode);
+}
+
+File::~File()
+{
+    Close();
+    Assert_(fileDescriptor == -1);
+}
+
+void File::Open(const wchar* filePath, FileOpenMode openMode_)
+{
+    Assert_(fileDescriptor == -1);
+    openMode = openMode_;
+
+    const std::string path = NativePath(filePath);
+    if(openMode == FileOpenMode::Read)
+        fileDescriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    else
+        fileDescriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if(fileDescriptor == -1)
+    {
+        std::wstring errMsg = std::wstring(L"Failed to open file ") + filePath + L":\n" + ErrnoString();
+        Assert_(false);
+        throw Exception(errMsg);
+    }
+
+    // Files are almost always read front-to-back, so let the kernel read ahead aggressively
+    if(openMode == FileOpenMode::Read)
+        posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+void File::Close()
+{
+    if(fileDescriptor == -1)
+        return;
+
+    close(fileDescriptor);
+    fileDescriptor = -1;
+}
+
+void File::Read(uint64 size, void* data) const
+{
+    Assert_(fileDescriptor != -1);
+    Assert_(openMode == FileOpenMode::Read);
+
+    uint8* bytes = reinterpret_cast<uint8*>(data);
+    while(size > 0)
+    {
+        const ssize_t bytesRead = read(fileDescriptor, bytes, size_t(size));
+        if(bytesRead < 0 && errno == EINTR)
+            continue;
+        if(bytesRead == 0)
+            throw Exception(L"Attempted to read past the end of a file");
+        if(bytesRead < 0)
+            throw Exception(L"Failed to read from a file:\n" + ErrnoString());
+
+        bytes += bytesRead;
+        size -= uint64(bytesRead);
+    }
+}
+
+void File::ReadAt(uint64 offset, uint64 size, void* data) const
+{
+    Assert_(fileDescriptor != -1);
+    Assert_(openMode == FileOpenMode::Read);
+
+    uint8* bytes = reinterpret_cast<uint8*>(data);
+    while(size > 0)
+    {
+        const ssize_t bytesRead = pread(fileDescriptor, bytes, size_t(size), off_t(offset));
+        if(bytesRead < 0 && errno == EINTR)
+            continue;
+        if(bytesRead == 0)
+            throw Exception(L"Attempted to read past the end of a file");
+        if(bytesRead < 0)
+            throw Exception(L"Failed to read from a file:\n" + ErrnoString());
+
+        bytes += bytesRead;
+        offset += uint64(bytesRead);
+        size -= uint64(bytesRead);
+    }
+}
+
+void File::Write(uint64 size, const void* data) const
+{
+    Assert_(fileDescriptor != -1);
+    Assert_(openMode == FileOpenMode::Write);
+
+    const uint8* bytes = reinterpret_cast<const uint8*>(data);
+    while(size > 0)
+    {
+        const ssize_t bytesWritten = write(fileDescriptor, bytes, size_t(size));
+        if(bytesWritten < 0 && errno == EINTR)
+            continue;
+        if(bytesWritten <= 0)
+            throw Exception(L"Failed to write to a file:\n" + ErrnoString());
+
+        bytes += bytesWritten;
+        size -= uint64(bytesWritten);
+    }
+}
+
+uint64 File::Size() const
+{
+    Assert_(fileDescriptor != -1);
+
+    struct stat fileStats;
+    if(fstat(fileDescriptor, &fileStats) != 0)
+        throw Exception(L"Failed to query the size of a file:\n" + ErrnoString());
+
+    return uint64(fileStats.st_size);
+}
+
+#endif
+
+// == MappedFile ==================================================================================
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const wchar* filePath)
+{
+    Open(filePath);
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#if defined(_WIN32)
+
+void MappedFile::Open(const wchar* filePath)
+{
+    Assert_(fileHandle == INVALID_HANDLE_VALUE);
+
+    fileHandle = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(fileHandle == INVALID_HANDLE_VALUE)
+    {
+        std::wstring errMsg = std::wstring(L"Failed to open file ") + filePath + L":\n" + GetWin32ErrorString(GetLastError());
+        Assert_(false);
+        throw Exception(errMsg);
+    }
+
+    LARGE_INTEGER fileSize;
+    Win32Call(GetFileSizeEx(fileHandle, &fileSize));
+    size = fileSize.QuadPart;
+
+    // Empty files can't be mapped
+    if(size == 0)
+        return;
+
+    mappingHandle = CreateFileMapping(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mappingHandle == NULL)
+    {
+        std::wstring errMsg = std::wstring(L"Failed to map file ") + filePath + L":\n" + GetWin32ErrorString(GetLastError());
+        Close();
+        throw Exception(errMsg);
+    }
+
+    data = reinterpret_cast<const uint8*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if(data == nullptr)
+    {
+        std::wstring errMsg = std::wstring(L"Failed to map file ") + filePath + L":\n" + GetWin32ErrorString(GetLastError());
+        Close();
+        throw Exception(errMsg);
+    }
+}
+
+void MappedFile::Close()
+{
+    if(data != nullptr)
+        Win32Call(UnmapViewOfFile(data));
+    if(mappingHandle != NULL)
+        Win32Call(CloseHandle(mappingHandle));
+    if(fileHandle != INVALID_HANDLE_VALUE)
+        Win32Call(CloseHandle(fileHandle));
+
+    data = nullptr;
+    size = 0;
+    mappingHandle = NULL;
+    fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+void MappedFile::Open(const wchar* filePath)
+{
+    Assert_(fileDescriptor == -1);
+
+    fileDescriptor = open(NativePath(filePath).c_str(), O_RDONLY | O_CLOEXEC);
+    if(fileDescriptor == -1)
+        throw Exception(std::wstring(L"Failed to open file ") + filePath + L":\n" + ErrnoString());
+
+    struct stat fileStats;
+    if(fstat(fileDescriptor, &fileStats) != 0)
+    {
+        Close();
+        throw Exception(std::wstring(L"Failed to query the size of file ") + filePath);
+    }
+
+    size = uint64(fileStats.st_size);
+    if(size == 0)
+        return;
+
+    void* mapping = mmap(nullptr, size_t(size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if(mapping == MAP_FAILED)
+    {
+        Close();
+        throw Exception(std::wstring(L"Failed to map file ") + filePath + L":\n" + ErrnoString());
+    }
+
+    // Serialized data is read front-to-back, so let the kernel read ahead aggressively
+    madvise(mapping, size_t(size), MADV_SEQUENTIAL);
+    data = reinterpret_cast<const uint8*>(mapping);
+}
+
+void MappedFile::Close()
+{
+    if(data != nullptr)
+        munmap(const_cast<uint8*>(data), size_t(size));
+    if(fileDescriptor != -1)
+        close(fileDescriptor);
+
+    data = nullptr;
+    size = 0;
+    fileDescriptor = -1;
+}
+
+#endif
+
 }
\ No newline at end of file
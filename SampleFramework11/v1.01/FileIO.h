@@ -13,6 +13,7 @@
 
 #include "Exceptions.h"
 #include "Utility.h"
+#include "TaskScheduler.h"
 
 namespace SampleFramework11
 {
@@ -20,16 +21,22 @@ namespace SampleFramework11
 // Utility functions
 bool FileExists(const wchar* filePath);
 bool DirectoryExists(const wchar* dirPath);
+void EnsureDirectoryExists(const wchar* dirPath);
 std::wstring GetDirectoryFromFilePath(const wchar* filePath);
 std::wstring GetFileName(const wchar* filePath);
 std::wstring GetFileNameWithoutExtension(const wchar* filePath);
 std::wstring GetFilePathWithoutExtension(const wchar* filePath);
 std::wstring GetFileExtension(const wchar* filePath);
+std::wstring CombinePaths(const wchar* dirPath, const wchar* name);
 uint64 GetFileTimestamp(const wchar* filePath);
 
 std::string ReadFileAsString(const wchar* filePath);
 void WriteStringAsFile(const wchar* filePath, const std::string& data);
 
+// Reads the entire contents of a file from a task. The destination must stay alive until the task
+// completes.
+TaskHandle ReadFileAsync(const wchar* filePath, std::vector<uint8>& data);
+
 enum class FileOpenMode
 {
     Read = 0,
@@ -41,7 +48,11 @@ class File
 
 private:
 
+#if defined(_WIN32)
     HANDLE fileHandle;
+#else
+    int fileDescriptor;
+#endif
     FileOpenMode openMode;
 
 public:
@@ -59,6 +70,10 @@ public:
     void Read(uint64 size, void* data) const;
     void Write(uint64 size, const void* data) const;
 
+    // Reads from an absolute offset, leaving the current read position unchanged. On Windows the
+    // position is saved and restored around the read, so it can't overlap a Read() on another thread.
+    void ReadAt(uint64 offset, uint64 size, void* data) const;
+
     template<typename T> void Read(T& data) const;
     template<typename T> void Write(const T& data) const;
 
@@ -66,6 +81,42 @@ public:
     uint64 Size() const;
 };
 
+// Read-only memory mapping of an entire file. Pages are faulted in on first access, so reading
+// from the mapping doesn't need a syscall per read.
+class MappedFile
+{
+
+private:
+
+#if defined(_WIN32)
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#else
+    int fileDescriptor = -1;
+#endif
+
+    const uint8* data = nullptr;
+    uint64 size = 0;
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+public:
+
+    // Lifetime
+    MappedFile();
+    explicit MappedFile(const wchar* filePath);
+    ~MappedFile();
+
+    // Explicit Open and close
+    void Open(const wchar* filePath);
+    void Close();
+
+    // Accessors
+    const uint8* Data() const { return data; }
+    uint64 Size() const { return size; }
+};
+
 // == File ========================================================================================
 
 template<typename T> void File::Read(T& data) const
@@ -83,14 +134,14 @@ template<typename T> void File::Write(const T& data) const
 // Reads a POD type from a file
 template<typename T> void ReadFromFile(const wchar* fileName, T& val)
 {
-    File file(fileName, File::OpenRead);
+    File file(fileName, FileOpenMode::Read);
     file.Read(val);
 }
 
 // Writes a POD type to a file
 template<typename T> void WriteToFile(const wchar* fileName, const T& val)
 {
-    File file(fileName, File::OpenWrite);
+    File file(fileName, FileOpenMode::Write);
     file.Write(val);
 }
 
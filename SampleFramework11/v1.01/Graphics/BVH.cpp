@@ -0,0 +1,462 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "BVH.h"
+
+#include "..\\TaskScheduler.h"
+
+namespace SampleFramework11
+{
+
+// Relative costs of visiting a node and intersecting a triangle, for the SAH
+static const float TraversalCost = 1.0f;
+static const float IntersectionCost = 1.0f;
+
+// Subtrees with more triangles than this are built as separate tasks
+static const uint64 ParallelBuildThreshold = 4096;
+
+// Past this depth nodes are split at the median, which bounds the depth of the tree so that the
+// traversal stack can't overflow
+static const uint32 MedianSplitDepth = 48;
+static const uint32 TraversalStackSize = 96;
+
+static const uint64 VertexBatchSize = 4096;
+
+struct BuildNode
+{
+    Float3 Min;
+    Float3 Max;
+    uint64 Start = 0;
+    uint64 Count = 0;
+    uint64 NumNodes = 1;
+    std::unique_ptr<BuildNode> Children[2];
+};
+
+struct BuildContext
+{
+    std::vector<uint32> Order;
+    std::vector<Float3> TriangleMin;
+    std::vector<Float3> TriangleMax;
+    std::vector<Float3> Centroids;
+};
+
+static float SurfaceArea(FXMVECTOR minBounds, FXMVECTOR maxBounds)
+{
+    const XMVECTOR extents = XMVectorMax(XMVectorSubtract(maxBounds, minBounds), XMVectorZero());
+    const XMVECTOR areas = XMVectorMultiply(extents, XMVectorSwizzle<1, 2, 0, 3>(extents));
+    return 2.0f * (XMVectorGetX(areas) + XMVectorGetY(areas) + XMVectorGetZ(areas));
+}
+
+static uint32 CentroidBin(float centroid, float centroidMin, float binScale)
+{
+    const uint32 bin = uint32((centroid - centroidMin) * binScale);
+    return std::min(bin, BVH::NumBins - 1);
+}
+
+static std::unique_ptr<BuildNode> BuildRecursive(BuildContext& context, uint64 start, uint64 end, uint32 depth)
+{
+    std::unique_ptr<BuildNode> node(new BuildNode());
+    node->Start = start;
+    node->Count = end - start;
+
+    XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+    XMVECTOR centroidMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR centroidMax = XMVectorReplicate(-FLT_MAX);
+    for(uint64 i = start; i < end; ++i)
+    {
+        const uint32 triangleID = context.Order[i];
+        boundsMin = XMVectorMin(boundsMin, context.TriangleMin[triangleID].ToSIMD());
+        boundsMax = XMVectorMax(boundsMax, context.TriangleMax[triangleID].ToSIMD());
+        centroidMin = XMVectorMin(centroidMin, context.Centroids[triangleID].ToSIMD());
+        centroidMax = XMVectorMax(centroidMax, context.Centroids[triangleID].ToSIMD());
+    }
+
+    node->Min = boundsMin;
+    node->Max = boundsMax;
+
+    const uint64 count = end - start;
+    if(count <= 1)
+        return node;
+
+    // Split along the axis where the centroids are spread out the most
+    const Float3 centroidExtent = XMVectorSubtract(centroidMax, centroidMin);
+    uint32 axis = 0;
+    if(centroidExtent.y > centroidExtent[axis])
+        axis = 1;
+    if(centroidExtent.z > centroidExtent[axis])
+        axis = 2;
+
+    uint32* order = context.Order.data();
+    uint64 mid = start + count / 2;
+    if(centroidExtent[axis] <= 0.0f)
+    {
+        // All of the centroids are in the same spot, so there's nothing to gain by splitting
+        if(count <= BVH::MaxLeafTriangles)
+            return node;
+    }
+    else if(depth >= MedianSplitDepth)
+    {
+        std::nth_element(order + start, order + mid, order + end, [&](uint32 a, uint32 b)
+        {
+            return context.Centroids[a][axis] < context.Centroids[b][axis];
+        });
+    }
+    else
+    {
+        const float axisMin = Float3(centroidMin)[axis];
+        const float binScale = BVH::NumBins / centroidExtent[axis];
+
+        uint64 binCounts[BVH::NumBins] = { };
+        XMVECTOR binMin[BVH::NumBins];
+        XMVECTOR binMax[BVH::NumBins];
+        for(uint32 i = 0; i < BVH::NumBins; ++i)
+        {
+            binMin[i] = XMVectorReplicate(FLT_MAX);
+            binMax[i] = XMVectorReplicate(-FLT_MAX);
+        }
+
+        for(uint64 i = start; i < end; ++i)
+        {
+            const uint32 triangleID = order[i];
+            const uint32 bin = CentroidBin(context.Centroids[triangleID][axis], axisMin, binScale);
+            ++binCounts[bin];
+            binMin[bin] = XMVectorMin(binMin[bin], context.TriangleMin[triangleID].ToSIMD());
+            binMax[bin] = XMVectorMax(binMax[bin], context.TriangleMax[triangleID].ToSIMD());
+        }
+
+        // Sweep from the right to get the area and count on the right side of each split, and
+        // then sweep from the left to evaluate the SAH for each split
+        float rightAreas[BVH::NumBins] = { };
+        uint64 rightCounts[BVH::NumBins] = { };
+        XMVECTOR sweepMin = XMVectorReplicate(FLT_MAX);
+        XMVECTOR sweepMax = XMVectorReplicate(-FLT_MAX);
+        uint64 sweepCount = 0;
+        for(uint32 i = BVH::NumBins - 1; i > 0; --i)
+        {
+            sweepMin = XMVectorMin(sweepMin, binMin[i]);
+            sweepMax = XMVectorMax(sweepMax, binMax[i]);
+            sweepCount += binCounts[i];
+            rightAreas[i] = sweepCount > 0 ? SurfaceArea(sweepMin, sweepMax) : 0.0f;
+            rightCounts[i] = sweepCount;
+        }
+
+        float bestCost = FLT_MAX;
+        uint32 bestSplit = 0;
+        sweepMin = XMVectorReplicate(FLT_MAX);
+        sweepMax = XMVectorReplicate(-FLT_MAX);
+        sweepCount = 0;
+        for(uint32 i = 0; i < BVH::NumBins - 1; ++i)
+        {
+            sweepMin = XMVectorMin(sweepMin, binMin[i]);
+            sweepMax = XMVectorMax(sweepMax, binMax[i]);
+            sweepCount += binCounts[i];
+            if(sweepCount == 0 || rightCounts[i + 1] == 0)
+                continue;
+
+            const float cost = SurfaceArea(sweepMin, sweepMax) * sweepCount + rightAreas[i + 1] * rightCounts[i + 1];
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+
+        const float nodeArea = SurfaceArea(boundsMin, boundsMax);
+        const float splitCost = TraversalCost + IntersectionCost * bestCost / std::max(nodeArea, 1e-20f);
+        const float leafCost = IntersectionCost * count;
+        if(splitCost >= leafCost && count <= BVH::MaxLeafTriangles)
+            return node;
+
+        if(bestCost < FLT_MAX)
+        {
+            uint32* midPtr = std::partition(order + start, order + end, [&](uint32 triangleID)
+            {
+                return CentroidBin(context.Centroids[triangleID][axis], axisMin, binScale) <= bestSplit;
+            });
+            mid = midPtr - order;
+        }
+    }
+
+    node->Count = 0;
+    if(count > ParallelBuildThreshold)
+    {
+        TaskHandle leftTask = SubmitTask([&]()
+        {
+            node->Children[0] = BuildRecursive(context, start, mid, depth + 1);
+        });
+        node->Children[1] = BuildRecursive(context, mid, end, depth + 1);
+        WaitForTask(leftTask);
+    }
+    else
+    {
+        node->Children[0] = BuildRecursive(context, start, mid, depth + 1);
+        node->Children[1] = BuildRecursive(context, mid, end, depth + 1);
+    }
+
+    node->NumNodes = 1 + node->Children[0]->NumNodes + node->Children[1]->NumNodes;
+    return node;
+}
+
+// Writes the subtree in depth-first order, with the first child directly after its parent
+static void Flatten(const BuildNode& buildNode, std::vector<BVHNode>& nodes, uint64 nodeIdx)
+{
+    BVHNode& node = nodes[nodeIdx];
+    node.Min = buildNode.Min;
+    node.Max = buildNode.Max;
+
+    if(buildNode.Count > 0)
+    {
+        node.Offset = uint32(buildNode.Start);
+        node.Count = uint32(buildNode.Count);
+        return;
+    }
+
+    const uint64 secondChildIdx = nodeIdx + 1 + buildNode.Children[0]->NumNodes;
+    node.Offset = uint32(secondChildIdx);
+    node.Count = 0;
+
+    Flatten(*buildNode.Children[0], nodes, nodeIdx + 1);
+    Flatten(*buildNode.Children[1], nodes, secondChildIdx);
+}
+
+void BVH::Build(const uint8* positions, uint32 positionStride, const uint32* indices, uint64 numTriangles)
+{
+    nodes.clear();
+    triangleIDs.clear();
+    objectVertices.clear();
+    vertices.clear();
+
+    if(numTriangles == 0)
+        return;
+
+    BuildContext context;
+    context.Order.resize(numTriangles);
+    context.TriangleMin.resize(numTriangles);
+    context.TriangleMax.resize(numTriangles);
+    context.Centroids.resize(numTriangles);
+
+    ParallelFor(numTriangles, VertexBatchSize, [&](uint64 start, uint64 end)
+    {
+        for(uint64 triIdx = start; triIdx < end; ++triIdx)
+        {
+            XMVECTOR triMin = XMVectorReplicate(FLT_MAX);
+            XMVECTOR triMax = XMVectorReplicate(-FLT_MAX);
+            for(uint64 i = 0; i < 3; ++i)
+            {
+                const uint8* position = positions + uint64(indices[triIdx * 3 + i]) * positionStride;
+                const XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(position));
+                triMin = XMVectorMin(triMin, p);
+                triMax = XMVectorMax(triMax, p);
+            }
+
+            context.Order[triIdx] = uint32(triIdx);
+            context.TriangleMin[triIdx] = triMin;
+            context.TriangleMax[triIdx] = triMax;
+            context.Centroids[triIdx] = XMVectorScale(XMVectorAdd(triMin, triMax), 0.5f);
+        }
+    });
+
+    std::unique_ptr<BuildNode> root = BuildRecursive(context, 0, numTriangles, 0);
+
+    nodes.resize(root->NumNodes);
+    Flatten(*root, nodes, 0);
+
+    // The leaves reference contiguous ranges of the final triangle order
+    triangleIDs.swap(context.Order);
+    objectVertices.resize(numTriangles * 3);
+    ParallelFor(numTriangles, VertexBatchSize, [&](uint64 start, uint64 end)
+    {
+        for(uint64 i = start; i < end; ++i)
+            for(uint64 j = 0; j < 3; ++j)
+                objectVertices[i * 3 + j] = *reinterpret_cast<const Float3*>(positions + uint64(indices[triangleIDs[i] * 3 + j]) * positionStride);
+    });
+
+    vertices = objectVertices;
+}
+
+void BVH::Refit(const Float4x4& transform)
+{
+    const XMMATRIX m = transform.ToSIMD();
+    ParallelFor(objectVertices.size(), VertexBatchSize, [&](uint64 start, uint64 end)
+    {
+        for(uint64 i = start; i < end; ++i)
+            vertices[i] = XMVector3Transform(objectVertices[i].ToSIMD(), m);
+    });
+
+    // Children always come after their parent, so walking backwards updates them first
+    for(uint64 nodeIdx = nodes.size(); nodeIdx-- > 0;)
+    {
+        BVHNode& node = nodes[nodeIdx];
+        XMVECTOR boundsMin = XMVectorReplicate(FLT_MAX);
+        XMVECTOR boundsMax = XMVectorReplicate(-FLT_MAX);
+        if(node.IsLeaf())
+        {
+            for(uint64 i = node.Offset * 3ull; i < (node.Offset + node.Count) * 3ull; ++i)
+            {
+                boundsMin = XMVectorMin(boundsMin, vertices[i].ToSIMD());
+                boundsMax = XMVectorMax(boundsMax, vertices[i].ToSIMD());
+            }
+        }
+        else
+        {
+            const BVHNode& first = nodes[nodeIdx + 1];
+            const BVHNode& second = nodes[node.Offset];
+            boundsMin = XMVectorMin(first.Min.ToSIMD(), second.Min.ToSIMD());
+            boundsMax = XMVectorMax(first.Max.ToSIMD(), second.Max.ToSIMD());
+        }
+
+        node.Min = boundsMin;
+        node.Max = boundsMax;
+    }
+}
+
+// Slab test that returns the distance where the ray enters the box, or FLT_MAX if it misses
+static float RayBoxEntry(FXMVECTOR origin, FXMVECTOR invDir, const BVHNode& node, float maxT)
+{
+    const XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(node.Min.ToSIMD(), origin), invDir);
+    const XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(node.Max.ToSIMD(), origin), invDir);
+    const XMVECTOR tNear = XMVectorMin(t0, t1);
+    const XMVECTOR tFar = XMVectorMax(t0, t1);
+
+    const float entry = std::max(std::max(XMVectorGetX(tNear), XMVectorGetY(tNear)), std::max(XMVectorGetZ(tNear), 0.0f));
+    const float exit = std::min(std::min(XMVectorGetX(tFar), XMVectorGetY(tFar)), std::min(XMVectorGetZ(tFar), maxT));
+    return entry <= exit ? entry : FLT_MAX;
+}
+
+// Moller-Trumbore ray/triangle test, which accepts hits from both sides
+static bool RayTriangle(FXMVECTOR origin, FXMVECTOR direction, const Float3* triangle, float maxT,
+                        float& t, float& u, float& v)
+{
+    const XMVECTOR v0 = triangle[0].ToSIMD();
+    const XMVECTOR e1 = XMVectorSubtract(triangle[1].ToSIMD(), v0);
+    const XMVECTOR e2 = XMVectorSubtract(triangle[2].ToSIMD(), v0);
+    const XMVECTOR p = XMVector3Cross(direction, e2);
+    const float det = XMVectorGetX(XMVector3Dot(e1, p));
+    if(std::abs(det) < 1e-20f)
+        return false;
+
+    const float invDet = 1.0f / det;
+    const XMVECTOR s = XMVectorSubtract(origin, v0);
+    u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+    if(u < 0.0f || u > 1.0f)
+        return false;
+
+    const XMVECTOR q = XMVector3Cross(s, e1);
+    v = XMVectorGetX(XMVector3Dot(direction, q)) * invDet;
+    if(v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+    return t >= 0.0f && t <= maxT;
+}
+
+// Replaces zero direction components with a tiny value, so that the reciprocal is finite
+static XMVECTOR RayInverseDirection(const Float3& direction)
+{
+    const XMVECTOR dir = direction.ToSIMD();
+    const XMVECTOR tiny = XMVectorReplicate(1e-20f);
+    const XMVECTOR sign = XMVectorSelect(XMVectorReplicate(-1.0f), XMVectorReplicate(1.0f),
+                                         XMVectorGreaterOrEqual(dir, XMVectorZero()));
+    const XMVECTOR safeDir = XMVectorSelect(XMVectorMultiply(tiny, sign), dir,
+                                            XMVectorGreater(XMVectorAbs(dir), tiny));
+    return XMVectorReciprocal(safeDir);
+}
+
+// Shared traversal for closest-hit and any-hit queries. Children are visited front to back so
+// that closest-hit queries can skip nodes behind the current hit.
+static bool TraverseRay(const std::vector<BVHNode>& nodes, const std::vector<Float3>& vertices,
+                        const std::vector<uint32>& triangleIDs, const Float3& origin,
+                        const Float3& direction, float maxT, bool anyHit, BVHHit& hit)
+{
+    if(nodes.size() == 0)
+        return false;
+
+    const XMVECTOR o = origin.ToSIMD();
+    const XMVECTOR d = direction.ToSIMD();
+    const XMVECTOR invDir = RayInverseDirection(direction);
+
+    if(RayBoxEntry(o, invDir, nodes[0], maxT) == FLT_MAX)
+        return false;
+
+    uint32 stack[TraversalStackSize];
+    uint32 stackSize = 0;
+    uint32 nodeIdx = 0;
+    float closestT = maxT;
+    bool found = false;
+
+    while(true)
+    {
+        const BVHNode& node = nodes[nodeIdx];
+        if(node.IsLeaf())
+        {
+            for(uint32 i = node.Offset; i < node.Offset + node.Count; ++i)
+            {
+                float t, u, v;
+                if(RayTriangle(o, d, &vertices[i * 3ull], closestT, t, u, v))
+                {
+                    closestT = t;
+                    hit.T = t;
+                    hit.U = u;
+                    hit.V = v;
+                    hit.TriangleID = triangleIDs[i];
+                    found = true;
+
+                    if(anyHit)
+                        return true;
+                }
+            }
+        }
+        else
+        {
+            uint32 nearIdx = nodeIdx + 1;
+            uint32 farIdx = node.Offset;
+            float nearT = RayBoxEntry(o, invDir, nodes[nearIdx], closestT);
+            float farT = RayBoxEntry(o, invDir, nodes[farIdx], closestT);
+            if(farT < nearT)
+            {
+                std::swap(nearIdx, farIdx);
+                std::swap(nearT, farT);
+            }
+
+            if(nearT != FLT_MAX)
+            {
+                if(farT != FLT_MAX)
+                {
+                    Assert_(stackSize < TraversalStackSize);
+                    stack[stackSize++] = farIdx;
+                }
+
+                nodeIdx = nearIdx;
+                continue;
+            }
+        }
+
+        if(stackSize == 0)
+            break;
+        nodeIdx = stack[--stackSize];
+    }
+
+    return found;
+}
+
+bool BVH::IntersectRay(const Float3& origin, const Float3& direction, float maxT, BVHHit& hit) const
+{
+    return TraverseRay(nodes, vertices, triangleIDs, origin, direction, maxT, false, hit);
+}
+
+bool BVH::RayOccluded(const Float3& origin, const Float3& direction, float maxT) const
+{
+    BVHHit hit;
+    return TraverseRay(nodes, vertices, triangleIDs, origin, direction, maxT, true, hit);
+}
+
+}
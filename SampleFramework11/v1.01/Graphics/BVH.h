@@ -0,0 +1,91 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+#include "..\\SF11_Math.h"
+#include "..\\Serialization.h"
+
+namespace SampleFramework11
+{
+
+// A node in a flattened BVH, stored in depth-first order so that the first child of an interior
+// node always directly follows it. Two nodes fit in a cache line.
+struct BVHNode
+{
+    Float3 Min;
+    uint32 Offset = 0;      // First triangle for leaves, index of the second child for interior nodes
+    Float3 Max;
+    uint32 Count = 0;       // Number of triangles for leaves, 0 for interior nodes
+
+    bool IsLeaf() const { return Count > 0; }
+};
+
+struct BVHHit
+{
+    float T = FLT_MAX;
+    float U = 0.0f;
+    float V = 0.0f;
+    uint32 TriangleID = 0xFFFFFFFF;
+};
+
+// Bounding volume hierarchy over a triangle list, built with a binned surface area heuristic.
+// Triangle IDs are the index of the triangle in the index buffer that it was built from. The
+// triangle vertices are copied into leaf order so that leaves can be tested without touching the
+// source vertex and index data.
+class BVH
+{
+
+public:
+
+    static const uint32 NumBins = 16;
+    static const uint32 MaxLeafTriangles = 8;
+
+    // Builds the hierarchy in the space of the positions, with large subtrees built in parallel
+    void Build(const uint8* positions, uint32 positionStride, const uint32* indices, uint64 numTriangles);
+
+    // Transforms the triangles from the space they were built in, and updates the node bounds
+    // without changing the topology of the tree
+    void Refit(const Float4x4& transform);
+
+    // Returns the closest hit along the ray within [0, maxT]
+    bool IntersectRay(const Float3& origin, const Float3& direction, float maxT, BVHHit& hit) const;
+
+    // Returns true if the ray hits any triangle within [0, maxT], which can stop at the first hit
+    bool RayOccluded(const Float3& origin, const Float3& direction, float maxT) const;
+
+    bool Empty() const { return nodes.size() == 0; }
+    uint64 NumTriangles() const { return triangleIDs.size(); }
+    const std::vector<BVHNode>& Nodes() const { return nodes; }
+    const std::vector<uint32>& TriangleIDs() const { return triangleIDs; }
+
+    // The 3 vertices of each triangle in leaf order, transformed by the last refit
+    const std::vector<Float3>& Vertices() const { return vertices; }
+
+    template<typename TSerializer> void Serialize(TSerializer& serializer)
+    {
+        SerializeRawVector(serializer, nodes);
+        SerializeRawVector(serializer, triangleIDs);
+        SerializeRawVector(serializer, objectVertices);
+
+        if(TSerializer::IsReadSerializer())
+            vertices = objectVertices;
+    }
+
+protected:
+
+    std::vector<BVHNode> nodes;
+    std::vector<uint32> triangleIDs;
+    std::vector<Float3> objectVertices;
+    std::vector<Float3> vertices;
+};
+
+}
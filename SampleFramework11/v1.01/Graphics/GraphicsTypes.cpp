@@ -634,6 +634,19 @@ void* StagingTexture2D::Map(ID3D11DeviceContext* context, uint32 subResourceInde
     return mapped.pData;
 }
 
+// Maps without waiting on the GPU, and returns nullptr if the GPU hasn't finished with the texture
+void* StagingTexture2D::TryMap(ID3D11DeviceContext* context, uint32 subResourceIndex, uint32& pitch)
+{
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = context->Map(Texture, subResourceIndex, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if(hr == DXGI_ERROR_WAS_STILL_DRAWING)
+        return nullptr;
+
+    DXCall(hr);
+    pitch = mapped.RowPitch;
+    return mapped.pData;
+}
+
 void StagingTexture2D::Unmap(ID3D11DeviceContext* context, uint32 subResourceIndex)
 {
     context->Unmap(Texture, subResourceIndex);
@@ -133,6 +133,7 @@ struct StagingTexture2D
                         uint32 arraySize = 1);
 
     void* Map(ID3D11DeviceContext* context, uint32 subResourceIndex, uint32& pitch);
+    void* TryMap(ID3D11DeviceContext* context, uint32 subResourceIndex, uint32& pitch);
     void Unmap(ID3D11DeviceContext* context, uint32 subResourceIndex);
 };
 
@@ -0,0 +1,394 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "MeshOptimization.h"
+
+#include "..\\SF11_Math.h"
+
+using std::vector;
+
+namespace SampleFramework11
+{
+
+// == Cache analysis ==============================================================================
+
+VertexCacheStats AnalyzeVertexCache(const uint32* indices, uint64 numIndices, uint64 numVertices,
+                                    uint32 cacheSize)
+{
+    VertexCacheStats stats;
+    if(numIndices < 3)
+        return stats;
+
+    // A vertex is in the FIFO if fewer than cacheSize misses happened since it was last added
+    vector<uint32> timestamps(numVertices, 0);
+    uint32 time = cacheSize + 1;
+    uint64 numMisses = 0;
+    uint64 numUnique = 0;
+
+    for(uint64 i = 0; i < numIndices; ++i)
+    {
+        const uint32 idx = indices[i];
+        Assert_(idx < numVertices);
+
+        if(timestamps[idx] == 0)
+            ++numUnique;
+
+        if(time - timestamps[idx] > cacheSize)
+        {
+            timestamps[idx] = time++;
+            ++numMisses;
+        }
+    }
+
+    stats.ACMR = float(numMisses) / float(numIndices / 3);
+    stats.ATVR = float(numMisses) / float(numUnique);
+    return stats;
+}
+
+// == Vertex cache optimization ===================================================================
+
+static const uint32 ForsythCacheSize = 32;
+static const uint32 ForsythMaxValence = 64;
+static const float CacheDecayPower = 1.5f;
+static const float LastTriScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+static const uint32 InvalidIndex = 0xFFFFFFFF;
+
+struct ForsythScoreTables
+{
+    float CacheScores[ForsythCacheSize];
+    float ValenceScores[ForsythMaxValence];
+
+    ForsythScoreTables()
+    {
+        // The vertices from the last triangle get a fixed score, so that the algorithm doesn't
+        // prefer triangles that share an edge with the previous one over ones that share a vertex
+        for(uint32 i = 0; i < ForsythCacheSize; ++i)
+        {
+            if(i < 3)
+                CacheScores[i] = LastTriScore;
+            else
+            {
+                const float scale = 1.0f / (ForsythCacheSize - 3);
+                CacheScores[i] = std::pow(1.0f - (i - 3) * scale, CacheDecayPower);
+            }
+        }
+
+        // Boost vertices with few remaining triangles, so that lone triangles don't get left behind
+        ValenceScores[0] = 0.0f;
+        for(uint32 i = 1; i < ForsythMaxValence; ++i)
+            ValenceScores[i] = ValenceBoostScale * std::pow(float(i), -ValenceBoostPower);
+    }
+};
+
+static float ForsythVertexScore(const ForsythScoreTables& tables, uint32 cachePos, uint32 numTris)
+{
+    if(numTris == 0)
+        return -1.0f;
+
+    float score = cachePos < ForsythCacheSize ? tables.CacheScores[cachePos] : 0.0f;
+    score += tables.ValenceScores[std::min(numTris, ForsythMaxValence - 1)];
+    return score;
+}
+
+void OptimizeVertexCache(uint32* indices, uint64 numIndices, uint64 numVertices)
+{
+    const uint64 numTris = numIndices / 3;
+    if(numTris < 2)
+        return;
+
+    static const ForsythScoreTables tables;
+
+    // Build the vertex -> triangle adjacency. Each vertex's list is kept compacted so that the
+    // first numActiveTris entries are the triangles that haven't been emitted yet.
+    vector<uint32> numActiveTris(numVertices, 0);
+    for(uint64 i = 0; i < numIndices; ++i)
+        ++numActiveTris[indices[i]];
+
+    vector<uint32> triListOffsets(numVertices, 0);
+    uint64 offset = 0;
+    for(uint64 v = 0; v < numVertices; ++v)
+    {
+        triListOffsets[v] = uint32(offset);
+        offset += numActiveTris[v];
+    }
+
+    vector<uint32> triLists(numIndices);
+    vector<uint32> fillCounts(numVertices, 0);
+    for(uint64 i = 0; i < numIndices; ++i)
+    {
+        const uint32 v = indices[i];
+        triLists[triListOffsets[v] + fillCounts[v]++] = uint32(i / 3);
+    }
+
+    vector<uint32> cachePositions(numVertices, InvalidIndex);
+    vector<float> vertexScores(numVertices, 0.0f);
+    for(uint64 v = 0; v < numVertices; ++v)
+        vertexScores[v] = ForsythVertexScore(tables, InvalidIndex, numActiveTris[v]);
+
+    vector<float> triScores(numTris, 0.0f);
+    for(uint64 t = 0; t < numTris; ++t)
+        for(uint64 i = 0; i < 3; ++i)
+            triScores[t] += vertexScores[indices[t * 3 + i]];
+
+    vector<uint8> triEmitted(numTris, 0);
+    vector<uint32> output(numIndices);
+
+    uint32 cache[ForsythCacheSize + 3];
+    uint32 newCache[ForsythCacheSize + 3];
+    uint32 cacheCount = 0;
+
+    uint64 deadEndCursor = 0;
+    uint32 bestTri = 0;
+    for(uint64 t = 1; t < numTris; ++t)
+        if(triScores[t] > triScores[bestTri])
+            bestTri = uint32(t);
+
+    for(uint64 outTri = 0; outTri < numTris; ++outTri)
+    {
+        // None of the cached vertices have any triangles left, so pick up from the first
+        // triangle that hasn't been emitted yet
+        if(bestTri == InvalidIndex)
+        {
+            while(triEmitted[deadEndCursor])
+                ++deadEndCursor;
+            bestTri = uint32(deadEndCursor);
+        }
+
+        triEmitted[bestTri] = 1;
+        const uint32* tri = &indices[bestTri * 3];
+        output[outTri * 3 + 0] = tri[0];
+        output[outTri * 3 + 1] = tri[1];
+        output[outTri * 3 + 2] = tri[2];
+
+        // Remove the triangle from its vertices' adjacency lists
+        for(uint64 i = 0; i < 3; ++i)
+        {
+            const uint32 v = tri[i];
+            uint32* triList = &triLists[triListOffsets[v]];
+            const uint32 count = numActiveTris[v];
+            for(uint32 j = 0; j < count; ++j)
+            {
+                if(triList[j] == bestTri)
+                {
+                    triList[j] = triList[count - 1];
+                    break;
+                }
+            }
+            --numActiveTris[v];
+        }
+
+        // Move the triangle's vertices to the front of the cache
+        uint32 newCacheCount = 0;
+        for(uint64 i = 0; i < 3; ++i)
+            newCache[newCacheCount++] = tri[i];
+        for(uint32 i = 0; i < cacheCount; ++i)
+        {
+            const uint32 v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCacheCount++] = v;
+        }
+
+        // Vertices that fell out of the cache lose their cache score
+        for(uint32 i = ForsythCacheSize; i < newCacheCount; ++i)
+        {
+            const uint32 v = newCache[i];
+            cachePositions[v] = InvalidIndex;
+            vertexScores[v] = ForsythVertexScore(tables, InvalidIndex, numActiveTris[v]);
+        }
+
+        cacheCount = std::min(newCacheCount, ForsythCacheSize);
+        for(uint32 i = 0; i < cacheCount; ++i)
+        {
+            const uint32 v = newCache[i];
+            cache[i] = v;
+            cachePositions[v] = i;
+            vertexScores[v] = ForsythVertexScore(tables, i, numActiveTris[v]);
+        }
+
+        // Re-score the triangles that use a cached vertex, and pick the best one to emit next
+        bestTri = InvalidIndex;
+        float bestScore = -1.0f;
+        for(uint32 i = 0; i < cacheCount; ++i)
+        {
+            const uint32 v = cache[i];
+            const uint32* triList = &triLists[triListOffsets[v]];
+            for(uint32 j = 0; j < numActiveTris[v]; ++j)
+            {
+                const uint32 t = triList[j];
+                const uint32* triIndices = &indices[t * 3];
+                const float score = vertexScores[triIndices[0]] + vertexScores[triIndices[1]]
+                                  + vertexScores[triIndices[2]];
+                triScores[t] = score;
+                if(score > bestScore)
+                {
+                    bestScore = score;
+                    bestTri = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), numIndices * sizeof(uint32));
+}
+
+// == Overdraw optimization =======================================================================
+
+void OptimizeOverdraw(uint32* indices, uint64 numIndices, const uint8* positions, uint32 positionStride,
+                      uint64 numVertices, float threshold)
+{
+    const uint64 numTris = numIndices / 3;
+    if(numTris < 2)
+        return;
+
+    // Start a new cluster wherever all three vertices of a triangle miss the cache, since the
+    // triangles on either side of that point don't share any vertices in the cache
+    vector<uint32> clusterStarts;
+    vector<uint32> timestamps(numVertices, 0);
+    uint32 time = DefaultVertexCacheSize + 1;
+    for(uint64 t = 0; t < numTris; ++t)
+    {
+        uint32 numMisses = 0;
+        for(uint64 i = 0; i < 3; ++i)
+        {
+            const uint32 idx = indices[t * 3 + i];
+            if(time - timestamps[idx] > DefaultVertexCacheSize)
+            {
+                timestamps[idx] = time++;
+                ++numMisses;
+            }
+        }
+
+        if(t == 0 || numMisses == 3)
+            clusterStarts.push_back(uint32(t));
+    }
+
+    const uint64 numClusters = clusterStarts.size();
+    if(numClusters < 2)
+        return;
+
+    clusterStarts.push_back(uint32(numTris));
+
+    // Compute the area-weighted centroid and normal for each cluster, and for the whole mesh
+    vector<Float3> clusterCentroids(numClusters);
+    vector<Float3> clusterNormals(numClusters);
+    Float3 meshCentroid;
+    float meshArea = 0.0f;
+    for(uint64 c = 0; c < numClusters; ++c)
+    {
+        Float3 centroid;
+        Float3 normal;
+        float area = 0.0f;
+        for(uint64 t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+        {
+            const Float3& p0 = *reinterpret_cast<const Float3*>(positions + indices[t * 3 + 0] * uint64(positionStride));
+            const Float3& p1 = *reinterpret_cast<const Float3*>(positions + indices[t * 3 + 1] * uint64(positionStride));
+            const Float3& p2 = *reinterpret_cast<const Float3*>(positions + indices[t * 3 + 2] * uint64(positionStride));
+
+            const Float3 triNormal = Float3::Cross(p1 - p0, p2 - p0);
+            const float triArea = triNormal.Length();
+            centroid += (p0 + p1 + p2) * (triArea / 3.0f);
+            normal += triNormal;
+            area += triArea;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+        clusterCentroids[c] = area > 0.0f ? centroid / area : centroid;
+        clusterNormals[c] = normal.Length() > 0.0f ? Float3::Normalize(normal) : normal;
+    }
+
+    if(meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters that face away from the center of the mesh are more likely to occlude the rest of
+    // the mesh, so they get drawn first
+    vector<float> sortKeys(numClusters);
+    vector<uint32> clusterOrder(numClusters);
+    for(uint64 c = 0; c < numClusters; ++c)
+    {
+        sortKeys[c] = Float3::Dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+        clusterOrder[c] = uint32(c);
+    }
+
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32 a, uint32 b)
+    {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    vector<uint32> sorted;
+    sorted.reserve(numIndices);
+    for(uint64 i = 0; i < numClusters; ++i)
+    {
+        const uint32 c = clusterOrder[i];
+        sorted.insert(sorted.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+    }
+
+    const VertexCacheStats before = AnalyzeVertexCache(indices, numIndices, numVertices);
+    const VertexCacheStats after = AnalyzeVertexCache(sorted.data(), numIndices, numVertices);
+    if(after.ACMR <= before.ACMR * threshold)
+        memcpy(indices, sorted.data(), numIndices * sizeof(uint32));
+}
+
+// == Vertex fetch optimization ===================================================================
+
+uint64 BuildVertexFetchRemap(const uint32* indices, uint64 numIndices, uint64 numVertices,
+                             std::vector<uint32>& remap)
+{
+    remap.assign(numVertices, InvalidIndex);
+
+    uint32 nextVertex = 0;
+    for(uint64 i = 0; i < numIndices; ++i)
+    {
+        const uint32 idx = indices[i];
+        if(remap[idx] == InvalidIndex)
+            remap[idx] = nextVertex++;
+    }
+
+    const uint64 numReferenced = nextVertex;
+    for(uint64 v = 0; v < numVertices; ++v)
+        if(remap[v] == InvalidIndex)
+            remap[v] = nextVertex++;
+
+    return numReferenced;
+}
+
+// == Local vertex IDs ============================================================================
+
+void RemapToLocalVertices(uint32* indices, uint64 numIndices, std::vector<uint32>& globalToLocal,
+                          std::vector<uint32>& localToGlobal)
+{
+    localToGlobal.clear();
+    for(uint64 i = 0; i < numIndices; ++i)
+    {
+        const uint32 idx = indices[i];
+        Assert_(idx < globalToLocal.size());
+        if(globalToLocal[idx] == InvalidIndex)
+        {
+            globalToLocal[idx] = uint32(localToGlobal.size());
+            localToGlobal.push_back(idx);
+        }
+
+        indices[i] = globalToLocal[idx];
+    }
+
+    for(uint64 v = 0; v < localToGlobal.size(); ++v)
+        globalToLocal[localToGlobal[v]] = InvalidIndex;
+}
+
+void RemapToGlobalVertices(uint32* indices, uint64 numIndices, const std::vector<uint32>& localToGlobal)
+{
+    for(uint64 i = 0; i < numIndices; ++i)
+        indices[i] = localToGlobal[indices[i]];
+}
+
+}
@@ -0,0 +1,67 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+#include "..\\Serialization.h"
+
+namespace SampleFramework11
+{
+
+// Index and vertex reordering for triangle lists. All functions work on 32-bit indices that
+// reference a shared vertex buffer with numVertices vertices.
+
+// Size of the FIFO post-transform cache that's simulated when computing statistics
+static const uint32 DefaultVertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+    float ACMR = 0.0f;      // Average cache miss ratio: transformed vertices per triangle
+    float ATVR = 0.0f;      // Average transform to vertex ratio: transformed vertices per unique vertex
+
+    template<typename TSerializer> void Serialize(TSerializer& serializer)
+    {
+        SerializeItem(serializer, ACMR);
+        SerializeItem(serializer, ATVR);
+    }
+};
+
+// Simulates a FIFO post-transform cache for a triangle list
+VertexCacheStats AnalyzeVertexCache(const uint32* indices, uint64 numIndices, uint64 numVertices,
+                                    uint32 cacheSize = DefaultVertexCacheSize);
+
+// Reorders triangles for the post-transform cache, using Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation" algorithm
+void OptimizeVertexCache(uint32* indices, uint64 numIndices, uint64 numVertices);
+
+// Splits a cache-optimized triangle list into clusters at the points where the cache is flushed,
+// and sorts the clusters so that the outward-facing ones are drawn first. This is the overdraw
+// pass from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" by Sander et al.
+// The new order is discarded if it raises the ACMR by more than the given threshold.
+void OptimizeOverdraw(uint32* indices, uint64 numIndices, const uint8* positions, uint32 positionStride,
+                      uint64 numVertices, float threshold = 1.05f);
+
+// Builds a remap table that orders the vertices by their first use in the index buffer, so that
+// vertex fetches are sequential. Unreferenced vertices are moved to the end. Returns the number
+// of referenced vertices.
+uint64 BuildVertexFetchRemap(const uint32* indices, uint64 numIndices, uint64 numVertices,
+                             std::vector<uint32>& remap);
+
+// Rewrites indices into a large shared vertex buffer as compact local IDs in order of first use, so
+// that the functions above only allocate for the vertices that are referenced. localToGlobal gets
+// the original ID of each local vertex. globalToLocal is scratch space with an entry for every
+// vertex in the shared buffer, which has to start out filled with 0xFFFFFFFF and is left that way
+// so that it can be re-used without clearing it.
+void RemapToLocalVertices(uint32* indices, uint64 numIndices, std::vector<uint32>& globalToLocal,
+                          std::vector<uint32>& localToGlobal);
+void RemapToGlobalVertices(uint32* indices, uint64 numIndices, const std::vector<uint32>& localToGlobal);
+
+}
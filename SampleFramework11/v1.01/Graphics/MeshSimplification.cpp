@@ -0,0 +1,396 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "MeshSimplification.h"
+
+#include "..\\SF11_Math.h"
+
+namespace SampleFramework11
+{
+
+static const uint32 InvalidOffset = 0xFFFFFFFF;
+
+// Weights for squared differences in normals and texture coordinates, which are added to the
+// squared distances of a mesh that's been scaled to fit in a unit cube
+static const float NormalWeight = 0.01f;
+static const float TexCoordWeight = 0.01f;
+
+// Collapses are rejected if they rotate a triangle by more than ~75 degrees
+static const float MinNormalDot = 0.25f;
+
+// Symmetric 3x3 matrix A, vector B, and constant C of the quadric form p'Ap + 2B'p + C, along
+// with the total area of the planes that it was built from
+struct Quadric
+{
+    float A00 = 0.0f;
+    float A11 = 0.0f;
+    float A22 = 0.0f;
+    float A01 = 0.0f;
+    float A02 = 0.0f;
+    float A12 = 0.0f;
+    float B0 = 0.0f;
+    float B1 = 0.0f;
+    float B2 = 0.0f;
+    float C = 0.0f;
+    float Weight = 0.0f;
+};
+
+struct SimplifyVertex
+{
+    Float3 Position;
+    Float3 Normal;
+    Float2 TexCoord;
+    uint32 Index = 0;
+};
+
+struct Collapse
+{
+    uint32 From = 0;
+    uint32 To = 0;
+    float Cost = 0.0f;
+};
+
+static Quadric PlaneQuadric(const Float3& n, float d, float weight)
+{
+    Quadric q;
+    q.A00 = n.x * n.x * weight;
+    q.A11 = n.y * n.y * weight;
+    q.A22 = n.z * n.z * weight;
+    q.A01 = n.x * n.y * weight;
+    q.A02 = n.x * n.z * weight;
+    q.A12 = n.y * n.z * weight;
+    q.B0 = n.x * d * weight;
+    q.B1 = n.y * d * weight;
+    q.B2 = n.z * d * weight;
+    q.C = d * d * weight;
+    q.Weight = weight;
+    return q;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+    q.A00 += other.A00;
+    q.A11 += other.A11;
+    q.A22 += other.A22;
+    q.A01 += other.A01;
+    q.A02 += other.A02;
+    q.A12 += other.A12;
+    q.B0 += other.B0;
+    q.B1 += other.B1;
+    q.B2 += other.B2;
+    q.C += other.C;
+    q.Weight += other.Weight;
+}
+
+// Returns the area-weighted mean of the squared distances from p to the quadric's planes
+static float QuadricError(const Quadric& q, const Float3& p)
+{
+    const float ax = q.A00 * p.x + q.A01 * p.y + q.A02 * p.z;
+    const float ay = q.A01 * p.x + q.A11 * p.y + q.A12 * p.z;
+    const float az = q.A02 * p.x + q.A12 * p.y + q.A22 * p.z;
+    const float error = p.x * ax + p.y * ay + p.z * az + 2.0f * (q.B0 * p.x + q.B1 * p.y + q.B2 * p.z) + q.C;
+    return std::abs(error) / std::max(q.Weight, 1e-20f);
+}
+
+static float CollapseCost(const std::vector<SimplifyVertex>& verts, const std::vector<Quadric>& quadrics,
+                          uint32 from, uint32 to)
+{
+    Quadric q = quadrics[from];
+    AddQuadric(q, quadrics[to]);
+
+    const Float3 normalDiff = verts[from].Normal - verts[to].Normal;
+    const Float2 uvDiff = verts[from].TexCoord - verts[to].TexCoord;
+    return QuadricError(q, verts[to].Position) + NormalWeight * Float3::Dot(normalDiff, normalDiff)
+           + TexCoordWeight * (uvDiff.x * uvDiff.x + uvDiff.y * uvDiff.y);
+}
+
+// Returns true if moving the vertex onto the target would flip or badly distort any of the
+// triangles around it that aren't removed by the collapse
+static bool CollapseFlips(const std::vector<SimplifyVertex>& verts, const std::vector<uint32>& indices,
+                          const std::vector<uint32>& triStart, const std::vector<uint32>& triList,
+                          uint32 from, uint32 to)
+{
+    for(uint32 i = triStart[from]; i < triStart[from + 1]; ++i)
+    {
+        const uint32* triangle = &indices[triList[i] * 3];
+        if(triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            continue;
+
+        Float3 p[3];
+        for(uint32 j = 0; j < 3; ++j)
+            p[j] = verts[triangle[j]].Position;
+        const Float3 oldNormal = Float3::Cross(p[1] - p[0], p[2] - p[0]);
+
+        for(uint32 j = 0; j < 3; ++j)
+            if(triangle[j] == from)
+                p[j] = verts[to].Position;
+        const Float3 newNormal = Float3::Cross(p[1] - p[0], p[2] - p[0]);
+
+        const float oldLength = oldNormal.Length();
+        if(oldLength <= 1e-20f)
+            continue;
+
+        if(Float3::Dot(oldNormal, newNormal) <= MinNormalDot * oldLength * newNormal.Length())
+            return true;
+    }
+
+    return false;
+}
+
+float SimplifyMesh(const uint32* indices, uint64 numIndices, const uint8* vertices, uint32 vertexStride,
+                   uint32 positionOffset, uint32 normalOffset, uint32 texCoordOffset,
+                   uint64 targetIndexCount, float maxError, std::vector<uint32>& output)
+{
+    output.assign(indices, indices + numIndices);
+    if(numIndices <= targetIndexCount)
+        return 0.0f;
+
+    // Gather the referenced vertices, so that the working set only covers this mesh
+    std::unordered_map<uint32, uint32> localMap;
+    std::vector<SimplifyVertex> verts;
+    std::vector<uint32> currIndices(numIndices);
+    for(uint64 i = 0; i < numIndices; ++i)
+    {
+        auto result = localMap.insert(std::make_pair(indices[i], uint32(verts.size())));
+        if(result.second)
+        {
+            const uint8* vtx = vertices + uint64(indices[i]) * vertexStride;
+            SimplifyVertex vert;
+            vert.Position = *reinterpret_cast<const Float3*>(vtx + positionOffset);
+            if(normalOffset != InvalidOffset)
+                vert.Normal = *reinterpret_cast<const Float3*>(vtx + normalOffset);
+            if(texCoordOffset != InvalidOffset)
+                vert.TexCoord = *reinterpret_cast<const Float2*>(vtx + texCoordOffset);
+            vert.Index = indices[i];
+            verts.push_back(vert);
+        }
+
+        currIndices[i] = result.first->second;
+    }
+
+    const uint32 numVerts = uint32(verts.size());
+
+    // Scale the positions to fit in a unit cube, so that the errors are relative to the mesh size
+    Float3 minPos = FLT_MAX;
+    Float3 maxPos = -FLT_MAX;
+    for(uint32 i = 0; i < numVerts; ++i)
+    {
+        minPos = Float3(std::min(minPos.x, verts[i].Position.x), std::min(minPos.y, verts[i].Position.y),
+                        std::min(minPos.z, verts[i].Position.z));
+        maxPos = Float3(std::max(maxPos.x, verts[i].Position.x), std::max(maxPos.y, verts[i].Position.y),
+                        std::max(maxPos.z, verts[i].Position.z));
+    }
+
+    const float extent = std::max(std::max(maxPos.x - minPos.x, maxPos.y - minPos.y), maxPos.z - minPos.z);
+    if(extent <= 0.0f)
+        return 0.0f;
+
+    // Vertices that share a position with another vertex are on an attribute seam, and vertices
+    // with an edge that doesn't have exactly one opposite edge are on a border. These are locked.
+    std::vector<bool> locked(numVerts, false);
+
+    std::vector<uint32> sortedVerts(numVerts);
+    for(uint32 i = 0; i < numVerts; ++i)
+        sortedVerts[i] = i;
+    std::sort(sortedVerts.begin(), sortedVerts.end(), [&](uint32 a, uint32 b)
+    {
+        const Float3& pa = verts[a].Position;
+        const Float3& pb = verts[b].Position;
+        if(pa.x != pb.x)
+            return pa.x < pb.x;
+        if(pa.y != pb.y)
+            return pa.y < pb.y;
+        return pa.z < pb.z;
+    });
+
+    for(uint32 i = 1; i < numVerts; ++i)
+    {
+        if(verts[sortedVerts[i]].Position == verts[sortedVerts[i - 1]].Position)
+        {
+            locked[sortedVerts[i]] = true;
+            locked[sortedVerts[i - 1]] = true;
+        }
+    }
+
+    std::vector<uint64> halfEdges;
+    halfEdges.reserve(numIndices);
+    for(uint64 i = 0; i < numIndices; i += 3)
+        for(uint64 j = 0; j < 3; ++j)
+            halfEdges.push_back((uint64(currIndices[i + j]) << 32) | currIndices[i + (j + 1) % 3]);
+    std::sort(halfEdges.begin(), halfEdges.end());
+
+    for(uint64 i = 0; i < halfEdges.size(); ++i)
+    {
+        const uint32 a = uint32(halfEdges[i] >> 32);
+        const uint32 b = uint32(halfEdges[i] & 0xFFFFFFFF);
+        const uint64 opposite = (uint64(b) << 32) | a;
+        const auto range = std::equal_range(halfEdges.begin(), halfEdges.end(), opposite);
+        const bool duplicated = (i > 0 && halfEdges[i - 1] == halfEdges[i])
+                                || (i + 1 < halfEdges.size() && halfEdges[i + 1] == halfEdges[i]);
+        if(range.second - range.first != 1 || duplicated)
+        {
+            locked[a] = true;
+            locked[b] = true;
+        }
+    }
+
+    for(uint32 i = 0; i < numVerts; ++i)
+    {
+        verts[i].Position = (verts[i].Position - minPos) / extent;
+        if(Float3::Dot(verts[i].Normal, verts[i].Normal) > 0.0f)
+            verts[i].Normal = Float3::Normalize(verts[i].Normal);
+    }
+
+    // Each vertex starts with the planes of the triangles around it, weighted by area
+    std::vector<Quadric> quadrics(numVerts);
+    for(uint64 i = 0; i < numIndices; i += 3)
+    {
+        const Float3& p0 = verts[currIndices[i + 0]].Position;
+        const Float3& p1 = verts[currIndices[i + 1]].Position;
+        const Float3& p2 = verts[currIndices[i + 2]].Position;
+        const Float3 normal = Float3::Cross(p1 - p0, p2 - p0);
+        const float length = normal.Length();
+        if(length <= 1e-20f)
+            continue;
+
+        const Float3 n = normal / length;
+        const Quadric q = PlaneQuadric(n, -Float3::Dot(n, p0), length * 0.5f);
+        for(uint64 j = 0; j < 3; ++j)
+            AddQuadric(quadrics[currIndices[i + j]], q);
+    }
+
+    // Collapses are done in passes, where each pass sorts the candidate collapses by cost and
+    // performs the cheapest ones that don't touch a triangle modified earlier in the pass
+    const float maxCost = maxError * maxError;
+    float largestCost = 0.0f;
+
+    std::vector<uint32> triStart(numVerts + 1);
+    std::vector<uint32> triList;
+    std::vector<uint32> collapseTarget(numVerts);
+    std::vector<bool> touched(numVerts);
+    std::vector<Collapse> collapses;
+
+    while(currIndices.size() > targetIndexCount)
+    {
+        const uint32 numTriangles = uint32(currIndices.size() / 3);
+
+        std::fill(triStart.begin(), triStart.end(), 0);
+        for(uint64 i = 0; i < currIndices.size(); ++i)
+            ++triStart[currIndices[i] + 1];
+        for(uint32 i = 0; i < numVerts; ++i)
+            triStart[i + 1] += triStart[i];
+
+        triList.resize(currIndices.size());
+        std::vector<uint32> triOffsets(triStart.begin(), triStart.end() - 1);
+        for(uint32 triIdx = 0; triIdx < numTriangles; ++triIdx)
+            for(uint32 j = 0; j < 3; ++j)
+                triList[triOffsets[currIndices[triIdx * 3 + j]]++] = triIdx;
+
+        collapses.clear();
+        for(uint32 triIdx = 0; triIdx < numTriangles; ++triIdx)
+        {
+            for(uint32 j = 0; j < 3; ++j)
+            {
+                const uint32 a = currIndices[triIdx * 3 + j];
+                const uint32 b = currIndices[triIdx * 3 + (j + 1) % 3];
+                if(locked[a] == false)
+                {
+                    Collapse collapse = { a, b, CollapseCost(verts, quadrics, a, b) };
+                    collapses.push_back(collapse);
+                }
+                if(locked[b] == false)
+                {
+                    Collapse collapse = { b, a, CollapseCost(verts, quadrics, b, a) };
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+        {
+            return a.Cost < b.Cost;
+        });
+
+        for(uint32 i = 0; i < numVerts; ++i)
+        {
+            collapseTarget[i] = i;
+            touched[i] = false;
+        }
+
+        uint64 remainingTriangles = numTriangles;
+        uint64 numCollapses = 0;
+        bool errorLimitReached = false;
+        for(uint64 i = 0; i < collapses.size(); ++i)
+        {
+            const Collapse& collapse = collapses[i];
+            if(collapse.Cost > maxCost)
+            {
+                errorLimitReached = true;
+                break;
+            }
+
+            if(remainingTriangles * 3 <= targetIndexCount)
+                break;
+
+            if(touched[collapse.From] || touched[collapse.To] || collapse.From == collapse.To)
+                continue;
+
+            if(CollapseFlips(verts, currIndices, triStart, triList, collapse.From, collapse.To))
+                continue;
+
+            for(uint32 j = triStart[collapse.From]; j < triStart[collapse.From + 1]; ++j)
+            {
+                const uint32* triangle = &currIndices[triList[j] * 3];
+                if(triangle[0] == collapse.To || triangle[1] == collapse.To || triangle[2] == collapse.To)
+                    --remainingTriangles;
+
+                touched[triangle[0]] = true;
+                touched[triangle[1]] = true;
+                touched[triangle[2]] = true;
+            }
+
+            collapseTarget[collapse.From] = collapse.To;
+            AddQuadric(quadrics[collapse.To], quadrics[collapse.From]);
+            largestCost = std::max(largestCost, collapse.Cost);
+            ++numCollapses;
+        }
+
+        if(numCollapses == 0)
+            break;
+
+        // Apply the collapses, and remove the triangles that became degenerate
+        uint64 numOutputIndices = 0;
+        for(uint64 i = 0; i < currIndices.size(); i += 3)
+        {
+            const uint32 a = collapseTarget[currIndices[i + 0]];
+            const uint32 b = collapseTarget[currIndices[i + 1]];
+            const uint32 c = collapseTarget[currIndices[i + 2]];
+            if(a == b || b == c || a == c)
+                continue;
+
+            currIndices[numOutputIndices++] = a;
+            currIndices[numOutputIndices++] = b;
+            currIndices[numOutputIndices++] = c;
+        }
+        currIndices.resize(numOutputIndices);
+
+        if(errorLimitReached)
+            break;
+    }
+
+    output.resize(currIndices.size());
+    for(uint64 i = 0; i < currIndices.size(); ++i)
+        output[i] = verts[currIndices[i]].Index;
+
+    return std::sqrt(largestCost) * extent;
+}
+
+}
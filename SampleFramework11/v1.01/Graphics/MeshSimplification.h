@@ -0,0 +1,34 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+namespace SampleFramework11
+{
+
+// Simplifies a triangle list by collapsing vertices onto their neighbors in order of increasing
+// quadric error, following "Surface Simplification Using Quadric Error Metrics" by Garland and
+// Heckbert. Vertices are never moved or created, so the output indices reference the same
+// vertex buffer as the input.
+//
+// Vertices on open borders and on attribute seams (where several vertices share a position) are
+// locked, so that borders and UV seams are preserved. Differences in normals and texture
+// coordinates are added to the cost of a collapse. The normal and texture coordinate offsets can
+// be 0xFFFFFFFF if the vertices don't have them.
+//
+// Simplification stops once the index count is at or below targetIndexCount, or once the next
+// collapse would exceed maxError relative to the size of the mesh. Returns the object-space error
+// of the simplified mesh.
+float SimplifyMesh(const uint32* indices, uint64 numIndices, const uint8* vertices, uint32 vertexStride,
+                   uint32 positionOffset, uint32 normalOffset, uint32 texCoordOffset,
+                   uint64 targetIndexCount, float maxError, std::vector<uint32>& output);
+
+}
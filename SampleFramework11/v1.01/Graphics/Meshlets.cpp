@@ -0,0 +1,276 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "Meshlets.h"
+
+namespace SampleFramework11
+{
+
+// Below this the normals are spread over more than ~84 degrees, and the cone would almost never
+// cull anything
+static const float MinConeDot = 0.1f;
+
+static const Float3& GetPosition(const uint8* positions, uint32 positionStride, uint32 idx)
+{
+    return *reinterpret_cast<const Float3*>(positions + idx * positionStride);
+}
+
+// Computes the bounding sphere and normal cone for a meshlet, following the approach used by
+// meshoptimizer's meshopt_computeClusterBounds
+static void ComputeMeshletBounds(Meshlet& meshlet, const uint32* indices, const uint8* positions,
+                                 uint32 positionStride, const std::vector<uint32>& meshletVertices)
+{
+    XMVECTOR mins = XMVectorReplicate(FLT_MAX);
+    XMVECTOR maxes = XMVectorReplicate(-FLT_MAX);
+    for(uint64 i = 0; i < meshletVertices.size(); ++i)
+    {
+        const Float3& position = GetPosition(positions, positionStride, meshletVertices[i]);
+        mins = XMVectorMin(mins, position.ToSIMD());
+        maxes = XMVectorMax(maxes, position.ToSIMD());
+    }
+
+    meshlet.Center = XMVectorScale(XMVectorAdd(mins, maxes), 0.5f);
+    meshlet.Radius = 0.0f;
+    for(uint64 i = 0; i < meshletVertices.size(); ++i)
+    {
+        const Float3& position = GetPosition(positions, positionStride, meshletVertices[i]);
+        meshlet.Radius = std::max(meshlet.Radius, Float3::Distance(position, meshlet.Center));
+    }
+
+    // The normals follow the winding order, so they face outwards for clockwise front faces in a
+    // left-handed coordinate system. Degenerate triangles can't be back-face culled, so they're
+    // left out of the cone.
+    const uint32 numTriangles = meshlet.IndexCount / 3;
+    std::vector<Float3> normals(numTriangles);
+    std::vector<bool> validNormals(numTriangles, false);
+    Float3 normalSum;
+    for(uint32 triIdx = 0; triIdx < numTriangles; ++triIdx)
+    {
+        const uint32* triangle = indices + meshlet.IndexStart + triIdx * 3;
+        const Float3& p0 = GetPosition(positions, positionStride, triangle[0]);
+        const Float3& p1 = GetPosition(positions, positionStride, triangle[1]);
+        const Float3& p2 = GetPosition(positions, positionStride, triangle[2]);
+
+        const Float3 normal = Float3::Cross(p1 - p0, p2 - p0);
+        const float length = normal.Length();
+        if(length <= 1e-20f)
+            continue;
+
+        normals[triIdx] = normal / length;
+        validNormals[triIdx] = true;
+        normalSum += normals[triIdx];
+    }
+
+    meshlet.ConeAxis = Float3();
+    meshlet.ConeApex = meshlet.Center;
+    meshlet.ConeCutoff = 2.0f;
+
+    const float sumLength = normalSum.Length();
+    if(sumLength <= 1e-20f)
+        return;
+
+    const Float3 axis = normalSum / sumLength;
+    float minDot = 1.0f;
+    for(uint32 triIdx = 0; triIdx < numTriangles; ++triIdx)
+        if(validNormals[triIdx])
+            minDot = std::min(minDot, Float3::Dot(axis, normals[triIdx]));
+
+    if(minDot <= MinConeDot)
+        return;
+
+    // Move the apex back along the axis until it's behind the planes of all of the triangles,
+    // so that the cone test is conservative for any view position
+    float maxT = 0.0f;
+    for(uint32 triIdx = 0; triIdx < numTriangles; ++triIdx)
+    {
+        if(validNormals[triIdx] == false)
+            continue;
+
+        const uint32* triangle = indices + meshlet.IndexStart + triIdx * 3;
+        const Float3& p0 = GetPosition(positions, positionStride, triangle[0]);
+        const float dc = Float3::Dot(meshlet.Center - p0, normals[triIdx]);
+        const float dn = Float3::Dot(axis, normals[triIdx]);
+        maxT = std::max(maxT, dc / dn);
+    }
+
+    meshlet.ConeAxis = axis;
+    meshlet.ConeApex = meshlet.Center - axis * maxT;
+    meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+void BuildMeshlets(const uint32* indices, uint32 indexStart, uint32 indexCount, uint32 partIdx,
+                   const uint8* positions, uint32 positionStride, std::vector<Meshlet>& meshlets)
+{
+    std::vector<uint32> meshletVertices;
+    meshletVertices.reserve(MaxMeshletVertices);
+
+    Meshlet meshlet;
+    meshlet.IndexStart = indexStart;
+    meshlet.PartIdx = partIdx;
+
+    const uint32 numTriangles = indexCount / 3;
+    for(uint32 triIdx = 0; triIdx < numTriangles; ++triIdx)
+    {
+        const uint32* triangle = indices + indexStart + triIdx * 3;
+
+        uint32 numNewVertices = 0;
+        uint32 numSharedVertices = 0;
+        for(uint32 i = 0; i < 3; ++i)
+        {
+            if(std::find(meshletVertices.begin(), meshletVertices.end(), triangle[i]) != meshletVertices.end())
+                ++numSharedVertices;
+            else if(std::find(triangle, triangle + i, triangle[i]) == triangle + i)
+                ++numNewVertices;
+        }
+
+        const uint32 meshletTriangles = meshlet.IndexCount / 3;
+        const bool full = meshletTriangles == MaxMeshletTriangles
+                          || meshletVertices.size() + numNewVertices > MaxMeshletVertices;
+        const bool disconnected = meshletTriangles >= MinMeshletTriangles && numSharedVertices == 0;
+        if(meshletTriangles > 0 && (full || disconnected))
+        {
+            ComputeMeshletBounds(meshlet, indices, positions, positionStride, meshletVertices);
+            meshlets.push_back(meshlet);
+
+            meshlet.IndexStart += meshlet.IndexCount;
+            meshlet.IndexCount = 0;
+            meshletVertices.clear();
+        }
+
+        for(uint32 i = 0; i < 3; ++i)
+            if(std::find(meshletVertices.begin(), meshletVertices.end(), triangle[i]) == meshletVertices.end())
+                meshletVertices.push_back(triangle[i]);
+        meshlet.IndexCount += 3;
+    }
+
+    if(meshlet.IndexCount > 0)
+    {
+        ComputeMeshletBounds(meshlet, indices, positions, positionStride, meshletVertices);
+        meshlets.push_back(meshlet);
+    }
+}
+
+// Normalizes a plane so that distances are in object space units. Planes with no normal (such as
+// the far plane of an infinite projection) are dropped.
+static void AddPlane(CullVolume& volume, FXMVECTOR plane)
+{
+    const float length = XMVectorGetX(XMVector3Length(plane));
+    if(length <= 1e-20f)
+        return;
+
+    Assert_(volume.NumPlanes < CullVolume::MaxPlanes);
+    volume.Planes[volume.NumPlanes++] = Float4(XMVectorScale(plane, 1.0f / length));
+}
+
+// Extracts the planes from the columns of the matrix, which gives the planes in the space that
+// the matrix transforms from
+CullVolume FrustumCullVolume(const Float4x4& worldViewProjection, const Float3& viewPosition)
+{
+    const XMMATRIX columns = XMMatrixTranspose(worldViewProjection.ToSIMD());
+
+    CullVolume volume;
+    AddPlane(volume, XMVectorAdd(columns.r[3], columns.r[0]));
+    AddPlane(volume, XMVectorSubtract(columns.r[3], columns.r[0]));
+    AddPlane(volume, XMVectorAdd(columns.r[3], columns.r[1]));
+    AddPlane(volume, XMVectorSubtract(columns.r[3], columns.r[1]));
+    AddPlane(volume, columns.r[2]);
+    AddPlane(volume, XMVectorSubtract(columns.r[3], columns.r[2]));
+    volume.ViewPosition = viewPosition;
+    volume.ConeCulling = true;
+
+    return volume;
+}
+
+CullVolume ViewSpaceCullVolume(const Float4* viewPlanes, uint32 numPlanes, const Float4x4& worldView)
+{
+    Assert_(numPlanes <= CullVolume::MaxPlanes);
+
+    // Planes transform by the transpose of the matrix that transforms points into their space
+    const XMMATRIX transposed = XMMatrixTranspose(worldView.ToSIMD());
+
+    CullVolume volume;
+    for(uint32 i = 0; i < numPlanes; ++i)
+        AddPlane(volume, XMVector4Transform(viewPlanes[i].ToSIMD(), transposed));
+
+    return volume;
+}
+
+bool SphereVisible(const CullVolume& volume, const Float3& center, float radius)
+{
+    const XMVECTOR c = XMVectorSetW(center.ToSIMD(), 1.0f);
+    const XMVECTOR negRadius = XMVectorReplicate(-radius);
+    for(uint32 i = 0; i < volume.NumPlanes; ++i)
+        if(XMVector4Less(XMVector4Dot(volume.Planes[i].ToSIMD(), c), negRadius))
+            return false;
+
+    return true;
+}
+
+bool MeshletVisible(const CullVolume& volume, const Meshlet& meshlet)
+{
+    if(SphereVisible(volume, meshlet.Center, meshlet.Radius) == false)
+        return false;
+
+    // The meshlet is back-facing if the view direction is within the cone's angle of the axis,
+    // widened by the angle that the normals are spread over
+    if(volume.ConeCulling && meshlet.ConeCutoff <= 1.0f)
+    {
+        const XMVECTOR viewDir = XMVector3Normalize(XMVectorSubtract(meshlet.ConeApex.ToSIMD(),
+                                                                     volume.ViewPosition.ToSIMD()));
+        if(XMVectorGetX(XMVector3Dot(viewDir, meshlet.ConeAxis.ToSIMD())) >= meshlet.ConeCutoff)
+            return false;
+    }
+
+    return true;
+}
+
+void BoundsVisibleSoA(const CullVolume& volume, const float* centerX, const float* centerY,
+                      const float* centerZ, const float* extentX, const float* extentY,
+                      const float* extentZ, const float* radius, uint64 count, uint8* visible)
+{
+    Assert_(count % 4 == 0);
+
+    for(uint64 i = 0; i < count; i += 4)
+    {
+        const XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centerX + i));
+        const XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centerY + i));
+        const XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(centerZ + i));
+        const XMVECTOR ex = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentX + i));
+        const XMVECTOR ey = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentY + i));
+        const XMVECTOR ez = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(extentZ + i));
+        const XMVECTOR sphereRadius = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(radius + i));
+
+        XMVECTOR culled = XMVectorFalseInt();
+        for(uint32 planeIdx = 0; planeIdx < volume.NumPlanes; ++planeIdx)
+        {
+            const Float4& plane = volume.Planes[planeIdx];
+
+            XMVECTOR distance = XMVectorMultiplyAdd(cx, XMVectorReplicate(plane.x), XMVectorReplicate(plane.w));
+            distance = XMVectorMultiplyAdd(cy, XMVectorReplicate(plane.y), distance);
+            distance = XMVectorMultiplyAdd(cz, XMVectorReplicate(plane.z), distance);
+
+            // The AABB's extent along the plane normal
+            XMVECTOR boxRadius = XMVectorScale(ex, std::abs(plane.x));
+            boxRadius = XMVectorMultiplyAdd(ey, XMVectorReplicate(std::abs(plane.y)), boxRadius);
+            boxRadius = XMVectorMultiplyAdd(ez, XMVectorReplicate(std::abs(plane.z)), boxRadius);
+
+            const XMVECTOR minRadius = XMVectorMin(boxRadius, sphereRadius);
+            culled = XMVectorOrInt(culled, XMVectorLess(distance, XMVectorNegate(minRadius)));
+        }
+
+        uint32 culledMask[4];
+        XMStoreInt4(culledMask, culled);
+        for(uint64 j = 0; j < 4; ++j)
+            visible[i + j] = culledMask[j] == 0 ? 1 : 0;
+    }
+}
+
+}
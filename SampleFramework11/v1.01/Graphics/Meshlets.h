@@ -0,0 +1,74 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+#include "..\\SF11_Math.h"
+
+namespace SampleFramework11
+{
+
+// Limits for the clusters that a mesh part is split into. A meshlet is closed once it reaches
+// the triangle or vertex limit, or once it has the minimum number of triangles and the next
+// triangle isn't connected to it.
+static const uint32 MaxMeshletTriangles = 128;
+static const uint32 MinMeshletTriangles = 64;
+static const uint32 MaxMeshletVertices = 128;
+
+// A contiguous range of triangles from a mesh part, with a bounding sphere and a normal cone. The
+// cone is disabled when ConeCutoff is greater than 1.
+struct Meshlet
+{
+    uint32 IndexStart = 0;
+    uint32 IndexCount = 0;
+    uint32 PartIdx = 0;
+    Float3 Center;
+    float Radius = 0.0f;
+    Float3 ConeApex;
+    Float3 ConeAxis;
+    float ConeCutoff = 2.0f;
+};
+
+// Splits the triangles in [indexStart, indexStart + indexCount) into meshlets and appends them.
+// The triangles aren't reordered, so the index data should already be optimized for locality.
+void BuildMeshlets(const uint32* indices, uint32 indexStart, uint32 indexCount, uint32 partIdx,
+                   const uint8* positions, uint32 positionStride, std::vector<Meshlet>& meshlets);
+
+// A convex volume for culling meshlets, with planes in the meshlets' object space. Cone culling
+// is only valid for perspective views where back faces are culled by the rasterizer.
+struct CullVolume
+{
+    static const uint32 MaxPlanes = 6;
+
+    Float4 Planes[MaxPlanes];
+    uint32 NumPlanes = 0;
+    Float3 ViewPosition;
+    bool ConeCulling = false;
+};
+
+// Builds a culling volume from the frustum of a world * view * projection matrix, with cone
+// culling against the object-space view position
+CullVolume FrustumCullVolume(const Float4x4& worldViewProjection, const Float3& viewPosition);
+
+// Builds a culling volume from planes in view space, for volumes that don't map to a projection
+CullVolume ViewSpaceCullVolume(const Float4* viewPlanes, uint32 numPlanes, const Float4x4& worldView);
+
+bool SphereVisible(const CullVolume& volume, const Float3& center, float radius);
+bool MeshletVisible(const CullVolume& volume, const Meshlet& meshlet);
+
+// Tests AABB's that are stored in SoA order against the volume, 4 at a time. Each AABB also has
+// a bounding sphere with the same center, and it's culled if either one is outside of a plane.
+// The arrays must be padded to a multiple of 4. Writes 1 for visible and 0 for culled.
+void BoundsVisibleSoA(const CullVolume& volume, const float* centerX, const float* centerY,
+                      const float* centerZ, const float* extentX, const float* extentY,
+                      const float* extentZ, const float* radius, uint64 count, uint8* visible);
+
+}
@@ -17,7 +17,13 @@
 #include "GraphicsTypes.h"
 #include "..\\Serialization.h"
 #include "..\\FileIO.h"
+#include "..\\ChunkFile.h"
+#include "..\\TaskScheduler.h"
 #include "Textures.h"
+#include "ModelCache.h"
+#include "MeshOptimization.h"
+#include "VertexCompression.h"
+#include "MeshSimplification.h"
 
 using std::string;
 using std::wstring;
@@ -90,17 +96,15 @@ void Mesh::InitFromSDKMesh(ID3D11Device* device, SDKMesh& sdkMesh, uint32 meshId
 
     CreateInputElements(sdkMesh.VBElements(0));
 
-    vertices.resize(vertexStride * numVertices, 0);
-    memcpy(vertices.data(), sdkMesh.GetRawVerticesAt(vbIdx), vertexStride * numVertices);
+    vertices.Modify().resize(vertexStride * numVertices, 0);
+    memcpy(vertices.Modify().data(), sdkMesh.GetRawVerticesAt(vbIdx), vertexStride * numVertices);
 
-    indices.resize(indexSize * numIndices, 0);
-    memcpy(indices.data(), sdkMesh.GetRawIndicesAt(ibIdx), indexSize * numIndices);
+    indices.Modify().resize(indexSize * numIndices, 0);
+    memcpy(indices.Modify().data(), sdkMesh.GetRawIndicesAt(ibIdx), indexSize * numIndices);
 
     if(generateTangents)
         GenerateTangentFrame();
 
-    CreateVertexAndIndexBuffers(device);
-
     const uint32 numSubsets = sdkMesh.GetNumSubsets(meshIdx);
     meshParts.resize(numSubsets);
     for(uint32 i = 0; i < numSubsets; ++i)
@@ -113,6 +117,11 @@ void Mesh::InitFromSDKMesh(ID3D11Device* device, SDKMesh& sdkMesh, uint32 meshId
         part.VertexCount = static_cast<uint32>(subset.VertexCount);
         part.MaterialIdx = subset.MaterialID;
     }
+
+    Optimize();
+
+    if(device != nullptr)
+        CreateVertexAndIndexBuffers(device);
 }
 
 void Mesh::InitFromAssimpMesh(ID3D11Device* device, const aiMesh& assimpMesh)
@@ -194,10 +203,11 @@ void Mesh::InitFromAssimpMesh(ID3D11Device* device, const aiMesh& assimpMesh)
     vertexStride = currOffset;
 
     // Copy and interleave the vertex data
-    vertices.resize(vertexStride * numVertices, 0);
+    std::vector<uint8>& vertexStorage = vertices.Modify();
+    vertexStorage.resize(vertexStride * numVertices, 0);
     for(uint64 vtxIdx = 0; vtxIdx < numVertices; ++vtxIdx)
     {
-        uint8* vtxStart = &vertices[vtxIdx * vertexStride];
+        uint8* vtxStart = &vertexStorage[vtxIdx * vertexStride];
         for(uint64 elemIdx = 0; elemIdx < inputElements.size(); ++elemIdx)
         {
             uint64 offset = inputElements[elemIdx].AlignedByteOffset;
@@ -212,11 +222,12 @@ void Mesh::InitFromAssimpMesh(ID3D11Device* device, const aiMesh& assimpMesh)
     }
 
     // Copy the index data
-    indices.resize(indexSize * numIndices, 0);
+    std::vector<uint8>& indexStorage = indices.Modify();
+    indexStorage.resize(indexSize * numIndices, 0);
     const uint64 numTriangles = assimpMesh.mNumFaces;
     for(uint64 triIdx = 0; triIdx < numTriangles; ++triIdx)
     {
-        void* triStart = &indices[triIdx * 3 * indexSize];
+        void* triStart = &indexStorage[triIdx * 3 * indexSize];
         const aiFace& tri = assimpMesh.mFaces[triIdx];
         if(indexType == IndexType::Index32Bit)
             memcpy(triStart, tri.mIndices, sizeof(uint32) * 3);
@@ -228,8 +239,6 @@ void Mesh::InitFromAssimpMesh(ID3D11Device* device, const aiMesh& assimpMesh)
         }
     }
 
-    CreateVertexAndIndexBuffers(device);
-
     const uint32 numSubsets = 1;
     meshParts.resize(numSubsets);
     for(uint32 i = 0; i < numSubsets; ++i)
@@ -241,6 +250,11 @@ void Mesh::InitFromAssimpMesh(ID3D11Device* device, const aiMesh& assimpMesh)
         part.VertexCount = numVertices;
         part.MaterialIdx = assimpMesh.mMaterialIndex;
     }
+
+    Optimize();
+
+    if(device != nullptr)
+        CreateVertexAndIndexBuffers(device);
 }
 
 // Initializes the mesh as a box
@@ -356,34 +370,12 @@ void Mesh::InitBox(ID3D11Device* device, const Float3& dimensions, const Float3&
     memcpy(inputElements.data(), VertexInputs, sizeof(VertexInputs));
 
     const uint32 vbSize = vertexStride * numVertices;
-    vertices.resize(vbSize, 0);
-    memcpy(vertices.data(), boxVerts.data(), vbSize);
+    vertices.Modify().resize(vbSize, 0);
+    memcpy(vertices.Modify().data(), boxVerts.data(), vbSize);
 
     const uint32 ibSize = indexSize * numIndices;
-    indices.resize(ibSize, 0);
-    memcpy(indices.data(), boxIndices.data(), ibSize);
-
-    D3D11_BUFFER_DESC bufferDesc;
-    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    bufferDesc.ByteWidth = vbSize;
-    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bufferDesc.CPUAccessFlags = 0;
-    bufferDesc.MiscFlags = 0;
-    bufferDesc.StructureByteStride = 0;
-
-    D3D11_SUBRESOURCE_DATA initData;
-    initData.pSysMem = vertices.data();
-    initData.SysMemPitch = 0;
-    initData.SysMemSlicePitch = 0;
-    DXCall(device->CreateBuffer(&bufferDesc, &initData, &vertexBuffer));
-
-    bufferDesc.ByteWidth = ibSize;
-    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    bufferDesc.MiscFlags = 0;
-    bufferDesc.StructureByteStride = 0;
-
-    initData.pSysMem = indices.data();
-    DXCall(device->CreateBuffer(&bufferDesc, &initData, &indexBuffer));
+    indices.Modify().resize(ibSize, 0);
+    memcpy(indices.Modify().data(), boxIndices.data(), ibSize);
 
     meshParts.resize(1);
 
@@ -393,6 +385,11 @@ void Mesh::InitBox(ID3D11Device* device, const Float3& dimensions, const Float3&
     part.VertexStart = 0;
     part.VertexCount = numVertices;
     part.MaterialIdx = materialIdx;
+
+    Optimize();
+
+    if(device != nullptr)
+        CreateVertexAndIndexBuffers(device);
 }
 
 // Initializes the mesh as a plane
@@ -435,34 +432,12 @@ void Mesh::InitPlane(ID3D11Device* device, const Float2& dimensions, const Float
     memcpy(inputElements.data(), VertexInputs, sizeof(VertexInputs));
 
     const uint32 vbSize = vertexStride * numVertices;
-    vertices.resize(vbSize, 0);
-    memcpy(vertices.data(), planeVerts.data(), vbSize);
+    vertices.Modify().resize(vbSize, 0);
+    memcpy(vertices.Modify().data(), planeVerts.data(), vbSize);
 
     const uint32 ibSize = indexSize * numIndices;
-    indices.resize(ibSize, 0);
-    memcpy(indices.data(), planeIndices.data(), ibSize);
-
-    D3D11_BUFFER_DESC bufferDesc;
-    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    bufferDesc.ByteWidth = vbSize;
-    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bufferDesc.CPUAccessFlags = 0;
-    bufferDesc.MiscFlags = 0;
-    bufferDesc.StructureByteStride = 0;
-
-    D3D11_SUBRESOURCE_DATA initData;
-    initData.pSysMem = vertices.data();
-    initData.SysMemPitch = 0;
-    initData.SysMemSlicePitch = 0;
-    DXCall(device->CreateBuffer(&bufferDesc, &initData, &vertexBuffer));
-
-    bufferDesc.ByteWidth = ibSize;
-    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    bufferDesc.MiscFlags = 0;
-    bufferDesc.StructureByteStride = 0;
-
-    initData.pSysMem = indices.data();
-    DXCall(device->CreateBuffer(&bufferDesc, &initData, &indexBuffer));
+    indices.Modify().resize(ibSize, 0);
+    memcpy(indices.Modify().data(), planeIndices.data(), ibSize);
 
     meshParts.resize(1);
 
@@ -472,6 +447,11 @@ void Mesh::InitPlane(ID3D11Device* device, const Float2& dimensions, const Float
     part.VertexStart = 0;
     part.VertexCount = numVertices;
     part.MaterialIdx = materialIdx;
+
+    Optimize();
+
+    if(device != nullptr)
+        CreateVertexAndIndexBuffers(device);
 }
 
 static float CorneaZ(float r)
@@ -591,34 +571,12 @@ void Mesh::InitCornea(ID3D11Device* device, uint32 materialIdx)
     memcpy(inputElements.data(), VertexInputs, sizeof(VertexInputs));
 
     const uint32 vbSize = vertexStride * numVertices;
-    vertices.resize(vbSize, 0);
-    memcpy(vertices.data(), corneaVerts.data(), vbSize);
+    vertices.Modify().resize(vbSize, 0);
+    memcpy(vertices.Modify().data(), corneaVerts.data(), vbSize);
 
     const uint32 ibSize = indexSize * numIndices;
-    indices.resize(ibSize, 0);
-    memcpy(indices.data(), corneaIndices.data(), ibSize);
-
-    D3D11_BUFFER_DESC bufferDesc;
-    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    bufferDesc.ByteWidth = vbSize;
-    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bufferDesc.CPUAccessFlags = 0;
-    bufferDesc.MiscFlags = 0;
-    bufferDesc.StructureByteStride = 0;
-
-    D3D11_SUBRESOURCE_DATA initData;
-    initData.pSysMem = vertices.data();
-    initData.SysMemPitch = 0;
-    initData.SysMemSlicePitch = 0;
-    DXCall(device->CreateBuffer(&bufferDesc, &initData, &vertexBuffer));
-
-    bufferDesc.ByteWidth = ibSize;
-    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    bufferDesc.MiscFlags = 0;
-    bufferDesc.StructureByteStride = 0;
-
-    initData.pSysMem = indices.data();
-    DXCall(device->CreateBuffer(&bufferDesc, &initData, &indexBuffer));
+    indices.Modify().resize(ibSize, 0);
+    memcpy(indices.Modify().data(), corneaIndices.data(), ibSize);
 
     meshParts.resize(1);
 
@@ -628,9 +586,120 @@ void Mesh::InitCornea(ID3D11Device* device, uint32 materialIdx)
     part.VertexStart = 0;
     part.VertexCount = numVertices;
     part.MaterialIdx = materialIdx;
+
+    Optimize();
+
+    if(device != nullptr)
+        CreateVertexAndIndexBuffers(device);
 }
 
 
+static const uint64 TangentBatchSize = 4096;
+
+// Computes the tangent and bitangent direction for a triangle. The following code is based on
+// "Computing Tangent Space Basis Vectors for an Arbitrary Mesh", by Eric Lengyel
+// http://www.terathon.com/code/tangent.html
+static void ComputeTriangleTangents(const Vertex& vtx1, const Vertex& vtx2, const Vertex& vtx3,
+                                    Float3& sDir, Float3& tDir)
+{
+    const Float3& v1 = vtx1.Position;
+    const Float3& v2 = vtx2.Position;
+    const Float3& v3 = vtx3.Position;
+
+    const Float2& w1 = vtx1.TexCoord;
+    const Float2& w2 = vtx2.TexCoord;
+    const Float2& w3 = vtx3.TexCoord;
+
+    float x1 = v2.x - v1.x;
+    float x2 = v3.x - v1.x;
+    float y1 = v2.y - v1.y;
+    float y2 = v3.y - v1.y;
+    float z1 = v2.z - v1.z;
+    float z2 = v3.z - v1.z;
+
+    float s1 = w2.x - w1.x;
+    float s2 = w3.x - w1.x;
+    float t1 = w2.y - w1.y;
+    float t2 = w3.y - w1.y;
+
+    float r = 1.0f / (s1 * t2 - s2 * t1);
+    sDir = Float3((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+    tDir = Float3((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
+}
+
+// Orthonormalizes the accumulated tangent against the normal, and computes the bitangent
+static void OrthonormalizeTangentFrame(Vertex& vtx, const Float3& t, const Float3& bitangent)
+{
+    const Float3& n = vtx.Normal;
+
+    // Gram-Schmidt orthogonalize
+    Float3 tangent = (t - n * Float3::Dot(n, t));
+    bool zeroTangent = false;
+    if(tangent.Length() > 0.00001f)
+        Float3::Normalize(tangent);
+    else if(n.Length() > 0.00001f)
+    {
+        tangent = Float3::Perpendicular(n);
+        zeroTangent = true;
+    }
+
+    float sign = 1.0f;
+
+    if(!zeroTangent)
+    {
+        Float3 b;
+        b = Float3::Cross(n, t);
+        sign = (Float3::Dot(b, bitangent) < 0.0f) ? -1.0f : 1.0f;
+    }
+
+    // Store the tangent + bitangent
+    vtx.Tangent = Float3::Normalize(tangent);
+
+    vtx.Bitangent = Float3::Normalize(Float3::Cross(n, vtx.Tangent));
+    vtx.Bitangent *= sign;
+}
+
+#if UseAsserts_
+
+// Serial version of the tangent frame generation, used for validating the parallel version
+static void GenerateTangentFrameReference(std::vector<Vertex>& vertices, const uint8* indices,
+                                          uint32 numIndices, uint32 indexSize)
+{
+    const uint64 numVertices = vertices.size();
+    std::vector<Float3> tangents(numVertices);
+    std::vector<Float3> bitangents(numVertices);
+
+    for(uint32 i = 0; i < numIndices; i += 3)
+    {
+        uint32 i1 = GetIndex(indices, i + 0, indexSize);
+        uint32 i2 = GetIndex(indices, i + 1, indexSize);
+        uint32 i3 = GetIndex(indices, i + 2, indexSize);
+
+        Float3 sDir, tDir;
+        ComputeTriangleTangents(vertices[i1], vertices[i2], vertices[i3], sDir, tDir);
+
+        tangents[i1] += sDir;
+        tangents[i2] += sDir;
+        tangents[i3] += sDir;
+
+        bitangents[i1] += tDir;
+        bitangents[i2] += tDir;
+        bitangents[i3] += tDir;
+    }
+
+    for(uint64 i = 0; i < numVertices; ++i)
+        OrthonormalizeTangentFrame(vertices[i], tangents[i], bitangents[i]);
+}
+
+static bool TangentFramesMatch(const Vertex& a, const Vertex& b)
+{
+    const float tolerance = 0.0001f;
+    return Float3::Length(a.Tangent - b.Tangent) <= tolerance
+        && Float3::Length(a.Bitangent - b.Bitangent) <= tolerance;
+}
+
+#endif
+
 void Mesh::GenerateTangentFrame()
 {
     // Make sure that we have a position + texture coordinate + normal
@@ -654,105 +723,495 @@ void Mesh::GenerateTangentFrame()
 
     // Clone the mesh
     std::vector<Vertex> newVertices(numVertices);
+    ParallelFor(numVertices, TangentBatchSize, [&](uint64 start, uint64 end)
+    {
+        for(uint64 i = start; i < end; ++i)
+        {
+            const uint8* vtxData = vertices.Data() + i * vertexStride;
+            newVertices[i].Position = *reinterpret_cast<const Float3*>(vtxData + posOffset);
+            newVertices[i].Normal = *reinterpret_cast<const Float3*>(vtxData + nmlOffset);
+            newVertices[i].TexCoord = *reinterpret_cast<const Float2*>(vtxData + tcOffset);
+        }
+    });
+
+    const uint32 indexSize = IndexSize();
+    const uint64 numTriangles = numIndices / 3;
+    std::vector<uint32> triIndices(numTriangles * 3);
+    for(uint32 i = 0; i < numTriangles * 3; ++i)
+        triIndices[i] = GetIndex(indices.Data(), i, indexSize);
+
+    // Compute the tangent and bitangent directions for each triangle
+    std::vector<Float3> triSDirs(numTriangles);
+    std::vector<Float3> triTDirs(numTriangles);
+    ParallelFor(numTriangles, TangentBatchSize, [&](uint64 start, uint64 end)
+    {
+        for(uint64 i = start; i < end; ++i)
+        {
+            const uint32* tri = &triIndices[i * 3];
+            ComputeTriangleTangents(newVertices[tri[0]], newVertices[tri[1]], newVertices[tri[2]],
+                                    triSDirs[i], triTDirs[i]);
+        }
+    });
+
+    // Build the vertex -> triangle adjacency so that each vertex can sum up the directions of its
+    // triangles without any synchronization. The triangles for each vertex are kept in their
+    // original order, so the sums come out the same as a serial accumulation.
+    std::vector<uint32> adjacencyOffsets(numVertices + 1, 0);
+    for(uint64 i = 0; i < triIndices.size(); ++i)
+        ++adjacencyOffsets[triIndices[i] + 1];
+    for(uint64 i = 0; i < numVertices; ++i)
+        adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+    std::vector<uint32> adjacentTris(triIndices.size());
+    std::vector<uint32> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for(uint64 i = 0; i < triIndices.size(); ++i)
+        adjacentTris[fillOffsets[triIndices[i]]++] = uint32(i / 3);
+
+    // Accumulate into SoA arrays that are padded to a multiple of the SIMD width
+    const uint64 numBatches = (uint64(numVertices) + 3) / 4;
+    const uint64 paddedSize = numBatches * 4;
+    std::vector<float> soaData(paddedSize * 9, 0.0f);
+    float* nX = &soaData[paddedSize * 0];
+    float* nY = &soaData[paddedSize * 1];
+    float* nZ = &soaData[paddedSize * 2];
+    float* tX = &soaData[paddedSize * 3];
+    float* tY = &soaData[paddedSize * 4];
+    float* tZ = &soaData[paddedSize * 5];
+    float* bX = &soaData[paddedSize * 6];
+    float* bY = &soaData[paddedSize * 7];
+    float* bZ = &soaData[paddedSize * 8];
+
+    ParallelFor(numVertices, TangentBatchSize, [&](uint64 start, uint64 end)
+    {
+        for(uint64 i = start; i < end; ++i)
+        {
+            Float3 tangent;
+            Float3 bitangent;
+            for(uint32 j = adjacencyOffsets[i]; j < adjacencyOffsets[i + 1]; ++j)
+            {
+                tangent += triSDirs[adjacentTris[j]];
+                bitangent += triTDirs[adjacentTris[j]];
+            }
+
+            nX[i] = newVertices[i].Normal.x;
+            nY[i] = newVertices[i].Normal.y;
+            nZ[i] = newVertices[i].Normal.z;
+            tX[i] = tangent.x;
+            tY[i] = tangent.y;
+            tZ[i] = tangent.z;
+            bX[i] = bitangent.x;
+            bY[i] = bitangent.y;
+            bZ[i] = bitangent.z;
+        }
+    });
 
-    const uint8* vtxData = vertices.data();
-    for(uint32 i = 0; i < numVertices; ++i)
+    // Orthonormalize 4 vertices at a time. Vertices with a degenerate tangent go through the
+    // scalar path, which picks an arbitrary tangent perpendicular to the normal.
+    ParallelFor(numBatches, TangentBatchSize / 4, [&](uint64 start, uint64 end)
     {
-        newVertices[i].Position = *reinterpret_cast<const Float3*>(vtxData + posOffset);
-        newVertices[i].Normal = *reinterpret_cast<const Float3*>(vtxData + nmlOffset);
-        newVertices[i].TexCoord = *reinterpret_cast<const Float2*>(vtxData + tcOffset);
-        vtxData += vertexStride;
+        const XMVECTOR epsilon = XMVectorReplicate(0.00001f);
+        for(uint64 batch = start; batch < end; ++batch)
+        {
+            const uint64 base = batch * 4;
+            const XMVECTOR nx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(nX + base));
+            const XMVECTOR ny = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(nY + base));
+            const XMVECTOR nz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(nZ + base));
+            const XMVECTOR tx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(tX + base));
+            const XMVECTOR ty = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(tY + base));
+            const XMVECTOR tz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(tZ + base));
+            const XMVECTOR bx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(bX + base));
+            const XMVECTOR by = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(bY + base));
+            const XMVECTOR bz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(bZ + base));
+
+            // Gram-Schmidt orthogonalize
+            XMVECTOR nDotT = XMVectorMultiplyAdd(nz, tz, XMVectorMultiplyAdd(ny, ty, XMVectorMultiply(nx, tx)));
+            XMVECTOR gx = XMVectorNegativeMultiplySubtract(nx, nDotT, tx);
+            XMVECTOR gy = XMVectorNegativeMultiplySubtract(ny, nDotT, ty);
+            XMVECTOR gz = XMVectorNegativeMultiplySubtract(nz, nDotT, tz);
+            XMVECTOR gLen = XMVectorSqrt(XMVectorMultiplyAdd(gz, gz, XMVectorMultiplyAdd(gy, gy, XMVectorMultiply(gx, gx))));
+            const XMVECTOR valid = XMVectorGreater(gLen, epsilon);
+            gx = XMVectorDivide(gx, gLen);
+            gy = XMVectorDivide(gy, gLen);
+            gz = XMVectorDivide(gz, gLen);
+
+            // The handedness comes from the un-orthogonalized tangent
+            XMVECTOR cx = XMVectorNegativeMultiplySubtract(nz, ty, XMVectorMultiply(ny, tz));
+            XMVECTOR cy = XMVectorNegativeMultiplySubtract(nx, tz, XMVectorMultiply(nz, tx));
+            XMVECTOR cz = XMVectorNegativeMultiplySubtract(ny, tx, XMVectorMultiply(nx, ty));
+            XMVECTOR cDotB = XMVectorMultiplyAdd(cz, bz, XMVectorMultiplyAdd(cy, by, XMVectorMultiply(cx, bx)));
+            XMVECTOR sign = XMVectorSelect(XMVectorSplatOne(), XMVectorReplicate(-1.0f), XMVectorLess(cDotB, XMVectorZero()));
+
+            // Bitangent = normalize(cross(n, t)) * sign
+            XMVECTOR ox = XMVectorNegativeMultiplySubtract(nz, gy, XMVectorMultiply(ny, gz));
+            XMVECTOR oy = XMVectorNegativeMultiplySubtract(nx, gz, XMVectorMultiply(nz, gx));
+            XMVECTOR oz = XMVectorNegativeMultiplySubtract(ny, gx, XMVectorMultiply(nx, gy));
+            XMVECTOR oLen = XMVectorSqrt(XMVectorMultiplyAdd(oz, oz, XMVectorMultiplyAdd(oy, oy, XMVectorMultiply(ox, ox))));
+            XMVECTOR oScale = XMVectorDivide(sign, oLen);
+            ox = XMVectorMultiply(ox, oScale);
+            oy = XMVectorMultiply(oy, oScale);
+            oz = XMVectorMultiply(oz, oScale);
+
+            XMFLOAT4A outT[3];
+            XMFLOAT4A outB[3];
+            XMStoreFloat4A(&outT[0], gx);
+            XMStoreFloat4A(&outT[1], gy);
+            XMStoreFloat4A(&outT[2], gz);
+            XMStoreFloat4A(&outB[0], ox);
+            XMStoreFloat4A(&outB[1], oy);
+            XMStoreFloat4A(&outB[2], oz);
+
+            uint32 validMask[4];
+            XMStoreInt4(validMask, valid);
+
+            const uint64 batchEnd = std::min<uint64>(base + 4, numVertices);
+            for(uint64 i = base; i < batchEnd; ++i)
+            {
+                const uint64 lane = i - base;
+                Vertex& vtx = newVertices[i];
+                if(validMask[lane] == 0)
+                {
+                    OrthonormalizeTangentFrame(vtx, Float3(tX[i], tY[i], tZ[i]), Float3(bX[i], bY[i], bZ[i]));
+                    continue;
+                }
+
+                vtx.Tangent = Float3((&outT[0].x)[lane], (&outT[1].x)[lane], (&outT[2].x)[lane]);
+                vtx.Bitangent = Float3((&outB[0].x)[lane], (&outB[1].x)[lane], (&outB[2].x)[lane]);
+            }
+        }
+    });
+
+    #if UseAsserts_
+        std::vector<Vertex> reference(newVertices);
+        GenerateTangentFrameReference(reference, indices.Data(), numIndices, indexSize);
+        for(uint32 i = 0; i < numVertices; ++i)
+            AssertMsg_(TangentFramesMatch(newVertices[i], reference[i]), "Tangent frame mismatch for vertex %u", i);
+    #endif
+
+    inputElements.clear();
+    inputElements.resize(sizeof(VertexInputs) / sizeof(D3D11_INPUT_ELEMENT_DESC));
+    memcpy(inputElements.data(), VertexInputs, sizeof(VertexInputs));
+
+    vertexStride = sizeof(Vertex);
+    std::vector<uint8>& vertexStorage = vertices.Modify();
+    vertexStorage.clear();
+    vertexStorage.resize(numVertices * vertexStride);
+    memcpy(vertexStorage.data(), newVertices.data(), numVertices * vertexStride);
+}
+
+// Reorders the triangles in each part for the post-transform cache and for overdraw, and then
+// reorders the vertices so that they're fetched in the order that they're first referenced
+void Mesh::Optimize()
+{
+    uint32 posOffset = 0xFFFFFFFF;
+    for(uint32 i = 0; i < inputElements.size(); ++i)
+        if(std::string(inputElements[i].SemanticName) == "POSITION")
+            posOffset = inputElements[i].AlignedByteOffset;
+
+    if(posOffset == 0xFFFFFFFF || numIndices < 3)
+        return;
+
+    const uint32 indexSize = IndexSize();
+    vector<uint32> newIndices(numIndices);
+    for(uint32 i = 0; i < numIndices; ++i)
+        newIndices[i] = GetIndex(indices.Data(), i, indexSize);
+
+    cacheStatsBefore = AnalyzeVertexCache(newIndices.data(), numIndices, numVertices);
+
+    // Parts are drawn separately, so their triangles can only be reordered within the part. Each
+    // part is optimized with its own vertex IDs, so that the cost doesn't depend on the size of the
+    // whole mesh.
+    const uint8* positions = vertices.Data() + posOffset;
+    vector<uint32> globalToLocal(numVertices, 0xFFFFFFFF);
+    vector<uint32> localToGlobal;
+    vector<Float3> localPositions;
+    for(uint64 partIdx = 0; partIdx < meshParts.size(); ++partIdx)
+    {
+        const MeshPart& part = meshParts[partIdx];
+        uint32* partIndices = newIndices.data() + part.IndexStart;
+        RemapToLocalVertices(partIndices, part.IndexCount, globalToLocal, localToGlobal);
+
+        localPositions.resize(localToGlobal.size());
+        for(uint64 v = 0; v < localToGlobal.size(); ++v)
+            localPositions[v] = *reinterpret_cast<const Float3*>(positions + uint64(localToGlobal[v]) * vertexStride);
+
+        OptimizeVertexCache(partIndices, part.IndexCount, localToGlobal.size());
+        OptimizeOverdraw(partIndices, part.IndexCount, reinterpret_cast<const uint8*>(localPositions.data()),
+                         sizeof(Float3), localToGlobal.size());
+        RemapToGlobalVertices(partIndices, part.IndexCount, localToGlobal);
     }
 
-    // Compute the tangent frame for each vertex. The following code is based on
-    // "Computing Tangent Space Basis Vectors for an Arbitrary Mesh", by Eric Lengyel
-    // http://www.terathon.com/code/tangent.html
+    vector<uint32> remap;
+    BuildVertexFetchRemap(newIndices.data(), numIndices, numVertices, remap);
 
-    // Make temporary arrays for the tangent and the bitangent
-    std::vector<Float3> tangents(numVertices);
-    std::vector<Float3> bitangents(numVertices);
+    vector<uint8> newVertices(vertices.Size());
+    for(uint32 i = 0; i < numVertices; ++i)
+        memcpy(&newVertices[remap[i] * vertexStride], vertices.Data() + i * vertexStride, vertexStride);
+    vertices.Modify().swap(newVertices);
 
-    // Loop through each triangle
-    const uint32 indexSize = indexType == IndexType::Index16Bit ? 2 : 4;
-    for (uint32 i = 0; i < numIndices; i += 3)
+    uint8* indexData = indices.Modify().data();
+    for(uint32 i = 0; i < numIndices; ++i)
     {
-        uint32 i1 = GetIndex(indices.data(), i + 0, indexSize);
-        uint32 i2 = GetIndex(indices.data(), i + 1, indexSize);
-        uint32 i3 = GetIndex(indices.data(), i + 2, indexSize);
-
-        const Float3& v1 = newVertices[i1].Position;
-        const Float3& v2 = newVertices[i2].Position;
-        const Float3& v3 = newVertices[i3].Position;
-
-        const Float2& w1 = newVertices[i1].TexCoord;
-        const Float2& w2 = newVertices[i2].TexCoord;
-        const Float2& w3 = newVertices[i3].TexCoord;
-
-        float x1 = v2.x - v1.x;
-        float x2 = v3.x - v1.x;
-        float y1 = v2.y - v1.y;
-        float y2 = v3.y - v1.y;
-        float z1 = v2.z - v1.z;
-        float z2 = v3.z - v1.z;
-
-        float s1 = w2.x - w1.x;
-        float s2 = w3.x - w1.x;
-        float t1 = w2.y - w1.y;
-        float t2 = w3.y - w1.y;
-
-        float r = 1.0f / (s1 * t2 - s2 * t1);
-        Float3 sDir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
-        Float3 tDir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
+        newIndices[i] = remap[newIndices[i]];
+        if(indexSize == 2)
+            reinterpret_cast<uint16*>(indexData)[i] = uint16(newIndices[i]);
+        else
+            reinterpret_cast<uint32*>(indexData)[i] = newIndices[i];
+    }
 
-        tangents[i1] += sDir;
-        tangents[i2] += sDir;
-        tangents[i3] += sDir;
+    // The vertex ranges of the parts need to be recomputed from the remapped indices
+    for(uint64 partIdx = 0; partIdx < meshParts.size(); ++partIdx)
+    {
+        MeshPart& part = meshParts[partIdx];
+        if(part.IndexCount == 0)
+            continue;
 
-        bitangents[i1] += tDir;
-        bitangents[i2] += tDir;
-        bitangents[i3] += tDir;
+        uint32 minVertex = 0xFFFFFFFF;
+        uint32 maxVertex = 0;
+        for(uint32 i = part.IndexStart; i < part.IndexStart + part.IndexCount; ++i)
+        {
+            minVertex = std::min(minVertex, newIndices[i]);
+            maxVertex = std::max(maxVertex, newIndices[i]);
+        }
+
+        part.VertexStart = minVertex;
+        part.VertexCount = maxVertex - minVertex + 1;
     }
 
-    for (uint32 i = 0; i < numVertices; ++i)
+    cacheStatsAfter = AnalyzeVertexCache(newIndices.data(), numIndices, numVertices);
+    optimized = true;
+
+    BuildMeshlets();
+    ComputePartBounds();
+    GenerateLODs();
+}
+
+// Computes an AABB and a bounding sphere for each part from the vertices that it references
+void Mesh::ComputePartBounds()
+{
+    partBounds.clear();
+
+    uint32 posOffset = 0xFFFFFFFF;
+    for(uint32 i = 0; i < inputElements.size(); ++i)
+        if(std::string(inputElements[i].SemanticName) == "POSITION")
+            posOffset = inputElements[i].AlignedByteOffset;
+
+    if(posOffset == 0xFFFFFFFF)
+        return;
+
+    const uint32 indexSize = IndexSize();
+    partBounds.resize(meshParts.size());
+    for(uint64 partIdx = 0; partIdx < meshParts.size(); ++partIdx)
     {
-        Float3& n = newVertices[i].Normal;
-        Float3& t = tangents[i];
-
-        // Gram-Schmidt orthogonalize
-        Float3 tangent = (t - n * Float3::Dot(n, t));
-        bool zeroTangent = false;
-        if(tangent.Length() > 0.00001f)
-            Float3::Normalize(tangent);
-        else if(n.Length() > 0.00001f)
+        const MeshPart& part = meshParts[partIdx];
+        MeshPartBounds& bounds = partBounds[partIdx];
+        if(part.IndexCount == 0)
+            continue;
+
+        XMVECTOR mins = XMVectorReplicate(FLT_MAX);
+        XMVECTOR maxes = XMVectorReplicate(-FLT_MAX);
+        for(uint32 i = part.IndexStart; i < part.IndexStart + part.IndexCount; ++i)
         {
-            tangent = Float3::Perpendicular(n);
-            zeroTangent = true;
+            const uint32 idx = GetIndex(indices.Data(), i, indexSize);
+            const XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertices.Data() + idx * vertexStride + posOffset));
+            mins = XMVectorMin(mins, position);
+            maxes = XMVectorMax(maxes, position);
         }
 
-        float sign = 1.0f;
+        bounds.Min = mins;
+        bounds.Max = maxes;
+        bounds.SphereCenter = XMVectorScale(XMVectorAdd(mins, maxes), 0.5f);
 
-        if(!zeroTangent)
+        XMVECTOR radiusSq = XMVectorZero();
+        for(uint32 i = part.IndexStart; i < part.IndexStart + part.IndexCount; ++i)
         {
-            Float3 b;
-            b = Float3::Cross(n, t);
-            sign = (Float3::Dot(b, bitangents[i]) < 0.0f) ? -1.0f : 1.0f;
+            const uint32 idx = GetIndex(indices.Data(), i, indexSize);
+            const XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertices.Data() + idx * vertexStride + posOffset));
+            radiusSq = XMVectorMax(radiusSq, XMVector3LengthSq(XMVectorSubtract(position, bounds.SphereCenter.ToSIMD())));
         }
 
-        // Store the tangent + bitangent
-        newVertices[i].Tangent = Float3::Normalize(tangent);
+        bounds.SphereRadius = std::sqrt(XMVectorGetX(radiusSq));
+    }
+}
+
+// Splits each part into meshlets, which needs to happen after the triangles are reordered since
+// the meshlets are contiguous ranges of the index buffer
+void Mesh::BuildMeshlets()
+{
+    meshlets.clear();
 
-        newVertices[i].Bitangent = Float3::Normalize(Float3::Cross(n, tangent));
-        newVertices[i].Bitangent *= sign;
+    uint32 posOffset = 0xFFFFFFFF;
+    for(uint32 i = 0; i < inputElements.size(); ++i)
+        if(std::string(inputElements[i].SemanticName) == "POSITION")
+            posOffset = inputElements[i].AlignedByteOffset;
+
+    if(posOffset == 0xFFFFFFFF || numIndices < 3)
+        return;
+
+    const uint32 indexSize = IndexSize();
+    vector<uint32> meshIndices(numIndices);
+    for(uint32 i = 0; i < numIndices; ++i)
+        meshIndices[i] = GetIndex(indices.Data(), i, indexSize);
+
+    const uint8* positions = vertices.Data() + posOffset;
+    for(uint64 partIdx = 0; partIdx < meshParts.size(); ++partIdx)
+    {
+        const MeshPart& part = meshParts[partIdx];
+        SampleFramework11::BuildMeshlets(meshIndices.data(), part.IndexStart, part.IndexCount, uint32(partIdx),
+                                         positions, vertexStride, meshlets);
     }
+}
 
-    inputElements.clear();
-    inputElements.resize(sizeof(VertexInputs) / sizeof(D3D11_INPUT_ELEMENT_DESC));
-    memcpy(inputElements.data(), VertexInputs, sizeof(VertexInputs));
+// Builds the triangle BVH from the full-detail triangles, skipping any LODs at the end of the
+// index buffer
+void Mesh::BuildBVH()
+{
+    bvhBuilt = true;
 
-    vertexStride = sizeof(Vertex);
-    vertices.clear();
-    vertices.resize(numVertices * vertexStride);
-    memcpy(vertices.data(), newVertices.data(), numVertices * vertexStride);
+    uint32 posOffset = 0xFFFFFFFF;
+    for(uint32 i = 0; i < inputElements.size(); ++i)
+        if(std::string(inputElements[i].SemanticName) == "POSITION")
+            posOffset = inputElements[i].AlignedByteOffset;
+
+    uint32 baseIndexCount = 0;
+    for(uint64 partIdx = 0; partIdx < meshParts.size(); ++partIdx)
+        baseIndexCount = std::max(baseIndexCount, meshParts[partIdx].IndexStart + meshParts[partIdx].IndexCount);
+
+    if(posOffset == 0xFFFFFFFF || baseIndexCount < 3)
+    {
+        bvh = BVH();
+        return;
+    }
+
+    const uint32 indexSize = IndexSize();
+    vector<uint32> meshIndices(baseIndexCount);
+    for(uint32 i = 0; i < baseIndexCount; ++i)
+        meshIndices[i] = GetIndex(indices.Data(), i, indexSize);
+
+    bvh.Build(vertices.Data() + posOffset, vertexStride, meshIndices.data(), baseIndexCount / 3);
+}
+
+const BVH& Mesh::TriangleBVH()
+{
+    if(bvhBuilt == false)
+        BuildBVH();
+    return bvh;
+}
+
+void Mesh::RefitBVH(const Float4x4& transform)
+{
+    if(bvhBuilt == false)
+        BuildBVH();
+    bvh.Refit(transform);
+}
+
+// Number of LODs per part, including the full-detail part
+static const uint32 MaxMeshLODs = 4;
+
+// LODs aren't generated below this many triangles, or past this much error relative to the size
+// of the part
+static const uint64 MinLODTriangles = 64;
+static const float MaxLODError = 0.1f;
+
+// Generates a chain of simplified LODs for each part, where each LOD targets half of the triangles
+// of the previous one. The chain stops early once the simplifier can't make enough progress.
+// The LOD indices are cache-optimized and appended to the index buffer.
+void Mesh::GenerateLODs()
+{
+    lods.clear();
+
+    uint32 posOffset = 0xFFFFFFFF;
+    uint32 nmlOffset = 0xFFFFFFFF;
+    uint32 tcOffset = 0xFFFFFFFF;
+    for(uint32 i = 0; i < inputElements.size(); ++i)
+    {
+        const std::string semantic = inputElements[i].SemanticName;
+        const uint32 offset = inputElements[i].AlignedByteOffset;
+        const DXGI_FORMAT format = inputElements[i].Format;
+        if(semantic == "POSITION")
+            posOffset = offset;
+        else if(semantic == "NORMAL" && format == DXGI_FORMAT_R32G32B32_FLOAT)
+            nmlOffset = offset;
+        else if(semantic == "TEXCOORD" && inputElements[i].SemanticIndex == 0 && format == DXGI_FORMAT_R32G32_FLOAT)
+            tcOffset = offset;
+    }
+
+    if(posOffset == 0xFFFFFFFF || numIndices < 3)
+        return;
+
+    // Any LODs that were generated earlier are at the end of the index buffer
+    uint32 baseIndexCount = 0;
+    for(uint64 partIdx = 0; partIdx < meshParts.size(); ++partIdx)
+        baseIndexCount = std::max(baseIndexCount, meshParts[partIdx].IndexStart + meshParts[partIdx].IndexCount);
+
+    const uint32 indexSize = IndexSize();
+    vector<uint32> meshIndices(baseIndexCount);
+    for(uint32 i = 0; i < baseIndexCount; ++i)
+        meshIndices[i] = GetIndex(indices.Data(), i, indexSize);
+
+    vector<vector<MeshLOD>> partLODs(meshParts.size());
+    vector<vector<uint32>> partLODIndices(meshParts.size());
+    ParallelFor(meshParts.size(), 1, [&](uint64 start, uint64 end)
+    {
+        vector<uint32> lodIndices;
+        for(uint64 partIdx = start; partIdx < end; ++partIdx)
+        {
+            const MeshPart& part = meshParts[partIdx];
+            uint64 prevIndexCount = part.IndexCount;
+            for(uint32 lodIdx = 1; lodIdx < MaxMeshLODs; ++lodIdx)
+            {
+                const uint64 targetIndexCount = (uint64(part.IndexCount) >> lodIdx) / 3 * 3;
+                if(targetIndexCount < MinLODTriangles * 3)
+                    break;
+
+                const float error = SimplifyMesh(&meshIndices[part.IndexStart], part.IndexCount, vertices.Data(),
+                                                 vertexStride, posOffset, nmlOffset, tcOffset, targetIndexCount,
+                                                 MaxLODError, lodIndices);
+                if(lodIndices.size() * 4 > prevIndexCount * 3)
+                    break;
+
+                // The LOD only references vertices from the part, so the part's vertex range is
+                // enough for the cache optimizer
+                for(uint64 i = 0; i < lodIndices.size(); ++i)
+                    lodIndices[i] -= part.VertexStart;
+                OptimizeVertexCache(lodIndices.data(), lodIndices.size(), part.VertexCount);
+                for(uint64 i = 0; i < lodIndices.size(); ++i)
+                    lodIndices[i] += part.VertexStart;
+
+                MeshLOD lod;
+                lod.PartIdx = uint32(partIdx);
+                lod.IndexStart = uint32(partLODIndices[partIdx].size());
+                lod.IndexCount = uint32(lodIndices.size());
+                lod.Error = error;
+                partLODs[partIdx].push_back(lod);
+                partLODIndices[partIdx].insert(partLODIndices[partIdx].end(), lodIndices.begin(), lodIndices.end());
+                prevIndexCount = lodIndices.size();
+            }
+        }
+    });
+
+    for(uint64 partIdx = 0; partIdx < meshParts.size(); ++partIdx)
+    {
+        const uint32 partStart = uint32(meshIndices.size());
+        for(uint64 lodIdx = 0; lodIdx < partLODs[partIdx].size(); ++lodIdx)
+        {
+            MeshLOD lod = partLODs[partIdx][lodIdx];
+            lod.IndexStart += partStart;
+            lods.push_back(lod);
+        }
+
+        meshIndices.insert(meshIndices.end(), partLODIndices[partIdx].begin(), partLODIndices[partIdx].end());
+    }
+
+    numIndices = uint32(meshIndices.size());
+    std::vector<uint8>& indexStorage = indices.Modify();
+    indexStorage.resize(uint64(numIndices) * indexSize);
+    for(uint32 i = 0; i < numIndices; ++i)
+    {
+        if(indexSize == 2)
+            reinterpret_cast<uint16*>(indexStorage.data())[i] = uint16(meshIndices[i]);
+        else
+            reinterpret_cast<uint32*>(indexStorage.data())[i] = meshIndices[i];
+    }
 }
 
 void Mesh::CreateInputElements(const D3DVERTEXELEMENT9* declaration)
@@ -807,30 +1266,75 @@ void Mesh::CreateInputElements(const D3DVERTEXELEMENT9* declaration)
 
 void Mesh::CreateVertexAndIndexBuffers(ID3D11Device* device)
 {
-    Assert_(numVertices > 0);
     Assert_(numIndices > 0);
 
+    CreateVertexBuffer(device);
+
     D3D11_BUFFER_DESC bufferDesc;
     bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    bufferDesc.ByteWidth = vertexStride * numVertices;
-    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bufferDesc.ByteWidth = IndexSize() * numIndices;
+    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
     bufferDesc.CPUAccessFlags = 0;
     bufferDesc.MiscFlags = 0;
     bufferDesc.StructureByteStride = 0;
 
     D3D11_SUBRESOURCE_DATA initData;
-    initData.pSysMem = vertices.data();
+    initData.pSysMem = indices.Data();
     initData.SysMemPitch = 0;
     initData.SysMemSlicePitch = 0;
-    DXCall(device->CreateBuffer(&bufferDesc, &initData, &vertexBuffer));
+    DXCall(device->CreateBuffer(&bufferDesc, &initData, &indexBuffer));
+}
 
-    bufferDesc.ByteWidth = IndexSize() * numIndices;
-    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+// Creates the vertex buffer from the CPU-side vertex data, encoding it into the compressed layout
+// if compression is enabled. The CPU-side data is always kept at full precision.
+void Mesh::CreateVertexBuffer(ID3D11Device* device)
+{
+    Assert_(numVertices > 0);
+
+    vbCompressed = compressVertices && CanCompressVertices(inputElements.data(), uint32(inputElements.size()));
+
+    std::vector<CompressedVertex> compressed;
+    const void* vbData = vertices.Data();
+    if(vbCompressed)
+    {
+        uint32 posOffset = 0;
+        for(uint64 i = 0; i < inputElements.size(); ++i)
+            if(std::string(inputElements[i].SemanticName) == "POSITION")
+                posOffset = inputElements[i].AlignedByteOffset;
+
+        XMVECTOR mins = XMVectorReplicate(FLT_MAX);
+        XMVECTOR maxes = XMVectorReplicate(-FLT_MAX);
+        for(uint32 i = 0; i < numVertices; ++i)
+        {
+            const Float3& position = *reinterpret_cast<const Float3*>(vertices.Data() + i * vertexStride + posOffset);
+            mins = XMVectorMin(mins, position.ToSIMD());
+            maxes = XMVectorMax(maxes, position.ToSIMD());
+        }
+
+        positionMin = mins;
+        positionMax = maxes;
+
+        compressed.resize(numVertices);
+        CompressVertices(vertices.Data(), vertexStride, numVertices, inputElements.data(),
+                         uint32(inputElements.size()), positionMin, positionMax, compressed.data());
+        vbData = compressed.data();
+    }
+
+    D3D11_BUFFER_DESC bufferDesc;
+    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    bufferDesc.ByteWidth = VertexBufferStride() * numVertices;
+    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bufferDesc.CPUAccessFlags = 0;
     bufferDesc.MiscFlags = 0;
     bufferDesc.StructureByteStride = 0;
 
-    initData.pSysMem = indices.data();
-    DXCall(device->CreateBuffer(&bufferDesc, &initData, &indexBuffer));
+    D3D11_SUBRESOURCE_DATA initData;
+    initData.pSysMem = vbData;
+    initData.SysMemPitch = 0;
+    initData.SysMemSlicePitch = 0;
+
+    vertexBuffer = nullptr;
+    DXCall(device->CreateBuffer(&bufferDesc, &initData, &vertexBuffer));
 }
 
 // Does a basic draw of all parts
@@ -838,7 +1342,7 @@ void Mesh::Render(ID3D11DeviceContext* context)
 {
     // Set the vertices and indices
     ID3D11Buffer* vertexBuffers[1] = { vertexBuffer };
-    uint32 vertexStrides[1] = { vertexStride };
+    uint32 vertexStrides[1] = { VertexBufferStride() };
     uint32 offsets[1] = { 0 };
     context->IASetVertexBuffers(0, 1, vertexBuffers, vertexStrides, offsets);
     context->IASetIndexBuffer(indexBuffer, IndexBufferFormat(), 0);
@@ -859,6 +1363,15 @@ void Model::CreateFromSDKMeshFile(ID3D11Device* device, LPCWSTR fileName, const
 {
     Assert_(FileExists(fileName));
 
+    std::string importOptions = "SDKMesh";
+    importOptions += normalMapSuffix ? "|NormalMapSuffix=" + WStringToAnsi(normalMapSuffix) : "";
+    importOptions += generateTangentFrame ? "|GenerateTangentFrame" : "";
+    importOptions += overrideNormalMaps ? "|OverrideNormalMaps" : "";
+    importOptions += forceSRGB ? "|ForceSRGB" : "";
+    const wstring cachePath = ModelCachePath(fileName, importOptions);
+    if(LoadFromCache(device, cachePath.c_str(), forceSRGB))
+        return;
+
     // Use the SDKMesh class to load in the data
     SDKMesh sdkMesh;
     sdkMesh.Create(fileName);
@@ -889,21 +1402,27 @@ void Model::CreateFromSDKMeshFile(ID3D11Device* device, LPCWSTR fileName, const
             material.NormalMapName = base + normalMapSuffix + L"." + extension;
         }
 
-        LoadMaterialResources(material, fileDirectory, device, forceSRGB);
-
         meshMaterials.push_back(material);
+        LoadMaterialResources(meshMaterials.size() - 1, device, forceSRGB);
     }
 
     uint32 numMeshes = sdkMesh.GetNumMeshes();
     meshes.resize(numMeshes);
     for(uint32 meshIdx = 0; meshIdx < numMeshes; ++meshIdx)
         meshes[meshIdx].InitFromSDKMesh(device, sdkMesh, meshIdx, generateTangentFrame);
+
+    PrepareModelCache();
+    SaveToMeshData(cachePath.c_str());
 }
 
 void Model::CreateWithAssimp(ID3D11Device* device, const wchar* fileName, bool forceSRGB)
 {
     Assert_(FileExists(fileName));
 
+    const wstring cachePath = ModelCachePath(fileName, forceSRGB ? "Assimp|ForceSRGB" : "Assimp");
+    if(LoadFromCache(device, cachePath.c_str(), forceSRGB))
+        return;
+
     std::string fileNameAnsi = WStringToAnsi(fileName);
 
     Assimp::Importer importer;
@@ -946,9 +1465,8 @@ void Model::CreateWithAssimp(ID3D11Device* device, const wchar* fileName, bool f
            || mat.GetTexture(aiTextureType_HEIGHT, 0, &normalMapPath) == aiReturn_SUCCESS)
             material.NormalMapName = GetFileName(AnsiToWString(normalMapPath.C_Str()).c_str());
 
-        LoadMaterialResources(material, fileDirectory, device, forceSRGB);
-
         meshMaterials.push_back(material);
+        LoadMaterialResources(meshMaterials.size() - 1, device, forceSRGB);
     }
 
     // Initialize the meshes
@@ -956,12 +1474,211 @@ void Model::CreateWithAssimp(ID3D11Device* device, const wchar* fileName, bool f
     meshes.resize(numMeshes);
     for(uint64 i = 0; i < numMeshes; ++i)
         meshes[i].InitFromAssimpMesh(device, *scene->mMeshes[i]);
+
+    PrepareModelCache();
+    SaveToMeshData(cachePath.c_str());
+}
+
+// Loads a previously-imported model from the cache. Returns false if there's no cached model, or
+// if it couldn't be loaded, in which case the model is left empty so that it can be re-imported.
+bool Model::LoadFromCache(ID3D11Device* device, const wchar* cachePath, bool forceSRGB)
+{
+    if(FileExists(cachePath) == false)
+        return false;
+
+    try
+    {
+        CreateFromMeshData(device, cachePath, forceSRGB);
+        return true;
+    }
+    catch(Exception&)
+    {
+        for(uint64 i = 0; i < textureRefs.size(); ++i)
+            ReleaseSharedTexture(textureRefs[i].Path.c_str(), textureRefs[i].ForceSRGB);
+        textureRefs.clear();
+        pendingTextures.clear();
+        meshes.clear();
+        meshMaterials.clear();
+        fileDirectory.clear();
+        return false;
+    }
 }
 
+// .meshdata chunks. The model chunk has the materials, and each mesh has a metadata chunk plus
+// separate aligned chunks for its vertex and index data.
+static const uint32 ModelChunkID = MakeChunkID('M', 'O', 'D', 'L');
+static const uint32 MeshChunkID = MakeChunkID('M', 'E', 'S', 'H');
+static const uint32 VertexChunkID = MakeChunkID('V', 'T', 'X', 'B');
+static const uint32 IndexChunkID = MakeChunkID('I', 'D', 'X', 'B');
+static const uint32 CacheStatsChunkID = MakeChunkID('V', 'C', 'S', 'T');
+static const uint32 MeshletChunkID = MakeChunkID('M', 'S', 'H', 'L');
+static const uint32 LODChunkID = MakeChunkID('L', 'O', 'D', 'S');
+static const uint32 BoundsChunkID = MakeChunkID('B', 'N', 'D', 'S');
+static const uint32 BVHChunkID = MakeChunkID('B', 'V', 'H', 'N');
+
 void Model::CreateFromMeshData(ID3D11Device* device, const wchar* fileName, bool forceSRGB)
 {
-    FileReadSerializer serializer(fileName);
-    Serialize(serializer, device, forceSRGB);
+    ChunkFileReader reader(fileName);
+    if(reader.IsChunkFile() == false)
+    {
+        // Older files are a raw serialized stream, which was written before meshes were optimized.
+        // They're optimized once and saved to the model cache, and loaded from there afterwards.
+        const wstring cachePath = ModelCachePath(fileName, "MeshData");
+        if(LoadFromCache(device, cachePath.c_str(), forceSRGB))
+            return;
+
+        MappedFileReadSerializer serializer(reader.Mapping(), 0, reader.Mapping()->Size());
+        SerializeItem(serializer, meshes);
+        SerializeItem(serializer, meshMaterials);
+        SerializeItem(serializer, fileDirectory);
+
+        ParallelFor(meshes.size(), 1, [&](uint64 start, uint64 end)
+        {
+            for(uint64 i = start; i < end; ++i)
+                meshes[i].Optimize();
+        });
+
+        PrepareModelCache();
+        SaveToMeshData(cachePath.c_str());
+    }
+    else
+    {
+        if(reader.ContentVersion() != MeshDataVersion)
+            throw Exception(wstring(L"Unsupported .meshdata version in file ") + fileName);
+
+        MappedFileReadSerializer modelSerializer = reader.ChunkSerializer(ModelChunkID, 0);
+        uint64 numMeshes = 0;
+        SerializeItem(modelSerializer, numMeshes);
+        SerializeItem(modelSerializer, meshMaterials);
+        SerializeItem(modelSerializer, fileDirectory);
+
+        // The chunks for each mesh are independent, so they can be validated and copied in parallel.
+        // Meshes without a stats chunk were saved before meshes were optimized, and meshes without
+        // a meshlet, bounds, or LOD chunk were saved before those were generated. The BVH is only
+        // saved if it was built before the mesh was saved, otherwise it's built on first use.
+        meshes.resize(numMeshes);
+        ParallelFor(numMeshes, 1, [&](uint64 start, uint64 end)
+        {
+            for(uint64 i = start; i < end; ++i)
+            {
+                Mesh& mesh = meshes[i];
+                MappedFileReadSerializer meshSerializer = reader.ChunkSerializer(MeshChunkID, uint32(i));
+                mesh.SerializeMetadata(meshSerializer);
+
+                reader.ReadChunk(VertexChunkID, uint32(i), mesh.vertices);
+                reader.ReadChunk(IndexChunkID, uint32(i), mesh.indices);
+
+                if(reader.HasChunk(CacheStatsChunkID, uint32(i)))
+                {
+                    MappedFileReadSerializer statsSerializer = reader.ChunkSerializer(CacheStatsChunkID, uint32(i));
+                    SerializeItem(statsSerializer, mesh.cacheStatsBefore);
+                    SerializeItem(statsSerializer, mesh.cacheStatsAfter);
+                    mesh.optimized = true;
+
+                    if(reader.HasChunk(MeshletChunkID, uint32(i)))
+                    {
+                        MappedFileReadSerializer meshletSerializer = reader.ChunkSerializer(MeshletChunkID, uint32(i));
+                        SerializeRawVector(meshletSerializer, mesh.meshlets);
+                    }
+                    else
+                        mesh.BuildMeshlets();
+
+                    if(reader.HasChunk(BoundsChunkID, uint32(i)))
+                    {
+                        MappedFileReadSerializer boundsSerializer = reader.ChunkSerializer(BoundsChunkID, uint32(i));
+                        SerializeRawVector(boundsSerializer, mesh.partBounds);
+                    }
+                    else
+                        mesh.ComputePartBounds();
+
+                    if(reader.HasChunk(BVHChunkID, uint32(i)))
+                    {
+                        MappedFileReadSerializer bvhSerializer = reader.ChunkSerializer(BVHChunkID, uint32(i));
+                        mesh.bvh.Serialize(bvhSerializer);
+                        mesh.bvhBuilt = true;
+                    }
+
+                    if(reader.HasChunk(LODChunkID, uint32(i)))
+                    {
+                        MappedFileReadSerializer lodSerializer = reader.ChunkSerializer(LODChunkID, uint32(i));
+                        SerializeRawVector(lodSerializer, mesh.lods);
+                    }
+                    else
+                        mesh.GenerateLODs();
+                }
+                else
+                    mesh.Optimize();
+            }
+        });
+    }
+
+    if(device != nullptr)
+        for(uint64 i = 0; i < meshes.size(); ++i)
+            meshes[i].CreateVertexAndIndexBuffers(device);
+
+    for(uint64 i = 0; i < meshMaterials.size(); ++i)
+        LoadMaterialResources(i, device, forceSRGB);
+}
+
+void Model::SaveToMeshData(const wchar* fileName, bool compress)
+{
+    ChunkFileWriter writer(MeshDataVersion);
+
+    MemoryWriteSerializer modelSerializer;
+    uint64 numMeshes = meshes.size();
+    SerializeItem(modelSerializer, numMeshes);
+    SerializeItem(modelSerializer, meshMaterials);
+    SerializeItem(modelSerializer, fileDirectory);
+    writer.AddChunk(ModelChunkID, 0, modelSerializer.Buffer().data(), modelSerializer.Buffer().size());
+
+    for(uint64 i = 0; i < meshes.size(); ++i)
+    {
+        Mesh& mesh = meshes[i];
+
+        MemoryWriteSerializer meshSerializer;
+        mesh.SerializeMetadata(meshSerializer);
+        writer.AddChunk(MeshChunkID, uint32(i), meshSerializer.Buffer().data(), meshSerializer.Buffer().size());
+        writer.AddChunk(VertexChunkID, uint32(i), mesh.vertices.Data(), mesh.vertices.Size(), compress);
+        writer.AddChunk(IndexChunkID, uint32(i), mesh.indices.Data(), mesh.indices.Size(), compress);
+
+        if(mesh.optimized)
+        {
+            MemoryWriteSerializer statsSerializer;
+            SerializeItem(statsSerializer, mesh.cacheStatsBefore);
+            SerializeItem(statsSerializer, mesh.cacheStatsAfter);
+            writer.AddChunk(CacheStatsChunkID, uint32(i), statsSerializer.Buffer().data(), statsSerializer.Buffer().size());
+        }
+
+        if(mesh.meshlets.size() > 0)
+        {
+            MemoryWriteSerializer meshletSerializer;
+            SerializeRawVector(meshletSerializer, mesh.meshlets);
+            writer.AddChunk(MeshletChunkID, uint32(i), meshletSerializer.Buffer().data(), meshletSerializer.Buffer().size());
+        }
+
+        if(mesh.partBounds.size() > 0)
+        {
+            MemoryWriteSerializer boundsSerializer;
+            SerializeRawVector(boundsSerializer, mesh.partBounds);
+            writer.AddChunk(BoundsChunkID, uint32(i), boundsSerializer.Buffer().data(), boundsSerializer.Buffer().size());
+        }
+
+        if(mesh.bvh.Empty() == false)
+        {
+            MemoryWriteSerializer bvhSerializer;
+            mesh.bvh.Serialize(bvhSerializer);
+            writer.AddChunk(BVHChunkID, uint32(i), bvhSerializer.Buffer().data(), bvhSerializer.Buffer().size());
+        }
+
+        if(mesh.lods.size() > 0)
+        {
+            MemoryWriteSerializer lodSerializer;
+            SerializeRawVector(lodSerializer, mesh.lods);
+            writer.AddChunk(LODChunkID, uint32(i), lodSerializer.Buffer().data(), lodSerializer.Buffer().size());
+        }
+    }
+
+    writer.Write(fileName);
 }
 
 void Model::GenerateBoxScene(ID3D11Device* device, const Float3& dimensions, const Float3& position,
@@ -972,8 +1689,8 @@ void Model::GenerateBoxScene(ID3D11Device* device, const Float3& dimensions, con
     material.DiffuseMapName = colorMap;
     material.NormalMapName = normalMap;
     fileDirectory = L"..\\Content\\Textures\\";
-    LoadMaterialResources(material, L"..\\Content\\Textures\\", device, false);
     meshMaterials.push_back(material);
+    LoadMaterialResources(meshMaterials.size() - 1, device, false);
 
     meshes.resize(1);
     meshes[0].InitBox(device, dimensions, position, orientation, 0);
@@ -985,8 +1702,8 @@ void Model::GenerateBoxTestScene(ID3D11Device* device)
     material.DiffuseMapName = L"White.png";
     material.NormalMapName = L"Hex.png";
     fileDirectory = L"..\\Content\\Textures\\";
-    LoadMaterialResources(material, L"..\\Content\\Textures\\", device, false);
     meshMaterials.push_back(material);
+    LoadMaterialResources(meshMaterials.size() - 1, device, false);
 
     meshes.resize(2);
     meshes[0].InitBox(device, Float3(2.0f), Float3(0.0f, 1.5f, 0.0f), Quaternion(), 0);
@@ -1002,8 +1719,8 @@ void Model::GeneratePlaneScene(ID3D11Device* device, const Float2& dimensions, c
     material.DiffuseMapName = colorMap;
     material.NormalMapName = normalMap;
     fileDirectory = L"..\\Content\\Textures\\";
-    LoadMaterialResources(material, L"..\\Content\\Textures\\", device, false);
     meshMaterials.push_back(material);
+    LoadMaterialResources(meshMaterials.size() - 1, device, false);
 
     meshes.resize(1);
     meshes[0].InitPlane(device, dimensions, position, orientation, 0);
@@ -1015,39 +1732,198 @@ void Model::GenerateCorneaScene(ID3D11Device* device)
     material.DiffuseMapName = L"Eyeball.png";
     material.NormalMapName = L"";
     fileDirectory = L"..\\Content\\Textures\\";
-    LoadMaterialResources(material, L"..\\Content\\Textures\\", device, false);
     meshMaterials.push_back(material);
+    LoadMaterialResources(meshMaterials.size() - 1, device, false);
 
     meshes.resize(1);
     meshes[0].InitCornea(device, 0);
 }
 
-void Model::LoadMaterialResources(MeshMaterial& material, const wstring& directory, ID3D11Device* device, bool forceSRGB)
+Model::~Model()
 {
-    // Load the diffuse map
-    wstring diffuseMapPath = directory + material.DiffuseMapName;
-    if(material.DiffuseMapName.length() > 1 && FileExists(diffuseMapPath.c_str()))
-        material.DiffuseMap = LoadTexture(device, diffuseMapPath.c_str(), forceSRGB);
-    else
+    for(uint64 i = 0; i < textureRefs.size(); ++i)
+        ReleaseSharedTexture(textureRefs[i].Path.c_str(), textureRefs[i].ForceSRGB);
+    textureRefs.clear();
+}
+
+// Creates the GPU resources for a model that was loaded without a device
+void Model::CreateDeviceResources(ID3D11Device* device)
+{
+    for(uint64 i = 0; i < meshes.size(); ++i)
+        if(meshes[i].vertexBuffer == nullptr)
+            meshes[i].CreateVertexAndIndexBuffers(device);
+
+    for(uint64 i = 0; i < pendingTextures.size(); ++i)
     {
-        static ID3D11ShaderResourceViewPtr defaultDiffuse;
-        if(defaultDiffuse == nullptr)
-            defaultDiffuse = LoadTexture(device, L"..\\Content\\Textures\\Default.dds");
-        material.DiffuseMap = defaultDiffuse;
+        PendingTexture& pending = pendingTextures[i];
+        ID3D11ShaderResourceViewPtr srv;
+        if(pending.UseDefault)
+            srv = pending.NormalMap ? DefaultNormalMap(device) : DefaultDiffuseMap(device);
+        else
+            srv = AcquireMaterialTexture(device, pending.Path, pending.ForceSRGB, &pending.Image);
+
+        MeshMaterial& material = meshMaterials[pending.MaterialIdx];
+        if(pending.NormalMap)
+            material.NormalMap = srv;
+        else
+            material.DiffuseMap = srv;
     }
 
-    // Load the normal map
-    wstring normalMapPath = directory + material.NormalMapName;
+    pendingTextures.clear();
+}
 
-    if(material.NormalMapName.length() > 1 && FileExists(normalMapPath.c_str()))
-        material.NormalMap = LoadTexture(device, normalMapPath.c_str());
-    else
+void Model::VertexCacheStatistics(VertexCacheStats& before, VertexCacheStats& after) const
+{
+    // Sum up the transformed vertices, triangles, and unique vertices so that the ratios are
+    // weighted by the size of each mesh
+    double missesBefore = 0.0;
+    double missesAfter = 0.0;
+    double numTris = 0.0;
+    double numUnique = 0.0;
+    for(uint64 i = 0; i < meshes.size(); ++i)
+    {
+        const Mesh& mesh = meshes[i];
+        if(mesh.optimized == false || mesh.cacheStatsAfter.ATVR <= 0.0f)
+            continue;
+
+        const double meshTris = mesh.numIndices / 3;
+        const double meshMissesAfter = mesh.cacheStatsAfter.ACMR * meshTris;
+        missesBefore += mesh.cacheStatsBefore.ACMR * meshTris;
+        missesAfter += meshMissesAfter;
+        numTris += meshTris;
+        numUnique += meshMissesAfter / mesh.cacheStatsAfter.ATVR;
+    }
+
+    before = VertexCacheStats();
+    after = VertexCacheStats();
+    if(numTris > 0.0)
+    {
+        before.ACMR = float(missesBefore / numTris);
+        before.ATVR = float(missesBefore / numUnique);
+        after.ACMR = float(missesAfter / numTris);
+        after.ATVR = float(missesAfter / numUnique);
+    }
+}
+
+void Model::SetVertexCompression(ID3D11Device* device, bool compress)
+{
+    for(uint64 i = 0; i < meshes.size(); ++i)
     {
-        static ID3D11ShaderResourceViewPtr defaultNormalMap;
-        if(defaultNormalMap == nullptr)
-            defaultNormalMap = LoadTexture(device, L"..\\Content\\Textures\\DefaultNormalMap.dds");
-        material.NormalMap = defaultNormalMap;
+        Mesh& mesh = meshes[i];
+        if(mesh.compressVertices == compress)
+            continue;
+
+        mesh.compressVertices = compress;
+        if(mesh.vertexBuffer != nullptr)
+            mesh.CreateVertexBuffer(device);
     }
 }
 
+uint64 Model::MemorySize() const
+{
+    uint64 size = 0;
+    for(uint64 i = 0; i < meshes.size(); ++i)
+    {
+        const Mesh& mesh = meshes[i];
+        size += uint64(mesh.NumVertices()) * mesh.VertexBufferStride();
+        size += uint64(mesh.NumIndices()) * mesh.IndexSize();
+    }
+
+    // Textures shared with other models are counted by each of them
+    for(uint64 i = 0; i < meshMaterials.size(); ++i)
+    {
+        const MeshMaterial& material = meshMaterials[i];
+        if(material.DiffuseMap != nullptr)
+            size += TextureMemorySize(material.DiffuseMap);
+        if(material.NormalMap != nullptr)
+            size += TextureMemorySize(material.NormalMap);
+    }
+
+    return size;
+}
+
+ID3D11ShaderResourceViewPtr Model::AcquireMaterialTexture(ID3D11Device* device, const wstring& path,
+                                                          bool forceSRGB, const DirectX::ScratchImage* image)
+{
+    ID3D11ShaderResourceViewPtr srv = AcquireSharedTexture(device, path.c_str(), forceSRGB, image);
+
+    TextureRef ref;
+    ref.Path = path;
+    ref.ForceSRGB = forceSRGB;
+    textureRefs.push_back(ref);
+
+    return srv;
+}
+
+ID3D11ShaderResourceViewPtr Model::DefaultDiffuseMap(ID3D11Device* device)
+{
+    static ID3D11ShaderResourceViewPtr defaultDiffuse;
+    if(defaultDiffuse == nullptr)
+        defaultDiffuse = LoadTexture(device, L"..\\Content\\Textures\\Default.dds");
+    return defaultDiffuse;
+}
+
+ID3D11ShaderResourceViewPtr Model::DefaultNormalMap(ID3D11Device* device)
+{
+    static ID3D11ShaderResourceViewPtr defaultNormalMap;
+    if(defaultNormalMap == nullptr)
+        defaultNormalMap = LoadTexture(device, L"..\\Content\\Textures\\DefaultNormalMap.dds");
+    return defaultNormalMap;
+}
+
+// Loads the textures for a material. Without a device the textures are only decoded, and the
+// SRV's are created later by CreateDeviceResources.
+void Model::LoadMaterialResources(uint64 materialIdx, ID3D11Device* device, bool forceSRGB)
+{
+    MeshMaterial& material = meshMaterials[materialIdx];
+    const wstring diffuseMapPath = fileDirectory + material.DiffuseMapName;
+    const wstring normalMapPath = fileDirectory + material.NormalMapName;
+    const bool hasDiffuseMap = material.DiffuseMapName.length() > 1 && FileExists(diffuseMapPath.c_str());
+    const bool hasNormalMap = material.NormalMapName.length() > 1 && FileExists(normalMapPath.c_str());
+
+    if(device != nullptr)
+    {
+        material.DiffuseMap = hasDiffuseMap ? AcquireMaterialTexture(device, diffuseMapPath, forceSRGB, nullptr)
+                                            : DefaultDiffuseMap(device);
+        material.NormalMap = hasNormalMap ? AcquireMaterialTexture(device, normalMapPath, false, nullptr)
+                                          : DefaultNormalMap(device);
+        return;
+    }
+
+    // Textures that another model already loaded don't need to be decoded again. Both files are
+    // read from tasks so that the reads are in flight at the same time.
+    const bool decodeDiffuseMap = hasDiffuseMap && SharedTextureResident(diffuseMapPath.c_str(), forceSRGB) == false;
+    const bool decodeNormalMap = hasNormalMap && SharedTextureResident(normalMapPath.c_str(), false) == false;
+
+    std::vector<uint8> diffuseMapData;
+    std::vector<uint8> normalMapData;
+    TaskHandle reads[2];
+    uint64 numReads = 0;
+    if(decodeDiffuseMap)
+        reads[numReads++] = ReadFileAsync(diffuseMapPath.c_str(), diffuseMapData);
+    if(decodeNormalMap)
+        reads[numReads++] = ReadFileAsync(normalMapPath.c_str(), normalMapData);
+    WaitForTasks(reads, numReads);
+
+    PendingTexture diffuseMap;
+    diffuseMap.MaterialIdx = materialIdx;
+    diffuseMap.NormalMap = false;
+    diffuseMap.UseDefault = hasDiffuseMap == false;
+    diffuseMap.ForceSRGB = forceSRGB;
+    diffuseMap.Path = diffuseMapPath;
+    if(decodeDiffuseMap)
+        DecodeTexture(diffuseMapPath.c_str(), diffuseMapData, diffuseMap.Image);
+    pendingTextures.push_back(std::move(diffuseMap));
+
+    PendingTexture normalMap;
+    normalMap.MaterialIdx = materialIdx;
+    normalMap.NormalMap = true;
+    normalMap.UseDefault = hasNormalMap == false;
+    normalMap.ForceSRGB = false;
+    normalMap.Path = normalMapPath;
+    if(decodeNormalMap)
+        DecodeTexture(normalMapPath.c_str(), normalMapData, normalMap.Image);
+    pendingTextures.push_back(std::move(normalMap));
+}
+
 }
\ No newline at end of file
@@ -14,6 +14,11 @@
 #include "..\\InterfacePointers.h"
 #include "..\\SF11_Math.h"
 #include "..\\Serialization.h"
+#include "MeshOptimization.h"
+#include "VertexCompression.h"
+#include "Meshlets.h"
+#include "MeshSimplification.h"
+#include "BVH.h"
 
 struct aiMesh;
 
@@ -61,6 +66,25 @@ struct MeshPart
     }
 };
 
+// Bounds of the vertices referenced by a mesh part. The sphere is centered on the AABB.
+struct MeshPartBounds
+{
+    Float3 Min;
+    Float3 Max;
+    Float3 SphereCenter;
+    float SphereRadius = 0.0f;
+};
+
+// A simplified version of a mesh part. The indices are stored after the full-detail indices of
+// all parts, and reference the same vertices.
+struct MeshLOD
+{
+    uint32 PartIdx = 0;
+    uint32 IndexStart = 0;
+    uint32 IndexCount = 0;
+    float Error = 0.0f;         // Object-space deviation from the full-detail part
+};
+
 enum class IndexType
 {
     Index16Bit = 0,
@@ -96,9 +120,21 @@ public:
     std::vector<MeshPart>& MeshParts() { return meshParts; }
     const std::vector<MeshPart>& MeshParts() const { return meshParts; }
 
-    const D3D11_INPUT_ELEMENT_DESC* InputElements() const { return &inputElements[0]; }
-    uint32 NumInputElements() const { return static_cast<uint32>(inputElements.size()); }
+    // Bounds for each part, which is empty if the mesh has no positions
+    const std::vector<MeshPartBounds>& PartBounds() const { return partBounds; }
+
+    // The layout of the vertex buffer, which is the compressed layout if the vertex buffer was
+    // created with compression enabled
+    const D3D11_INPUT_ELEMENT_DESC* InputElements() const { return vbCompressed ? CompressedVertexElements : &inputElements[0]; }
+    uint32 NumInputElements() const { return vbCompressed ? NumCompressedVertexElements : static_cast<uint32>(inputElements.size()); }
+    uint32 VertexBufferStride() const { return vbCompressed ? sizeof(CompressedVertex) : vertexStride; }
+
+    // Compressed positions are decoded as position * PositionScale + PositionOffset
+    bool CompressedVertices() const { return vbCompressed; }
+    Float3 PositionScale() const { return positionMax - positionMin; }
+    Float3 PositionOffset() const { return positionMin; }
 
+    // The stride of the full-precision CPU-side vertex data
     uint32 VertexStride() const { return vertexStride; }
     uint32 NumVertices() const { return numVertices; }
     uint32 NumIndices() const { return numIndices; }
@@ -107,10 +143,38 @@ public:
     DXGI_FORMAT IndexBufferFormat() const { return indexType == IndexType::Index32Bit ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT; }
     uint32 IndexSize() const { return indexType == IndexType::Index32Bit ? 4 : 2; }
 
-    const uint8* Vertices() const { return vertices.data(); }
-    const uint8* Indices() const { return indices.data(); }
+    const uint8* Vertices() const { return vertices.Data(); }
+    const uint8* Indices() const { return indices.Data(); }
+
+    // Post-transform cache statistics from before and after the index and vertex data was
+    // reordered, which are only valid if the mesh has been optimized
+    bool Optimized() const { return optimized; }
+    const VertexCacheStats& CacheStatsBefore() const { return cacheStatsBefore; }
+    const VertexCacheStats& CacheStatsAfter() const { return cacheStatsAfter; }
+
+    // Clusters of triangles from each part, sorted by part. Empty if the mesh has no positions.
+    const std::vector<Meshlet>& Meshlets() const { return meshlets; }
+
+    // Simplified versions of each part, sorted by part and then from most to least detailed
+    const std::vector<MeshLOD>& LODs() const { return lods; }
+
+    // Hierarchy over the full-detail triangles of all parts, where the triangle IDs index into
+    // the index buffer. Empty if the mesh has no positions. It's built on the first call unless
+    // it was loaded from a .meshdata file, so the first call on a mesh isn't thread-safe.
+    const BVH& TriangleBVH();
+
+    // Transforms the BVH's triangles by the world matrix, building it first if needed
+    void RefitBVH(const Float4x4& transform);
 
     template<typename TSerializer> void Serialize(TSerializer& serializer)
+    {
+        SerializeMetadata(serializer);
+        SerializeRawView(serializer, vertices);
+        SerializeRawView(serializer, indices);
+    }
+
+    // Everything except for the vertex and index data
+    template<typename TSerializer> void SerializeMetadata(TSerializer& serializer)
     {
         SerializeRawVector(serializer, meshParts);
 
@@ -130,8 +194,6 @@ public:
         uint32 idxType = uint32(indexType);
         SerializeItem(serializer, idxType);
         indexType = IndexType(idxType);
-        SerializeRawVector(serializer, vertices);
-        SerializeRawVector(serializer, indices);
     }
 
 protected:
@@ -139,11 +201,18 @@ protected:
     void GenerateTangentFrame();
     void CreateInputElements(const D3DVERTEXELEMENT9* declaration);
     void CreateVertexAndIndexBuffers(ID3D11Device* device);
+    void CreateVertexBuffer(ID3D11Device* device);
+    void Optimize();
+    void BuildMeshlets();
+    void ComputePartBounds();
+    void GenerateLODs();
+    void BuildBVH();
 
     ID3D11BufferPtr vertexBuffer;
     ID3D11BufferPtr indexBuffer;
 
     std::vector<MeshPart> meshParts;
+    std::vector<MeshPartBounds> partBounds;
     std::vector<D3D11_INPUT_ELEMENT_DESC> inputElements;
     std::vector<std::string> inputElementStrings;
 
@@ -153,15 +222,32 @@ protected:
 
     IndexType indexType = IndexType::Index16Bit;
 
-    std::vector<uint8> vertices;
-    std::vector<uint8> indices;
+    RawView<uint8> vertices;
+    RawView<uint8> indices;
+
+    bool optimized = false;
+    VertexCacheStats cacheStatsBefore;
+    VertexCacheStats cacheStatsAfter;
+
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshLOD> lods;
+    BVH bvh;
+    bool bvhBuilt = false;
+
+    bool compressVertices = false;
+    bool vbCompressed = false;
+    Float3 positionMin;
+    Float3 positionMax;
 };
 
 class Model
 {
 public:
 
-    // Loading from file formats
+    ~Model();
+
+    // Loading from file formats. If the device is null only the CPU-side data is loaded, which can
+    // be done from any thread, and CreateDeviceResources must be called before rendering.
     void CreateFromSDKMeshFile(ID3D11Device* device, const wchar* fileName,
                                 const wchar* normalMapSuffix = NULL,
                                 bool generateTangentFrame = false,
@@ -172,6 +258,11 @@ public:
 
     void CreateFromMeshData(ID3D11Device* device, const wchar* fileName, bool forceSRGB = false);
 
+    // Writes a .meshdata file using the chunked container, optionally compressing the vertex and
+    // index data
+    void SaveToMeshData(const wchar* fileName, bool compress = false);
+    static const uint32 MeshDataVersion = 1;
+
     // Procedural generation
     void GenerateBoxScene(ID3D11Device* device,
                           const Float3& dimensions = Float3(1.0f, 1.0f, 1.0f),
@@ -188,6 +279,18 @@ public:
                             const wchar* normalMap = L"");
     void GenerateCorneaScene(ID3D11Device* device);
 
+    void CreateDeviceResources(ID3D11Device* device);
+
+    // Enables the compressed vertex layout for the meshes that support it. Vertex buffers that
+    // were already created are re-created with the new layout.
+    void SetVertexCompression(ID3D11Device* device, bool compress);
+
+    // Post-transform cache statistics for all meshes, from before and after they were optimized
+    void VertexCacheStatistics(VertexCacheStats& before, VertexCacheStats& after) const;
+
+    // Approximate amount of GPU memory used by the vertex/index buffers and textures
+    uint64 MemorySize() const;
+
     // Accessors
     std::vector<MeshMaterial>& Materials() { return meshMaterials; };
     const std::vector<MeshMaterial>& Materials() const { return meshMaterials; };
@@ -205,21 +308,50 @@ public:
 
         if(TSerializer::IsReadSerializer())
         {
-            for(uint64 i = 0; i  < meshes.size(); ++i)
-                meshes[i].CreateVertexAndIndexBuffers(device);
+            if(device != nullptr)
+                for(uint64 i = 0; i  < meshes.size(); ++i)
+                    meshes[i].CreateVertexAndIndexBuffers(device);
 
             for(uint64 i = 0; i < meshMaterials.size(); ++i)
-                LoadMaterialResources(meshMaterials[i], fileDirectory, device, forceSRGB);
+                LoadMaterialResources(i, device, forceSRGB);
         }
     }
 
 protected:
 
-    static void LoadMaterialResources(MeshMaterial& material, const std::wstring& directory, ID3D11Device* device, bool forceSRGB);
+    void LoadMaterialResources(uint64 materialIdx, ID3D11Device* device, bool forceSRGB);
+    bool LoadFromCache(ID3D11Device* device, const wchar* cachePath, bool forceSRGB);
+
+    static ID3D11ShaderResourceViewPtr DefaultDiffuseMap(ID3D11Device* device);
+    static ID3D11ShaderResourceViewPtr DefaultNormalMap(ID3D11Device* device);
+
+    ID3D11ShaderResourceViewPtr AcquireMaterialTexture(ID3D11Device* device, const std::wstring& path,
+                                                       bool forceSRGB, const DirectX::ScratchImage* image);
+
+    // A texture that's waiting for CreateDeviceResources. The image is empty if the texture was
+    // already resident when the model was loaded.
+    struct PendingTexture
+    {
+        uint64 MaterialIdx = 0;
+        bool NormalMap = false;
+        bool UseDefault = false;
+        bool ForceSRGB = false;
+        std::wstring Path;
+        DirectX::ScratchImage Image;
+    };
+
+    // A reference on a shared texture, which is released when the model is destroyed
+    struct TextureRef
+    {
+        std::wstring Path;
+        bool ForceSRGB = false;
+    };
 
     std::vector<Mesh> meshes;
     std::vector<MeshMaterial> meshMaterials;
     std::wstring fileDirectory;
+    std::vector<PendingTexture> pendingTextures;
+    std::vector<TextureRef> textureRefs;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,180 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "ModelCache.h"
+
+#include "..\\Exceptions.h"
+#include "..\\Utility.h"
+#include "..\\FileIO.h"
+#include "..\\Serialization.h"
+#include "..\\TaskScheduler.h"
+
+using std::wstring;
+using std::string;
+
+namespace SampleFramework11
+{
+
+// Bump this whenever the import code changes in a way that affects the imported data
+static const uint32 ModelCacheVersion = 6;
+
+static const wstring modelCacheDir = L"ModelCache";
+static const wstring indexPath = CombinePaths(modelCacheDir.c_str(), L"SourceIndex.cache");
+
+struct SourceIndexEntry
+{
+    wstring Path;
+    uint64 Timestamp = 0;
+    uint64 HashA = 0;
+    uint64 HashB = 0;
+
+    template<typename TSerializer> void Serialize(TSerializer& serializer)
+    {
+        SerializeItem(serializer, Path);
+        SerializeItem(serializer, Timestamp);
+        SerializeItem(serializer, HashA);
+        SerializeItem(serializer, HashB);
+    }
+};
+
+static std::map<wstring, SourceIndexEntry> sourceIndex;
+static bool sourceIndexLoaded = false;
+static std::mutex cacheMutex;
+
+// Most recent write of the index, which the next write waits on so that they land in order
+static TaskHandle pendingIndexWrite;
+
+static void CreateCacheDirectory()
+{
+    EnsureDirectoryExists(modelCacheDir.c_str());
+}
+
+static void LoadSourceIndex()
+{
+    if(sourceIndexLoaded)
+        return;
+    sourceIndexLoaded = true;
+
+    if(FileExists(indexPath.c_str()) == false)
+        return;
+
+    // A bad index just means that the source files get hashed again
+    try
+    {
+        std::vector<SourceIndexEntry> entries;
+        SerializeFromFile(indexPath.c_str(), entries);
+        for(uint64 i = 0; i < entries.size(); ++i)
+            sourceIndex[entries[i].Path] = entries[i];
+    }
+    catch(Exception&)
+    {
+        sourceIndex.clear();
+    }
+}
+
+static void SaveSourceIndex()
+{
+    std::vector<SourceIndexEntry> entries;
+    for(auto iter = sourceIndex.begin(); iter != sourceIndex.end(); ++iter)
+        entries.push_back(iter->second);
+
+    // The write happens on a task so that loading doesn't stall on it
+    CreateCacheDirectory();
+    const uint64 numDependencies = pendingIndexWrite != nullptr ? 1 : 0;
+    pendingIndexWrite = SerializeToFileAsync(indexPath.c_str(), entries, false, &pendingIndexWrite, numDependencies);
+}
+
+static Hash HashFileContents(const wchar* filePath)
+{
+    MappedFile file(filePath);
+
+    // GenerateHash takes an int for the length, so large files are hashed in pieces. Each piece
+    // is seeded with the hash of the previous one, so that the order of the pieces matters.
+    const uint64 pieceSize = 1024 * 1024 * 1024;
+    Hash hash;
+    for(uint64 offset = 0; offset < file.Size(); offset += pieceSize)
+    {
+        const uint64 size = std::min(pieceSize, file.Size() - offset);
+        hash = GenerateHash(file.Data() + offset, int(size), uint32(hash.A));
+    }
+
+    return hash;
+}
+
+// Returns the hash of a file's contents, re-using the hash from the index if the file hasn't
+// been modified since it was last hashed
+static Hash SourceFileHash(const wchar* sourcePath)
+{
+    const uint64 timestamp = GetFileTimestamp(sourcePath);
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        LoadSourceIndex();
+        auto iter = sourceIndex.find(sourcePath);
+        if(iter != sourceIndex.end() && iter->second.Timestamp == timestamp)
+            return Hash(iter->second.HashA, iter->second.HashB);
+    }
+
+    const Hash hash = HashFileContents(sourcePath);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    SourceIndexEntry& entry = sourceIndex[sourcePath];
+    entry.Path = sourcePath;
+    entry.Timestamp = timestamp;
+    entry.HashA = hash.A;
+    entry.HashB = hash.B;
+    SaveSourceIndex();
+
+    return hash;
+}
+
+wstring ModelCachePath(const wchar* sourcePath, const string& importOptions)
+{
+    const Hash sourceHash = SourceFileHash(sourcePath);
+
+    string keyString = ToAnsiString(sourceHash.A) + "_" + ToAnsiString(sourceHash.B);
+    keyString += "\n";
+    keyString += ToAnsiString(ModelCacheVersion);
+    keyString += "\n";
+    keyString += importOptions;
+
+    const Hash key = GenerateHash(keyString.data(), int(keyString.length()), 0);
+    return CombinePaths(modelCacheDir.c_str(), (key.ToString() + L".meshdata").c_str());
+}
+
+void PrepareModelCache()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    CreateCacheDirectory();
+}
+
+void FlushModelCache()
+{
+    TaskHandle indexWrite;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        indexWrite.swap(pendingIndexWrite);
+    }
+
+    if(indexWrite == nullptr)
+        return;
+
+    // A failed write just means that the source files get hashed again on the next run
+    try
+    {
+        WaitForTask(indexWrite);
+    }
+    catch(Exception&)
+    {
+    }
+}
+
+}
@@ -0,0 +1,35 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+#include "..\\MurmurHash.h"
+
+namespace SampleFramework11
+{
+
+// Cache for models that were imported from SDKMesh or Assimp files, or optimized from older
+// unoptimized .meshdata files. Cached models are stored as .meshdata files, named using a hash of
+// the source file's contents plus the import options. The content hashes are kept in a persistent
+// index that's keyed by the source file's timestamp, so unchanged files don't need to be hashed
+// again on later runs.
+
+// Returns the path of the cached .meshdata for a source file + import options. The file at the
+// returned path only exists if the model has been cached previously.
+std::wstring ModelCachePath(const wchar* sourcePath, const std::string& importOptions);
+
+// Creates the cache directory if needed. Call before writing to a path from ModelCachePath.
+void PrepareModelCache();
+
+// Waits for pending writes to the index to finish. Call before shutting down the task scheduler.
+void FlushModelCache();
+
+}
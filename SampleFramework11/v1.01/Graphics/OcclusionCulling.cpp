@@ -0,0 +1,347 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "OcclusionCulling.h"
+
+#include "..\\TaskScheduler.h"
+
+namespace SampleFramework11
+{
+
+// Number of triangles that are set up and binned by each task
+static const uint64 TriangleBatchSize = 1024;
+
+static const float MinTriangleArea = 1e-8f;
+
+static uint32 GetOccluderIndex(const Occluder& occluder, uint64 idx)
+{
+    if(occluder.IndexSize == 2)
+        return reinterpret_cast<const uint16*>(occluder.Indices)[idx];
+    else
+        return reinterpret_cast<const uint32*>(occluder.Indices)[idx];
+}
+
+// Projects the triangle to the buffer and computes its edge functions and depth plane. Returns
+// false if the triangle is culled, or if it can't be rasterized without clipping.
+static bool SetupTriangle(const XMVECTOR* clipPositions, bool cullBackFaces, bool depthClamp,
+                          float width, float height, OcclusionBuffer::TriangleSetup& setup)
+{
+    float x[3];
+    float y[3];
+    float z[3];
+    for(uint32 i = 0; i < 3; ++i)
+    {
+        const float w = XMVectorGetW(clipPositions[i]);
+        if(w <= 1e-6f)
+            return false;
+
+        const XMVECTOR ndc = XMVectorDivide(clipPositions[i], XMVectorReplicate(w));
+        z[i] = XMVectorGetZ(ndc);
+        if(z[i] < 0.0f)
+        {
+            if(depthClamp == false)
+                return false;
+
+            // Interpolating the clamped depths gives depths at or behind the clamped depths of
+            // the triangle, so the occluder stays conservative
+            z[i] = 0.0f;
+        }
+
+        x[i] = (XMVectorGetX(ndc) * 0.5f + 0.5f) * width;
+        y[i] = (XMVectorGetY(ndc) * -0.5f + 0.5f) * height;
+    }
+
+    // Front faces are clockwise in screen space, which gives them a positive area
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if(area <= 0.0f)
+    {
+        if(cullBackFaces)
+            return false;
+
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    if(area < MinTriangleArea)
+        return false;
+
+    setup.MinX = std::max(int32(std::floor(std::min(std::min(x[0], x[1]), x[2]))), 0);
+    setup.MinY = std::max(int32(std::floor(std::min(std::min(y[0], y[1]), y[2]))), 0);
+    setup.MaxX = std::min(int32(std::ceil(std::max(std::max(x[0], x[1]), x[2]))), int32(width)) - 1;
+    setup.MaxY = std::min(int32(std::ceil(std::max(std::max(y[0], y[1]), y[2]))), int32(height)) - 1;
+    if(setup.MinX > setup.MaxX || setup.MinY > setup.MaxY)
+        return false;
+
+    // Edge i goes from vertex i to vertex i + 1, and is positive on the side of the remaining
+    // vertex. Its value at the remaining vertex is the area, so it's also the barycentric
+    // weight of that vertex scaled by the area.
+    float edgeA[3];
+    float edgeB[3];
+    float edgeC[3];
+    for(uint32 i = 0; i < 3; ++i)
+    {
+        const uint32 j = (i + 1) % 3;
+        edgeA[i] = y[i] - y[j];
+        edgeB[i] = x[j] - x[i];
+        edgeC[i] = -(edgeA[i] * x[i] + edgeB[i] * y[i]);
+    }
+
+    const float invArea = 1.0f / area;
+    setup.DepthA = (edgeA[1] * z[0] + edgeA[2] * z[1] + edgeA[0] * z[2]) * invArea;
+    setup.DepthB = (edgeB[1] * z[0] + edgeB[2] * z[1] + edgeB[0] * z[2]) * invArea;
+    setup.DepthC = (edgeC[1] * z[0] + edgeC[2] * z[1] + edgeC[0] * z[2]) * invArea;
+
+    // Offset the depth plane from the pixel center to the farthest corner of the pixel
+    setup.DepthC += (std::abs(setup.DepthA) + std::abs(setup.DepthB)) * 0.5f;
+    for(uint32 i = 0; i < 3; ++i)
+    {
+        setup.EdgeA[i] = edgeA[i];
+        setup.EdgeB[i] = edgeB[i];
+        setup.EdgeC[i] = edgeC[i];
+    }
+
+    return true;
+}
+
+void OcclusionBuffer::Rasterize(const Float4x4& worldViewProjection, const Occluder* occluders, uint64 numOccluders,
+                                bool cullBackFaces, bool depthClamp)
+{
+    this->worldViewProjection = worldViewProjection;
+    this->depthClamp = depthClamp;
+    rasterized = true;
+
+    depths.assign(Width * Height, 1.0f);
+    blockDepths.assign(NumBlocksX * NumBlocksY, 1.0f);
+
+    std::vector<uint64> triangleStarts(numOccluders + 1, 0);
+    for(uint64 i = 0; i < numOccluders; ++i)
+        triangleStarts[i + 1] = triangleStarts[i] + occluders[i].IndexCount / 3;
+
+    const uint64 numTriangles = triangleStarts[numOccluders];
+    if(numTriangles == 0)
+        return;
+
+    const uint64 numBatches = (numTriangles + TriangleBatchSize - 1) / TriangleBatchSize;
+    triangles.resize(numTriangles);
+    tileBins.resize(numBatches * NumTiles);
+    for(uint64 i = 0; i < tileBins.size(); ++i)
+        tileBins[i].clear();
+
+    // Set up the triangles and bin them by the tiles that their bounds overlap. Each batch has
+    // its own bins, so that the tiles see the triangles in their original order.
+    const XMMATRIX transform = worldViewProjection.ToSIMD();
+    ParallelFor(numBatches, 1, [&](uint64 start, uint64 end)
+    {
+        for(uint64 batchIdx = start; batchIdx < end; ++batchIdx)
+        {
+            const uint64 batchStart = batchIdx * TriangleBatchSize;
+            const uint64 batchEnd = std::min(batchStart + TriangleBatchSize, numTriangles);
+            uint64 occluderIdx = std::upper_bound(triangleStarts.begin(), triangleStarts.end(), batchStart) - triangleStarts.begin() - 1;
+
+            for(uint64 triIdx = batchStart; triIdx < batchEnd; ++triIdx)
+            {
+                while(triIdx >= triangleStarts[occluderIdx + 1])
+                    ++occluderIdx;
+
+                const Occluder& occluder = occluders[occluderIdx];
+                const uint64 firstIndex = occluder.IndexStart + (triIdx - triangleStarts[occluderIdx]) * 3;
+
+                XMVECTOR clipPositions[3];
+                for(uint64 i = 0; i < 3; ++i)
+                {
+                    const uint64 vertexIdx = GetOccluderIndex(occluder, firstIndex + i);
+                    const uint8* position = occluder.Positions + vertexIdx * occluder.PositionStride;
+                    const XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(position));
+                    clipPositions[i] = XMVector3Transform(p, transform);
+                }
+
+                TriangleSetup& setup = triangles[triIdx];
+                if(SetupTriangle(clipPositions, cullBackFaces, depthClamp, float(Width), float(Height), setup) == false)
+                    continue;
+
+                for(int32 tileY = setup.MinY / int32(TileHeight); tileY <= setup.MaxY / int32(TileHeight); ++tileY)
+                    for(int32 tileX = setup.MinX / int32(TileWidth); tileX <= setup.MaxX / int32(TileWidth); ++tileX)
+                        tileBins[batchIdx * NumTiles + tileY * NumTilesX + tileX].push_back(uint32(triIdx));
+            }
+        }
+    });
+
+    // Tiles don't overlap, so they can be rasterized without any synchronization
+    ParallelFor(NumTiles, 1, [&](uint64 start, uint64 end)
+    {
+        for(uint64 tileIdx = start; tileIdx < end; ++tileIdx)
+            RasterizeTile(uint32(tileIdx), numBatches);
+    });
+}
+
+// Rasterizes the triangles binned to a tile 4 pixels at a time, and then updates the farthest
+// depth of the tile's blocks
+void OcclusionBuffer::RasterizeTile(uint32 tileIdx, uint64 numBatches)
+{
+    const int32 tileMinX = int32((tileIdx % NumTilesX) * TileWidth);
+    const int32 tileMinY = int32((tileIdx / NumTilesX) * TileHeight);
+    const int32 tileMaxX = tileMinX + TileWidth - 1;
+    const int32 tileMaxY = tileMinY + TileHeight - 1;
+
+    const XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+
+    for(uint64 batchIdx = 0; batchIdx < numBatches; ++batchIdx)
+    {
+        const std::vector<uint32>& bin = tileBins[batchIdx * NumTiles + tileIdx];
+        for(uint64 binIdx = 0; binIdx < bin.size(); ++binIdx)
+        {
+            const TriangleSetup& setup = triangles[bin[binIdx]];
+
+            // The tiles are a multiple of 4 pixels wide, so aligning to 4 stays inside the tile
+            const int32 minX = std::max(setup.MinX, tileMinX) & ~3;
+            const int32 maxX = std::min(setup.MaxX, tileMaxX);
+            const int32 minY = std::max(setup.MinY, tileMinY);
+            const int32 maxY = std::min(setup.MaxY, tileMaxY);
+
+            const XMVECTOR edgeA0 = XMVectorReplicate(setup.EdgeA[0]);
+            const XMVECTOR edgeA1 = XMVectorReplicate(setup.EdgeA[1]);
+            const XMVECTOR edgeA2 = XMVectorReplicate(setup.EdgeA[2]);
+            const XMVECTOR depthA = XMVectorReplicate(setup.DepthA);
+
+            for(int32 y = minY; y <= maxY; ++y)
+            {
+                const float pixelY = y + 0.5f;
+                const XMVECTOR edgeRow0 = XMVectorReplicate(setup.EdgeB[0] * pixelY + setup.EdgeC[0]);
+                const XMVECTOR edgeRow1 = XMVectorReplicate(setup.EdgeB[1] * pixelY + setup.EdgeC[1]);
+                const XMVECTOR edgeRow2 = XMVectorReplicate(setup.EdgeB[2] * pixelY + setup.EdgeC[2]);
+                const XMVECTOR depthRow = XMVectorReplicate(setup.DepthB * pixelY + setup.DepthC);
+                float* row = &depths[y * Width];
+
+                for(int32 x = minX; x <= maxX; x += 4)
+                {
+                    const XMVECTOR pixelX = XMVectorAdd(XMVectorReplicate(float(x)), laneOffsets);
+                    const XMVECTOR edge0 = XMVectorMultiplyAdd(edgeA0, pixelX, edgeRow0);
+                    const XMVECTOR edge1 = XMVectorMultiplyAdd(edgeA1, pixelX, edgeRow1);
+                    const XMVECTOR edge2 = XMVectorMultiplyAdd(edgeA2, pixelX, edgeRow2);
+
+                    const XMVECTOR minEdge = XMVectorMin(XMVectorMin(edge0, edge1), edge2);
+                    const XMVECTOR covered = XMVectorGreaterOrEqual(minEdge, XMVectorZero());
+                    if(XMVector4EqualInt(covered, XMVectorFalseInt()))
+                        continue;
+
+                    const XMVECTOR depth = XMVectorMultiplyAdd(depthA, pixelX, depthRow);
+                    const XMVECTOR oldDepth = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x));
+                    const XMVECTOR newDepth = XMVectorSelect(oldDepth, XMVectorMin(oldDepth, depth), covered);
+                    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(row + x), newDepth);
+                }
+            }
+        }
+    }
+
+    for(int32 blockY = tileMinY / BlockSize; blockY <= tileMaxY / int32(BlockSize); ++blockY)
+    {
+        for(int32 blockX = tileMinX / BlockSize; blockX <= tileMaxX / int32(BlockSize); ++blockX)
+        {
+            XMVECTOR maxDepth = XMVectorZero();
+            for(uint32 y = 0; y < BlockSize; ++y)
+            {
+                const float* row = &depths[(blockY * BlockSize + y) * Width + blockX * BlockSize];
+                for(uint32 x = 0; x < BlockSize; x += 4)
+                    maxDepth = XMVectorMax(maxDepth, XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x)));
+            }
+
+            maxDepth = XMVectorMax(maxDepth, XMVectorSwizzle<2, 3, 0, 1>(maxDepth));
+            maxDepth = XMVectorMax(maxDepth, XMVectorSwizzle<1, 0, 3, 2>(maxDepth));
+            blockDepths[blockY * NumBlocksX + blockX] = XMVectorGetX(maxDepth);
+        }
+    }
+}
+
+bool OcclusionBuffer::BoundsVisible(const Float3& minBounds, const Float3& maxBounds) const
+{
+    if(rasterized == false)
+        return true;
+
+    // Find the screen rectangle and the nearest depth of the AABB from its corners
+    const XMMATRIX transform = worldViewProjection.ToSIMD();
+    XMVECTOR screenMin = XMVectorReplicate(FLT_MAX);
+    XMVECTOR screenMax = XMVectorReplicate(-FLT_MAX);
+    for(uint32 i = 0; i < 8; ++i)
+    {
+        const XMVECTOR corner = XMVectorSet((i & 1) ? maxBounds.x : minBounds.x,
+                                            (i & 2) ? maxBounds.y : minBounds.y,
+                                            (i & 4) ? maxBounds.z : minBounds.z, 1.0f);
+        const XMVECTOR clipPosition = XMVector4Transform(corner, transform);
+        const float w = XMVectorGetW(clipPosition);
+        if(w <= 1e-6f)
+            return true;
+
+        const XMVECTOR ndc = XMVectorDivide(clipPosition, XMVectorReplicate(w));
+        if(XMVectorGetZ(ndc) < 0.0f && depthClamp == false)
+            return true;
+
+        screenMin = XMVectorMin(screenMin, ndc);
+        screenMax = XMVectorMax(screenMax, ndc);
+    }
+
+    const float nearestDepth = std::max(XMVectorGetZ(screenMin), 0.0f);
+
+    // Every pixel that the rectangle touches needs to be hidden, along with their neighbors. An
+    // occluder can cover the center of a pixel without covering all of it, but then the pixel on
+    // the other side of the occluder's edge is left uncovered.
+    const float minX = (XMVectorGetX(screenMin) * 0.5f + 0.5f) * Width - 1.0f;
+    const float maxX = (XMVectorGetX(screenMax) * 0.5f + 0.5f) * Width + 1.0f;
+    const float minY = (XMVectorGetY(screenMax) * -0.5f + 0.5f) * Height - 1.0f;
+    const float maxY = (XMVectorGetY(screenMin) * -0.5f + 0.5f) * Height + 1.0f;
+    if(maxX <= 0.0f || maxY <= 0.0f || minX >= float(Width) || minY >= float(Height))
+        return true;
+
+    const int32 pixelMinX = std::max(int32(std::floor(minX)), 0);
+    const int32 pixelMinY = std::max(int32(std::floor(minY)), 0);
+    const int32 pixelMaxX = std::max(std::min(int32(std::ceil(maxX)), int32(Width)) - 1, pixelMinX);
+    const int32 pixelMaxY = std::max(std::min(int32(std::ceil(maxY)), int32(Height)) - 1, pixelMinY);
+
+    const XMVECTOR testDepth = XMVectorReplicate(nearestDepth);
+    const XMVECTOR laneOffsets = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+
+    for(int32 blockY = pixelMinY / BlockSize; blockY <= pixelMaxY / int32(BlockSize); ++blockY)
+    {
+        for(int32 blockX = pixelMinX / BlockSize; blockX <= pixelMaxX / int32(BlockSize); ++blockX)
+        {
+            // Everything in the block is in front of the AABB
+            if(nearestDepth > blockDepths[blockY * NumBlocksX + blockX])
+                continue;
+
+            const int32 minBlockX = std::max(pixelMinX, blockX * int32(BlockSize));
+            const int32 maxBlockX = std::min(pixelMaxX, blockX * int32(BlockSize) + int32(BlockSize) - 1);
+            const int32 minBlockY = std::max(pixelMinY, blockY * int32(BlockSize));
+            const int32 maxBlockY = std::min(pixelMaxY, blockY * int32(BlockSize) + int32(BlockSize) - 1);
+            const XMVECTOR rectMinX = XMVectorReplicate(float(minBlockX));
+            const XMVECTOR rectMaxX = XMVectorReplicate(float(maxBlockX));
+
+            for(int32 y = minBlockY; y <= maxBlockY; ++y)
+            {
+                const float* row = &depths[y * Width];
+                for(int32 x = minBlockX & ~3; x <= maxBlockX; x += 4)
+                {
+                    const XMVECTOR pixelX = XMVectorAdd(XMVectorReplicate(float(x)), laneOffsets);
+                    const XMVECTOR inRect = XMVectorAndInt(XMVectorGreaterOrEqual(pixelX, rectMinX),
+                                                           XMVectorLessOrEqual(pixelX, rectMaxX));
+                    const XMVECTOR depth = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x));
+                    const XMVECTOR visible = XMVectorAndInt(XMVectorGreaterOrEqual(depth, testDepth), inRect);
+                    if(XMVector4NotEqualInt(visible, XMVectorFalseInt()))
+                        return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+}
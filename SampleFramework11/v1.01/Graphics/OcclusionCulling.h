@@ -0,0 +1,101 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+#include "..\\SF11_Math.h"
+
+namespace SampleFramework11
+{
+
+// A range of triangles to rasterize as an occluder. Positions are 3 floats at the start of each
+// vertex, and indices are 16 or 32-bit.
+struct Occluder
+{
+    const uint8* Positions = nullptr;
+    uint32 PositionStride = 0;
+    const uint8* Indices = nullptr;
+    uint32 IndexSize = 4;
+    uint32 IndexStart = 0;
+    uint32 IndexCount = 0;
+};
+
+// A low-resolution depth buffer that occluders are rasterized into on the CPU, so that bounds can
+// be tested against it before they're drawn. Occluders cover the pixels whose center they
+// contain, and write their farthest depth within the pixel. Tests are expanded by a pixel to
+// account for pixels that are only partially covered at the edges of occluders, although gaps
+// narrower than a pixel between separate occluders can still be missed. The farthest depth
+// of each block of pixels is also kept, so that most tests can be rejected without touching the
+// individual pixels.
+class OcclusionBuffer
+{
+
+public:
+
+    static const uint32 Width = 256;
+    static const uint32 Height = 128;
+
+    // Triangles are binned into tiles that are rasterized in parallel
+    static const uint32 TileWidth = 64;
+    static const uint32 TileHeight = 32;
+    static const uint32 NumTilesX = Width / TileWidth;
+    static const uint32 NumTilesY = Height / TileHeight;
+    static const uint32 NumTiles = NumTilesX * NumTilesY;
+
+    static const uint32 BlockSize = 8;
+    static const uint32 NumBlocksX = Width / BlockSize;
+    static const uint32 NumBlocksY = Height / BlockSize;
+
+    // Clears the buffer and rasterizes the occluders. Triangles that cross the near plane are
+    // skipped, unless depth clamping is enabled to match rasterizing with depth clipping disabled,
+    // which is only valid for orthographic projections.
+    void Rasterize(const Float4x4& worldViewProjection, const Occluder* occluders, uint64 numOccluders,
+                   bool cullBackFaces, bool depthClamp);
+
+    // Returns false if the AABB is entirely behind the occluders. An AABB that crosses the near
+    // plane is always visible, as is everything before the first call to Rasterize().
+    bool BoundsVisible(const Float3& minBounds, const Float3& maxBounds) const;
+
+    const std::vector<float>& Depths() const { return depths; }
+
+    // Edge functions that are positive inside the triangle, and a depth plane that gives the
+    // farthest depth of the triangle's plane within the pixel
+    struct TriangleSetup
+    {
+        float EdgeA[3];
+        float EdgeB[3];
+        float EdgeC[3];
+        float DepthA = 0.0f;
+        float DepthB = 0.0f;
+        float DepthC = 0.0f;
+        int32 MinX = 0;
+        int32 MinY = 0;
+        int32 MaxX = 0;
+        int32 MaxY = 0;
+    };
+
+protected:
+
+    void RasterizeTile(uint32 tileIdx, uint64 numBatches);
+
+    Float4x4 worldViewProjection;
+    bool depthClamp = false;
+    bool rasterized = false;
+
+    std::vector<float> depths;
+    std::vector<float> blockDepths;
+
+    // Triangles are set up in batches, and each batch has a list of triangles for each tile
+    std::vector<TriangleSetup> triangles;
+    std::vector<std::vector<uint32>> tileBins;
+};
+
+}
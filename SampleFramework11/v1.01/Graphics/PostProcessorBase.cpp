@@ -17,6 +17,21 @@
 namespace SampleFramework11
 {
 
+static void DestroyTempRenderTarget(TempRenderTarget* rt)
+{
+    rt->SRView->Release();
+    rt->RTView->Release();
+    rt->Texture->Release();
+    if(rt->UAView)
+        rt->UAView->Release();
+    delete rt;
+}
+
+static void DestroyTempTextureData(TempTextureData* texData)
+{
+    delete texData;
+}
+
 PostProcessorBase::PostProcessorBase() : device(nullptr), context(nullptr)
 {
 }
@@ -162,9 +177,7 @@ void PostProcessorBase::Initialize(ID3D11Device* device)
 
 void PostProcessorBase::AfterReset(uint32 width, uint32 height)
 {
-    // Clear all of the temp render targets
-    ClearTempRenderTargetCache();
-
+    // Temp render targets sized for the old resolution will age out of the cache
     inputWidth = width;
     inputHeight = height;
 }
@@ -173,6 +186,10 @@ void PostProcessorBase::Render(ID3D11DeviceContext* deviceContext, ID3D11ShaderR
 {
     context = deviceContext;
 
+    // Evict temp resources that weren't used recently
+    tempRenderTargets.NextFrame(MaxTempResourceAge, DestroyTempRenderTarget);
+    tempTextureData.NextFrame(MaxTempResourceAge, DestroyTempTextureData);
+
     // Set device states
     float blendFactor[4] = {1, 1, 1, 1};
     context->RSSetState(rastState);
@@ -326,20 +343,32 @@ TempRenderTarget* PostProcessorBase::GetTempRenderTarget(uint32 width, uint32 he
                                                          uint32 msCount, uint32 msQuality, uint32 mipLevels,
                                                          bool generateMipMaps, bool useAsUAV)
 {
-    // Look through existing render targets
-    for (size_t i = 0; i < tempRenderTargets.size(); ++i)
+    struct TempRenderTargetDesc
     {
-        TempRenderTarget* rt = tempRenderTargets[i];
-        if (!rt->InUse && rt->Width == width && rt->Height == height && rt->Format == format
-                && rt->MSCount == msCount && rt->MSQuality == msQuality && (rt->UAView != nullptr) == useAsUAV)
-        {
-            rt->InUse = true;
-            return rt;
-        }
+        uint32 Width;
+        uint32 Height;
+        DXGI_FORMAT Format;
+        uint32 MSCount;
+        uint32 MSQuality;
+        uint32 MipLevels;
+        uint32 GenerateMipMaps;
+        uint32 UseAsUAV;
+    };
+
+    TempRenderTargetDesc rtDesc = { width, height, format, msCount, msQuality, mipLevels,
+                                    generateMipMaps ? 1 : 0, useAsUAV ? 1 : 0 };
+    const uint64 key = TransientCache<TempRenderTarget>::MakeKey(rtDesc);
+
+    // Look for an existing render target with the same description
+    TempRenderTarget* rt = tempRenderTargets.Acquire(key);
+    if(rt != nullptr)
+    {
+        Assert_(rt->Width == width && rt->Height == height && rt->Format == format);
+        return rt;
     }
 
     // Didn't find one, have to make one
-    TempRenderTarget* rt = new TempRenderTarget();
+    rt = new TempRenderTarget();
     D3D11_TEXTURE2D_DESC desc;
     desc.Width = width;
     desc.Height = height;
@@ -367,26 +396,37 @@ TempRenderTarget* PostProcessorBase::GetTempRenderTarget(uint32 width, uint32 he
     rt->Height = height;
     rt->MSCount = msCount;
     rt->MSQuality = msQuality;
+    rt->MipLevels = mipLevels;
     rt->Format = format;
-    rt->InUse = true;
-    tempRenderTargets.push_back(rt);
+    tempRenderTargets.Add(key, rt);
 
-    return tempRenderTargets[tempRenderTargets.size() - 1];
+    return rt;
 }
 
-void PostProcessorBase::ClearTempRenderTargetCache()
+// Returns CPU texture data from the same kind of cache used for temp render targets
+TempTextureData* PostProcessorBase::GetTempTextureData(uint32 width, uint32 height)
 {
-    for (size_t i = 0; i < tempRenderTargets.size(); ++i)
+    uint32 texDesc[2] = { width, height };
+    const uint64 key = TransientCache<TempTextureData>::MakeKey(texDesc);
+
+    TempTextureData* texData = tempTextureData.Acquire(key);
+    if(texData != nullptr)
     {
-        tempRenderTargets[i]->SRView->Release();
-        tempRenderTargets[i]->RTView->Release();
-        tempRenderTargets[i]->Texture->Release();
-        if(tempRenderTargets[i]->UAView)
-            tempRenderTargets[i]->UAView->Release();
-        delete tempRenderTargets[i];
+        Assert_(texData->Data.Width == width && texData->Data.Height == height);
+        return texData;
     }
 
-    tempRenderTargets.erase(tempRenderTargets.begin(), tempRenderTargets.end());
+    texData = new TempTextureData();
+    texData->Data.Init(width, height, 1);
+    tempTextureData.Add(key, texData);
+
+    return texData;
+}
+
+void PostProcessorBase::ClearTempRenderTargetCache()
+{
+    tempRenderTargets.Clear(DestroyTempRenderTarget);
+    tempTextureData.Clear(DestroyTempTextureData);
 }
 
 }
@@ -12,7 +12,10 @@
 #include "..\\PCH.h"
 
 #include "..\\InterfacePointers.h"
+#include "..\\SF11_Math.h"
 #include "ShaderCompilation.h"
+#include "Textures.h"
+#include "TransientCache.h"
 
 namespace SampleFramework11
 {
@@ -28,6 +31,17 @@ struct TempRenderTarget
     DXGI_FORMAT Format;
     UINT MSCount;
     UINT MSQuality;
+    UINT MipLevels;
+    uint64 Key;
+    uint64 LastUsedFrame;
+    bool InUse;
+};
+
+struct TempTextureData
+{
+    TextureData<Float4> Data;
+    uint64 Key;
+    uint64 LastUsedFrame;
     bool InUse;
 };
 
@@ -49,6 +63,9 @@ protected:
 
     static const UINT_PTR MaxInputs = 8;
 
+    // Number of frames a temp resource can go unused before it's evicted from the cache
+    static const uint64 MaxTempResourceAge = 8;
+
     struct PSConstants
     {
         XMFLOAT2 InputSize[MaxInputs];
@@ -64,12 +81,14 @@ protected:
     TempRenderTarget* GetTempRenderTarget(uint32 width, uint32 height, DXGI_FORMAT format, uint32 msCount = 1,
                                           uint32 msQuality = 0, uint32 mipLevels = 1, bool generateMipMaps = false,
                                           bool useAsUAV = false);
+    TempTextureData* GetTempTextureData(uint32 width, uint32 height);
     void ClearTempRenderTargetCache();
 
     void PostProcess(ID3D11ShaderResourceView* input, ID3D11RenderTargetView* output, ID3D11PixelShader* pixelShader, const wchar* name);
     virtual void PostProcess(ID3D11PixelShader* pixelShader, const wchar* name);
 
-    std::vector<TempRenderTarget*> tempRenderTargets;
+    TransientCache<TempRenderTarget> tempRenderTargets;
+    TransientCache<TempTextureData> tempTextureData;
     ID3D11Device* device;
     ID3D11DeviceContext* context;
 
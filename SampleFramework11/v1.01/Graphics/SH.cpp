@@ -10,6 +10,7 @@
 #include "PCH.h"
 #include "SH.h"
 #include "..\\Utility.h"
+#include "..\\TaskScheduler.h"
 #include "ShaderCompilation.h"
 #include "Textures.h"
 
@@ -123,12 +124,17 @@ SH9Color ProjectCubemapToSH(ID3D11Device* device, ID3D11ShaderResourceView* cube
     const uint32 width = textureData.Width;
     const uint32 height = textureData.Height;
 
-    SH9Color result;
-    float weightSum = 0.0f;
-    for(uint32 face = 0; face < 6; ++face)
+    // Each row of each face is summed separately, and then the rows are added up in order so that
+    // the result doesn't depend on how the work was split up
+    const uint64 numRows = 6 * uint64(height);
+    std::vector<SH9Color> rowResults(numRows);
+    std::vector<float> rowWeights(numRows, 0.0f);
+    ParallelFor(numRows, 0, [&](uint64 start, uint64 end)
     {
-        for(uint32 y = 0; y < height; ++y)
+        for(uint64 row = start; row < end; ++row)
         {
+            const uint32 face = uint32(row / height);
+            const uint32 y = uint32(row % height);
             for(uint32 x = 0; x < width; ++x)
             {
                 const uint32 idx = face * (width * height) + y * (width) + x;
@@ -144,10 +150,18 @@ SH9Color ProjectCubemapToSH(ID3D11Device* device, ID3D11ShaderResourceView* cube
                 const float weight = 4.0f / (sqrt(temp) * temp);
 
                 Float3 dir = MapXYSToDirection(x, y, face, width, height);
-                result += ProjectOntoSH9Color(dir, sample) * weight;
-                weightSum += weight;
+                rowResults[row] += ProjectOntoSH9Color(dir, sample) * weight;
+                rowWeights[row] += weight;
             }
         }
+    });
+
+    SH9Color result;
+    float weightSum = 0.0f;
+    for(uint64 row = 0; row < numRows; ++row)
+    {
+        result += rowResults[row];
+        weightSum += rowWeights[row];
     }
 
     result *= (4.0f * 3.14159f) / weightSum;
@@ -173,6 +173,9 @@ typedef SH<Float3, 4> SH4Color;
 typedef SH<float, 9> SH9;
 typedef SH<Float3, 9> SH9Color;
 
+// Content version for .shdata chunk files
+static const uint32 SHDataVersion = 1;
+
 // H-basis
 class H4 : public SH<float, 4>
 {
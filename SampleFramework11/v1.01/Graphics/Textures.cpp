@@ -55,6 +55,125 @@ ID3D11ShaderResourceViewPtr LoadTexture(ID3D11Device* device, const wchar* fileP
     }
 }
 
+// Decodes a texture file into system memory. Mips are generated for non-DDS files, to match what
+// the WIC loader does when it can auto-generate mips.
+void DecodeTexture(const wchar* filePath, const std::vector<uint8>& fileData, ScratchImage& image)
+{
+    const std::wstring extension = GetFileExtension(filePath);
+    if(extension == L"DDS" || extension == L"dds")
+    {
+        DXCall(LoadFromDDSMemory(fileData.data(), fileData.size(), DDS_FLAGS_NONE, nullptr, image));
+        return;
+    }
+
+    ScratchImage decoded;
+    DXCall(LoadFromWICMemory(fileData.data(), fileData.size(), WIC_FLAGS_NONE, nullptr, decoded));
+    if(decoded.GetMetadata().mipLevels > 1)
+    {
+        image = std::move(decoded);
+        return;
+    }
+
+    DXCall(GenerateMipMaps(*decoded.GetImage(0, 0, 0), TEX_FILTER_DEFAULT, 0, image));
+}
+
+// Creates a texture + SRV from a decoded image
+ID3D11ShaderResourceViewPtr CreateTextureFromImage(ID3D11Device* device, const ScratchImage& image,
+                                                   bool forceSRGB, const wchar* debugName)
+{
+    ID3D11ShaderResourceViewPtr srv;
+    DXCall(CreateShaderResourceViewEx(device, image.GetImages(), image.GetImageCount(), image.GetMetadata(),
+                                      D3D11_USAGE_IMMUTABLE, D3D11_BIND_SHADER_RESOURCE, 0, 0, forceSRGB, &srv));
+
+    ID3D11ResourcePtr resource;
+    srv->GetResource(&resource);
+    std::string name = WStringToAnsi(debugName);
+    resource->SetPrivateData(WKPDID_D3DDebugObjectName, UINT(name.length()), name.c_str());
+
+    return srv;
+}
+
+struct SharedTexture
+{
+    ID3D11ShaderResourceViewPtr SRV;
+    uint64 RefCount = 0;
+};
+
+static std::map<std::wstring, SharedTexture> sharedTextures;
+static std::mutex sharedTextureMutex;
+
+static std::wstring SharedTextureKey(const wchar* filePath, bool forceSRGB)
+{
+    return std::wstring(filePath) + (forceSRGB ? L"|sRGB" : L"");
+}
+
+ID3D11ShaderResourceViewPtr AcquireSharedTexture(ID3D11Device* device, const wchar* filePath, bool forceSRGB,
+                                                 const ScratchImage* decodedImage)
+{
+    const std::wstring key = SharedTextureKey(filePath, forceSRGB);
+
+    {
+        std::lock_guard<std::mutex> lock(sharedTextureMutex);
+        auto iter = sharedTextures.find(key);
+        if(iter != sharedTextures.end())
+        {
+            ++iter->second.RefCount;
+            return iter->second.SRV;
+        }
+    }
+
+    ID3D11ShaderResourceViewPtr srv;
+    if(decodedImage != nullptr && decodedImage->GetImageCount() > 0)
+        srv = CreateTextureFromImage(device, *decodedImage, forceSRGB, filePath);
+    else
+        srv = LoadTexture(device, filePath, forceSRGB);
+
+    // Another thread may have loaded the same texture in the meantime, in which case we use theirs
+    std::lock_guard<std::mutex> lock(sharedTextureMutex);
+    SharedTexture& sharedTexture = sharedTextures[key];
+    if(sharedTexture.SRV == nullptr)
+        sharedTexture.SRV = srv;
+    ++sharedTexture.RefCount;
+    return sharedTexture.SRV;
+}
+
+void ReleaseSharedTexture(const wchar* filePath, bool forceSRGB)
+{
+    std::lock_guard<std::mutex> lock(sharedTextureMutex);
+    auto iter = sharedTextures.find(SharedTextureKey(filePath, forceSRGB));
+    Assert_(iter != sharedTextures.end());
+    Assert_(iter->second.RefCount > 0);
+    if(--iter->second.RefCount == 0)
+        sharedTextures.erase(iter);
+}
+
+bool SharedTextureResident(const wchar* filePath, bool forceSRGB)
+{
+    std::lock_guard<std::mutex> lock(sharedTextureMutex);
+    return sharedTextures.count(SharedTextureKey(filePath, forceSRGB)) > 0;
+}
+
+uint64 TextureMemorySize(ID3D11ShaderResourceView* srv)
+{
+    ID3D11Texture2DPtr texture;
+    srv->GetResource(reinterpret_cast<ID3D11Resource**>(&texture));
+
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+
+    uint64 size = 0;
+    for(uint32 mip = 0; mip < desc.MipLevels; ++mip)
+    {
+        size_t rowPitch = 0;
+        size_t slicePitch = 0;
+        ComputePitch(desc.Format, std::max<uint32>(desc.Width >> mip, 1), std::max<uint32>(desc.Height >> mip, 1),
+                     rowPitch, slicePitch);
+        size += slicePitch;
+    }
+
+    return size * desc.ArraySize;
+}
+
 template<typename T>
 static void GetTextureData(ID3D11Device* device, ID3D11ShaderResourceView* textureSRV,
                            DXGI_FORMAT outFormat, TextureData<T>& texData)
@@ -346,4 +465,108 @@ Float3 MapXYSToDirection(uint64 x, uint64 y, uint64 s, uint64 width, uint64 heig
     return dir;
 }
 
+// Bilinear sample with clamp addressing, equivalent to LinearSampler in PPIncludes.hlsl
+static XMVECTOR SampleClamped(const TextureData<Float4>& texture, float u, float v)
+{
+    const float x = Clamp(u * texture.Width - 0.5f, 0.0f, float(texture.Width - 1));
+    const float y = Clamp(v * texture.Height - 0.5f, 0.0f, float(texture.Height - 1));
+    const uint32 x0 = uint32(x);
+    const uint32 y0 = uint32(y);
+    const uint32 x1 = std::min(x0 + 1, texture.Width - 1);
+    const uint32 y1 = std::min(y0 + 1, texture.Height - 1);
+
+    const Float4* texels = texture.Texels.data();
+    const uint32 width = texture.Width;
+    XMVECTOR top = XMVectorLerp(texels[y0 * width + x0].ToSIMD(), texels[y0 * width + x1].ToSIMD(), x - x0);
+    XMVECTOR bottom = XMVectorLerp(texels[y1 * width + x0].ToSIMD(), texels[y1 * width + x1].ToSIMD(), x - x0);
+    return XMVectorLerp(top, bottom, y - y0);
+}
+
+// Halves the resolution of a texture using the 13-tap filter from the BloomDownsample shader
+void DownsampleTextureData(const TextureData<Float4>& input, TextureData<Float4>& output)
+{
+    Assert_(input.NumSlices == 1);
+
+    output.Init(std::max<uint32>(input.Width / 2, 1), std::max<uint32>(input.Height / 2, 1), 1);
+
+    static const float Offsets[13][2] =
+    {
+        { -2.0f, -2.0f }, { 0.0f, -2.0f }, { 2.0f, -2.0f },
+        { -1.0f, -1.0f }, { 1.0f, -1.0f },
+        { -2.0f,  0.0f }, { 0.0f,  0.0f }, { 2.0f,  0.0f },
+        { -1.0f,  1.0f }, { 1.0f,  1.0f },
+        { -2.0f,  2.0f }, { 0.0f,  2.0f }, { 2.0f,  2.0f },
+    };
+
+    // The inner 4 taps get 0.5 / 4, the corners get 0.125 / 4, the edges are shared by two
+    // outer boxes, and the center is shared by all 4 outer boxes
+    static const float Weights[13] =
+    {
+        0.03125f, 0.0625f, 0.03125f,
+        0.125f, 0.125f,
+        0.0625f, 0.125f, 0.0625f,
+        0.125f, 0.125f,
+        0.03125f, 0.0625f, 0.03125f,
+    };
+
+    const float texelSizeX = 1.0f / input.Width;
+    const float texelSizeY = 1.0f / input.Height;
+
+    for(uint32 y = 0; y < output.Height; ++y)
+    {
+        for(uint32 x = 0; x < output.Width; ++x)
+        {
+            const float u = (x + 0.5f) / output.Width;
+            const float v = (y + 0.5f) / output.Height;
+
+            XMVECTOR result = XMVectorZero();
+            for(uint32 i = 0; i < 13; ++i)
+            {
+                XMVECTOR sample = SampleClamped(input, u + Offsets[i][0] * texelSizeX, v + Offsets[i][1] * texelSizeY);
+                result = XMVectorMultiplyAdd(sample, XMVectorReplicate(Weights[i]), result);
+            }
+
+            output.Texels[y * output.Width + x] = Float4(XMVectorSetW(result, 1.0f));
+        }
+    }
+}
+
+// Upsamples the lower mip with a 3x3 tent filter and averages it with the current mip,
+// matching the BloomUpsample shader
+void UpsampleTextureData(const TextureData<Float4>& lowerMip, const TextureData<Float4>& currentMip,
+                         float filterRadius, TextureData<Float4>& output)
+{
+    Assert_(lowerMip.NumSlices == 1 && currentMip.NumSlices == 1);
+
+    output.Init(currentMip.Width, currentMip.Height, 1);
+
+    const float offsetX = filterRadius / lowerMip.Width;
+    const float offsetY = filterRadius / lowerMip.Height;
+    const XMVECTOR half = XMVectorReplicate(0.5f);
+
+    for(uint32 y = 0; y < output.Height; ++y)
+    {
+        for(uint32 x = 0; x < output.Width; ++x)
+        {
+            const float u = (x + 0.5f) / output.Width;
+            const float v = (y + 0.5f) / output.Height;
+
+            XMVECTOR upsampled = XMVectorZero();
+            for(int32 ty = -1; ty <= 1; ++ty)
+            {
+                for(int32 tx = -1; tx <= 1; ++tx)
+                {
+                    const float weight = float((2 - std::abs(tx)) * (2 - std::abs(ty))) / 16.0f;
+                    XMVECTOR sample = SampleClamped(lowerMip, u + tx * offsetX, v + ty * offsetY);
+                    upsampled = XMVectorMultiplyAdd(sample, XMVectorReplicate(weight), upsampled);
+                }
+            }
+
+            const uint32 idx = y * output.Width + x;
+            XMVECTOR result = XMVectorMultiply(XMVectorAdd(currentMip.Texels[idx].ToSIMD(), upsampled), half);
+            output.Texels[idx] = Float4(XMVectorSetW(result, 1.0f));
+        }
+    }
+}
+
 }
@@ -25,6 +25,24 @@ class File;
 // Texture loading
 ID3D11ShaderResourceViewPtr LoadTexture(ID3D11Device* device, const wchar* filePath, bool forceSRGB = false);
 
+// Split texture loading, where the file is decoded into system memory without touching the device
+// (and so can be done from any thread with COM initialized), and the texture is created later.
+// The file's contents are passed in, and the path is only used to pick the decoder.
+void DecodeTexture(const wchar* filePath, const std::vector<uint8>& fileData, DirectX::ScratchImage& image);
+ID3D11ShaderResourceViewPtr CreateTextureFromImage(ID3D11Device* device, const DirectX::ScratchImage& image,
+                                                   bool forceSRGB, const wchar* debugName);
+
+// Reference-counted texture sharing, so that everything that loads the same file shares a single
+// texture. Every AcquireSharedTexture needs a matching ReleaseSharedTexture. If a decoded image is
+// passed it's used to create the texture, otherwise the file is loaded on the calling thread.
+ID3D11ShaderResourceViewPtr AcquireSharedTexture(ID3D11Device* device, const wchar* filePath, bool forceSRGB,
+                                                 const DirectX::ScratchImage* decodedImage = nullptr);
+void ReleaseSharedTexture(const wchar* filePath, bool forceSRGB);
+bool SharedTextureResident(const wchar* filePath, bool forceSRGB);
+
+// Approximate amount of GPU memory used by a texture
+uint64 TextureMemorySize(ID3D11ShaderResourceView* srv);
+
 template<typename T> struct TextureData
 {
     std::vector<T> Texels;
@@ -75,6 +93,11 @@ void SaveTextureAsEXR(const TextureData<Float4>& texture, const wchar* filePath)
 
 Float3 MapXYSToDirection(uint64 x, uint64 y, uint64 s, uint64 width, uint64 height);
 
+// CPU image pyramid functions, matching the dual filter bloom shaders
+void DownsampleTextureData(const TextureData<Float4>& input, TextureData<Float4>& output);
+void UpsampleTextureData(const TextureData<Float4>& lowerMip, const TextureData<Float4>& currentMip,
+                         float filterRadius, TextureData<Float4>& output);
+
 // == Texture Sampling Functions ==================================================================
 
 template<typename T> static XMVECTOR SampleTexture2D(Float2 uv, uint32 arraySlice, const std::vector<T>& texels,
@@ -0,0 +1,113 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+#include "..\\MurmurHash.h"
+
+namespace SampleFramework11
+{
+
+// Cache for resources that only live for part of a frame. Resources are bucketed by a hash of
+// their description, so that once a pass releases a resource it can be handed to any later pass
+// that needs an identical one. Resources that go unused for a few frames are evicted, instead of
+// flushing the whole cache every time the working set changes. T needs to have Key, LastUsedFrame,
+// and InUse members.
+template<typename T> class TransientCache
+{
+
+public:
+
+    template<typename TDesc> static uint64 MakeKey(const TDesc& desc)
+    {
+        return GenerateHash(&desc, sizeof(TDesc)).A;
+    }
+
+    // Returns an unused resource with a matching key, or nullptr if there isn't one
+    T* Acquire(uint64 key)
+    {
+        auto bucket = buckets.find(key);
+        if(bucket == buckets.end())
+            return nullptr;
+
+        for(T* item : bucket->second)
+        {
+            if(item->InUse == false)
+            {
+                item->InUse = true;
+                item->LastUsedFrame = currFrame;
+                return item;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // Adds a newly-created resource to the cache, and marks it as being in use
+    void Add(uint64 key, T* item)
+    {
+        item->Key = key;
+        item->InUse = true;
+        item->LastUsedFrame = currFrame;
+        buckets[key].push_back(item);
+        ++numItems;
+    }
+
+    // Advances the frame, and destroys resources that haven't been used for more than maxAge frames
+    template<typename TDeleter> void NextFrame(uint64 maxAge, TDeleter deleter)
+    {
+        ++currFrame;
+
+        for(auto bucket = buckets.begin(); bucket != buckets.end();)
+        {
+            std::vector<T*>& items = bucket->second;
+            for(uint64 i = 0; i < items.size();)
+            {
+                T* item = items[i];
+                if(item->InUse == false && currFrame - item->LastUsedFrame > maxAge)
+                {
+                    deleter(item);
+                    items[i] = items.back();
+                    items.pop_back();
+                    --numItems;
+                }
+                else
+                    ++i;
+            }
+
+            if(items.size() == 0)
+                bucket = buckets.erase(bucket);
+            else
+                ++bucket;
+        }
+    }
+
+    template<typename TDeleter> void Clear(TDeleter deleter)
+    {
+        for(auto& bucket : buckets)
+            for(T* item : bucket.second)
+                deleter(item);
+
+        buckets.clear();
+        numItems = 0;
+    }
+
+    uint64 NumItems() const { return numItems; }
+    uint64 CurrFrame() const { return currFrame; }
+
+private:
+
+    std::unordered_map<uint64, std::vector<T*>> buckets;
+    uint64 currFrame = 0;
+    uint64 numItems = 0;
+};
+
+}
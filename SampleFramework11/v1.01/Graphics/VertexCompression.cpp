@@ -0,0 +1,166 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "VertexCompression.h"
+
+#include "..\\Exceptions.h"
+#include "..\\TaskScheduler.h"
+
+namespace SampleFramework11
+{
+
+const D3D11_INPUT_ELEMENT_DESC CompressedVertexElements[NumCompressedVertexElements] =
+{
+    { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+    { "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+static const uint32 InvalidOffset = 0xFFFFFFFF;
+static const uint64 CompressionBatchSize = 4096;
+
+struct SourceLayout
+{
+    uint32 Position = InvalidOffset;
+    uint32 Normal = InvalidOffset;
+    uint32 TexCoord = InvalidOffset;
+    uint32 Tangent = InvalidOffset;
+    uint32 Bitangent = InvalidOffset;
+};
+
+static bool FindSourceLayout(const D3D11_INPUT_ELEMENT_DESC* elements, uint32 numElements,
+                             SourceLayout& layout)
+{
+    for(uint32 i = 0; i < numElements; ++i)
+    {
+        const D3D11_INPUT_ELEMENT_DESC& element = elements[i];
+        const std::string semantic = element.SemanticName;
+        if(element.SemanticIndex != 0 || element.InputSlot != 0)
+            return false;
+
+        if(semantic == "TEXCOORD")
+        {
+            if(element.Format != DXGI_FORMAT_R32G32_FLOAT)
+                return false;
+            layout.TexCoord = element.AlignedByteOffset;
+            continue;
+        }
+
+        if(element.Format != DXGI_FORMAT_R32G32B32_FLOAT)
+            return false;
+
+        if(semantic == "POSITION")
+            layout.Position = element.AlignedByteOffset;
+        else if(semantic == "NORMAL")
+            layout.Normal = element.AlignedByteOffset;
+        else if(semantic == "TANGENT")
+            layout.Tangent = element.AlignedByteOffset;
+        else if(semantic == "BITANGENT")
+            layout.Bitangent = element.AlignedByteOffset;
+        else
+            return false;
+    }
+
+    return layout.Position != InvalidOffset && layout.Normal != InvalidOffset;
+}
+
+bool CanCompressVertices(const D3D11_INPUT_ELEMENT_DESC* elements, uint32 numElements)
+{
+    SourceLayout layout;
+    return FindSourceLayout(elements, numElements, layout);
+}
+
+// Maps a unit vector onto the octahedron, and then unfolds the lower half onto the outer
+// triangles of the [-1, 1] square
+static XMVECTOR EncodeOctahedral(FXMVECTOR n)
+{
+    const XMVECTOR one = XMVectorSplatOne();
+    const XMVECTOR zero = XMVectorZero();
+
+    XMVECTOR absSum = XMVector3Dot(XMVectorAbs(n), one);
+    XMVECTOR p = XMVectorDivide(n, XMVectorMax(absSum, XMVectorReplicate(1e-20f)));
+
+    XMVECTOR signs = XMVectorSelect(XMVectorNegate(one), one, XMVectorGreaterOrEqual(p, zero));
+    XMVECTOR folded = XMVectorSubtract(one, XMVectorAbs(XMVectorSwizzle<1, 0, 2, 3>(p)));
+    folded = XMVectorMultiply(folded, signs);
+
+    return XMVectorSelect(p, folded, XMVectorLess(XMVectorSplatZ(p), zero));
+}
+
+static XMVECTOR LoadUnitVector(const uint8* data, FXMVECTOR fallback)
+{
+    XMVECTOR v = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(data));
+    if(XMVectorGetX(XMVector3LengthSq(v)) < 1e-12f)
+        return fallback;
+    return XMVector3Normalize(v);
+}
+
+void CompressVertices(const uint8* vertices, uint32 vertexStride, uint64 numVertices,
+                      const D3D11_INPUT_ELEMENT_DESC* elements, uint32 numElements,
+                      const Float3& positionMin, const Float3& positionMax,
+                      CompressedVertex* output)
+{
+    SourceLayout layout;
+    if(FindSourceLayout(elements, numElements, layout) == false)
+        throw Exception(L"Can't compress vertices, the mesh has an unsupported vertex layout");
+
+    const XMVECTOR posMin = positionMin.ToSIMD();
+    const XMVECTOR extent = XMVectorSubtract(positionMax.ToSIMD(), posMin);
+    const XMVECTOR invExtent = XMVectorSelect(XMVectorZero(), XMVectorReciprocal(extent),
+                                              XMVectorGreater(extent, XMVectorZero()));
+
+    ParallelFor(numVertices, CompressionBatchSize, [&](uint64 start, uint64 end)
+    {
+        for(uint64 i = start; i < end; ++i)
+        {
+            const uint8* vtx = vertices + i * vertexStride;
+            CompressedVertex& outVtx = output[i];
+
+            XMVECTOR position = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vtx + layout.Position));
+            XMVECTOR normal = LoadUnitVector(vtx + layout.Normal, g_XMIdentityR2);
+
+            // Make sure that the tangent is orthogonal to the normal, since the bitangent is
+            // reconstructed with a cross product
+            XMVECTOR perpendicular = Float3::Perpendicular(Float3(normal)).ToSIMD();
+            XMVECTOR tangent = perpendicular;
+            if(layout.Tangent != InvalidOffset)
+            {
+                tangent = LoadUnitVector(vtx + layout.Tangent, perpendicular);
+                tangent = XMVectorSubtract(tangent, XMVectorMultiply(normal, XMVector3Dot(normal, tangent)));
+                tangent = XMVectorGetX(XMVector3LengthSq(tangent)) < 1e-12f ? perpendicular
+                                                                             : XMVector3Normalize(tangent);
+            }
+
+            float bitangentSign = 1.0f;
+            if(layout.Bitangent != InvalidOffset)
+            {
+                XMVECTOR bitangent = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vtx + layout.Bitangent));
+                if(XMVectorGetX(XMVector3Dot(XMVector3Cross(normal, tangent), bitangent)) < 0.0f)
+                    bitangentSign = 0.0f;
+            }
+
+            XMVECTOR quantized = XMVectorSaturate(XMVectorMultiply(XMVectorSubtract(position, posMin), invExtent));
+            quantized = XMVectorSetW(quantized, bitangentSign);
+            XMStoreUShortN4(reinterpret_cast<XMUSHORTN4*>(outVtx.Position), quantized);
+
+            XMStoreShortN2(reinterpret_cast<XMSHORTN2*>(outVtx.Normal), EncodeOctahedral(normal));
+            XMStoreShortN2(reinterpret_cast<XMSHORTN2*>(outVtx.Tangent), EncodeOctahedral(tangent));
+
+            XMVECTOR uv = XMVectorZero();
+            if(layout.TexCoord != InvalidOffset)
+                uv = XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(vtx + layout.TexCoord));
+            XMStoreHalf2(reinterpret_cast<XMHALF2*>(outVtx.TexCoord), uv);
+        }
+    });
+}
+
+}
@@ -0,0 +1,44 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "..\\PCH.h"
+
+#include "..\\SF11_Math.h"
+
+namespace SampleFramework11
+{
+
+// Quantized vertex layout for meshes with positions, normals, texture coordinates, and an optional
+// tangent frame. Positions are 16-bit UNORM relative to the mesh's bounding box, normals and
+// tangents are octahedral-encoded 16-bit SNORM, and the bitangent is reconstructed in the vertex
+// shader from the normal, tangent, and a sign stored in position.w.
+struct CompressedVertex
+{
+    uint16 Position[4];
+    int16 Normal[2];
+    uint16 TexCoord[2];
+    int16 Tangent[2];
+};
+
+static const uint32 NumCompressedVertexElements = 4;
+extern const D3D11_INPUT_ELEMENT_DESC CompressedVertexElements[NumCompressedVertexElements];
+
+// Returns true if every element of the vertex layout can be represented in the compressed layout
+bool CanCompressVertices(const D3D11_INPUT_ELEMENT_DESC* elements, uint32 numElements);
+
+// Encodes vertices into the compressed layout. Positions are quantized relative to the
+// positionMin/positionMax bounding box.
+void CompressVertices(const uint8* vertices, uint32 vertexStride, uint64 numVertices,
+                      const D3D11_INPUT_ELEMENT_DESC* elements, uint32 numElements,
+                      const Float3& positionMin, const Float3& positionMax,
+                      CompressedVertex* output);
+
+}
@@ -124,6 +124,7 @@ using namespace DirectX::PackedVector;
 #include <vector>
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <cmath>
 #include <sstream>
 #include <fstream>
@@ -132,6 +133,11 @@ using namespace DirectX::PackedVector;
 #include <cstdio>
 #include <cstdarg>
 #include <random>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <condition_variable>
 
 // AntTweakBar
 #include "..\\..\\Externals\\AntTweakBar\\include\\AntTweakBar.h"
@@ -13,6 +13,8 @@
 
 #include "Exceptions.h"
 #include "FileIO.h"
+#include "TaskScheduler.h"
+#include "Compression.h"
 
 namespace SampleFramework11
 {
@@ -45,6 +47,82 @@ public:
     static bool IsWriteSerializer() { return false; }
 };
 
+// Reads from a memory-mapped file, so that each item is a copy out of the mapping rather than a
+// call to ReadFile. Raw views can reference the mapping directly (see SerializeRawView). It can
+// also read from an in-memory buffer, such as the output of DecompressBlocks.
+class MappedFileReadSerializer
+{
+
+private:
+
+    std::shared_ptr<const void> owner;
+    const uint8* base = nullptr;
+    uint64 offset = 0;
+    uint64 end = 0;
+
+    const uint8* Consume(uint64 size)
+    {
+        if(size > end - offset)
+            throw Exception(L"Attempted to read past the end of a serialized file");
+
+        const uint8* data = base + offset;
+        offset += size;
+        return data;
+    }
+
+public:
+
+    explicit MappedFileReadSerializer(const wchar* path)
+    {
+        std::shared_ptr<MappedFile> mapping(new MappedFile(path));
+        owner = mapping;
+        base = mapping->Data();
+        end = mapping->Size();
+    }
+
+    // Reads from a sub-range of an existing mapping
+    MappedFileReadSerializer(const std::shared_ptr<MappedFile>& mapping, uint64 offset_, uint64 size)
+        : owner(mapping), base(mapping->Data()), offset(offset_), end(offset_ + size)
+    {
+        Assert_(end <= mapping->Size());
+    }
+
+    // Reads from a buffer in memory
+    explicit MappedFileReadSerializer(const std::shared_ptr<std::vector<uint8>>& buffer)
+        : owner(buffer), base(buffer->data()), end(buffer->size())
+    {
+    }
+
+    template<typename T> void SerializeItem(T& data)
+    {
+        memcpy(&data, Consume(sizeof(T)), sizeof(T));
+    }
+
+    void SerializeData(uint64 size, void* data)
+    {
+        memcpy(data, Consume(size), size_t(size));
+    }
+
+    // Returns a pointer into the mapping if it has the required alignment, otherwise null
+    const void* MapData(uint64 size, uint64 alignment)
+    {
+        if(size > end - offset)
+            throw Exception(L"Attempted to read past the end of a serialized file");
+
+        const uint8* data = base + offset;
+        if(reinterpret_cast<uintptr_t>(data) % alignment != 0)
+            return nullptr;
+
+        offset += size;
+        return data;
+    }
+
+    const std::shared_ptr<const void>& Owner() const { return owner; }
+
+    static bool IsReadSerializer() { return true; }
+    static bool IsWriteSerializer() { return false; }
+};
+
 class FileWriteSerializer
 {
 
@@ -73,6 +151,39 @@ public:
     static bool IsWriteSerializer() { return true; }
 };
 
+// Serializes into a memory buffer, so that the result can be written out with a single call
+class MemoryWriteSerializer
+{
+
+private:
+
+    std::vector<uint8> buffer;
+
+public:
+
+    explicit MemoryWriteSerializer(uint64 reserveSize = 0)
+    {
+        buffer.reserve(size_t(reserveSize));
+    }
+
+    template<typename T> void SerializeItem(const T& data)
+    {
+        SerializeData(sizeof(T), &data);
+    }
+
+    void SerializeData(uint64 size, const void* data)
+    {
+        const uint8* bytes = reinterpret_cast<const uint8*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    static bool IsReadSerializer() { return false; }
+    static bool IsWriteSerializer() { return true; }
+
+    std::vector<uint8>& Buffer() { return buffer; }
+    const std::vector<uint8>& Buffer() const { return buffer; }
+};
+
 class ComputeSizeSerializer
 {
 
@@ -227,6 +338,90 @@ void SerializeRawVector(TSerializer& serializer, std::vector<TVector>& vec)
     SerializeRawArray(serializer, vec.data(), numElements);
 }
 
+// Array that references serialized data in-place when the serializer supports it, and otherwise
+// holds its own copy in Storage. Modify() switches a mapped view over to an owned copy. Uses the
+// same format as SerializeRawVector.
+template<typename T>
+struct RawView
+{
+    const T* MappedData = nullptr;
+    uint64 NumMappedElements = 0;
+
+    // Keeps the mapping alive while the view references it
+    std::shared_ptr<const void> Owner;
+    std::vector<T> Storage;
+
+    bool Mapped() const { return MappedData != nullptr; }
+    const T* Data() const { return Mapped() ? MappedData : Storage.data(); }
+    uint64 Size() const { return Mapped() ? NumMappedElements : Storage.size(); }
+
+    void Map(const T* data, uint64 numElements, const std::shared_ptr<const void>& owner)
+    {
+        MappedData = data;
+        NumMappedElements = numElements;
+        Owner = owner;
+        Storage.clear();
+    }
+
+    std::vector<T>& Modify()
+    {
+        if(Mapped())
+        {
+            Storage.assign(MappedData, MappedData + NumMappedElements);
+            MappedData = nullptr;
+            NumMappedElements = 0;
+            Owner = nullptr;
+        }
+
+        return Storage;
+    }
+};
+
+template<typename TSerializer>
+const void* MapSerializedData(TSerializer&, uint64, uint64, std::shared_ptr<const void>&)
+{
+    return nullptr;
+}
+
+inline const void* MapSerializedData(MappedFileReadSerializer& serializer, uint64 size, uint64 alignment,
+                                     std::shared_ptr<const void>& owner)
+{
+    const void* data = serializer.MapData(size, alignment);
+    if(data != nullptr)
+        owner = serializer.Owner();
+    return data;
+}
+
+template<typename TSerializer, typename T>
+void SerializeRawView(TSerializer& serializer, RawView<T>& view)
+{
+    uint64 numElements = view.Size();
+    SerializeItem(serializer, numElements);
+
+    if(TSerializer::IsWriteSerializer())
+    {
+        if(numElements > 0)
+            SerializeData(serializer, const_cast<T*>(view.Data()), sizeof(T) * numElements);
+        return;
+    }
+
+    view.Map(nullptr, 0, nullptr);
+    if(numElements == 0)
+        return;
+
+    std::shared_ptr<const void> owner;
+    const void* data = MapSerializedData(serializer, sizeof(T) * numElements, __alignof(T), owner);
+    if(data != nullptr)
+    {
+        view.Map(reinterpret_cast<const T*>(data), numElements, owner);
+    }
+    else
+    {
+        view.Storage.resize(size_t(numElements));
+        SerializeRawArray(serializer, view.Storage.data(), numElements);
+    }
+}
+
 template<typename TSerializer, typename TString>
 void SerializeItem(TSerializer& serializer, std::basic_string<TString>& str)
 {
@@ -242,18 +437,81 @@ void SerializeItem(TSerializer& serializer, std::basic_string<TString>& str)
 }
 
 // Convenience functions for file serialization
+// Reads uncompressed files straight out of the mapping, and block-compressed files from a
+// decompressed copy
 template<typename T>
 void SerializeFromFile(const wchar* filePath, T& item)
 {
-    FileReadSerializer serializer(filePath);
-    SerializeItem(serializer, item);
+    std::shared_ptr<MappedFile> mapping(new MappedFile(filePath));
+    if(IsBlockCompressed(mapping->Data(), mapping->Size()))
+    {
+        std::shared_ptr<std::vector<uint8>> buffer(new std::vector<uint8>());
+        DecompressBlocks(mapping->Data(), mapping->Size(), *buffer);
+        MappedFileReadSerializer serializer(buffer);
+        SerializeItem(serializer, item);
+    }
+    else
+    {
+        MappedFileReadSerializer serializer(mapping, 0, mapping->Size());
+        SerializeItem(serializer, item);
+    }
 }
 
+// Serializes an item into a buffer that's sized up-front, so that it's never reallocated
 template<typename T>
-void SerializeToFile(const wchar* filePath, const T& item)
+void SerializeToMemory(T& item, std::vector<uint8>& buffer)
 {
-    FileWriteSerializer serializer(filePath);
+    ComputeSizeSerializer sizeSerializer;
+    SerializeItem(sizeSerializer, item);
+
+    MemoryWriteSerializer serializer(sizeSerializer.Size());
     SerializeItem(serializer, item);
+    Assert_(serializer.Buffer().size() == sizeSerializer.Size());
+
+    buffer.swap(serializer.Buffer());
+}
+
+// Serializes to memory, optionally block-compresses the result, and then writes the file with a
+// single write
+template<typename T>
+void SerializeToFile(const wchar* filePath, T& item, bool compress = false)
+{
+    std::vector<uint8> buffer;
+    SerializeToMemory(item, buffer);
+    if(compress)
+    {
+        std::vector<uint8> compressed;
+        CompressBlocks(buffer.data(), buffer.size(), compressed);
+        buffer.swap(compressed);
+    }
+
+    File file(filePath, FileOpenMode::Write);
+    file.Write(buffer.size(), buffer.data());
+}
+
+// Serializes to memory on the calling thread, and then writes the file from a task. The item can
+// be modified or destroyed as soon as this returns. The write waits for the dependencies, which
+// can be used to keep successive writes to the same file in order.
+template<typename T>
+TaskHandle SerializeToFileAsync(const wchar* filePath, T& item, bool compress = false,
+                                const TaskHandle* dependencies = nullptr, uint64 numDependencies = 0)
+{
+    std::shared_ptr<std::vector<uint8>> buffer(new std::vector<uint8>());
+    SerializeToMemory(item, *buffer);
+
+    const std::wstring path(filePath);
+    return SubmitTask([path, buffer, compress]()
+    {
+        if(compress)
+        {
+            std::vector<uint8> compressed;
+            CompressBlocks(buffer->data(), buffer->size(), compressed);
+            buffer->swap(compressed);
+        }
+
+        File file(path.c_str(), FileOpenMode::Write);
+        file.Write(buffer->size(), buffer->data());
+    }, dependencies, numDependencies);
 }
 
 }
\ No newline at end of file
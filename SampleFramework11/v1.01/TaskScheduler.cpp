@@ -0,0 +1,445 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#include "PCH.h"
+
+#include "TaskScheduler.h"
+#include "Exceptions.h"
+#include "Utility.h"
+
+namespace SampleFramework11
+{
+
+struct Task
+{
+    TaskFunction Function;
+    std::atomic<uint64> NumPendingDependencies;
+    std::atomic<bool> Completed;
+    std::exception_ptr Exception;
+    bool Background = false;
+
+    // Tasks that are waiting on this one
+    std::mutex ContinuationMutex;
+    std::vector<TaskHandle> Continuations;
+};
+
+// Each thread has its own queue, where it pushes and pops at the back. Idle threads steal from
+// the front of the other queues.
+struct TaskQueue
+{
+    std::mutex Mutex;
+    std::deque<TaskHandle> Tasks;
+};
+
+struct TaskSchedulerState
+{
+    std::vector<std::thread> Workers;
+
+    // Queue 0 is shared by all threads that aren't workers
+    std::unique_ptr<TaskQueue[]> Queues;
+    uint32 NumQueues = 0;
+    std::atomic<uint64> NumQueuedTasks;
+
+    // Background tasks are only taken by idle workers, never by a thread that's waiting
+    TaskQueue BackgroundQueue;
+    std::atomic<uint64> NumQueuedBackgroundTasks;
+
+    std::mutex SleepMutex;
+    std::condition_variable SleepCondition;
+    bool ShuttingDown = false;
+
+    // Signaled when a task completes or is queued, for threads that are blocked in WaitForTask()
+    std::mutex WaitMutex;
+    std::condition_variable WaitCondition;
+};
+
+// Number of times a waiting thread yields before it blocks until something changes
+static const uint32 WaitSpinCount = 64;
+
+static TaskSchedulerState* scheduler = nullptr;
+static thread_local uint32 threadQueueIdx = 0;
+
+// Set while the thread is executing a background task, so that any tasks it submits (such as
+// ParallelFor helpers) are background tasks as well
+static thread_local bool inBackgroundTask = false;
+
+static void ExecuteTask(const TaskHandle& task);
+
+static void NotifyWaiters()
+{
+    {
+        std::lock_guard<std::mutex> lock(scheduler->WaitMutex);
+    }
+    scheduler->WaitCondition.notify_all();
+}
+
+static void PushTask(const TaskHandle& task)
+{
+    if(scheduler == nullptr)
+    {
+        ExecuteTask(task);
+        return;
+    }
+
+    // Without any workers a background task has to go in the normal queue, or it would never run
+    if(task->Background && scheduler->Workers.size() > 0)
+    {
+        TaskQueue& queue = scheduler->BackgroundQueue;
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        queue.Tasks.push_back(task);
+        ++scheduler->NumQueuedBackgroundTasks;
+    }
+    else
+    {
+        TaskQueue& queue = scheduler->Queues[threadQueueIdx];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        queue.Tasks.push_back(task);
+        ++scheduler->NumQueuedTasks;
+    }
+
+    NotifyWaiters();
+
+    {
+        std::lock_guard<std::mutex> lock(scheduler->SleepMutex);
+    }
+    scheduler->SleepCondition.notify_one();
+}
+
+static bool PopTask(TaskHandle& task, bool allowBackground)
+{
+    if(scheduler == nullptr)
+        return false;
+
+    if(scheduler->NumQueuedTasks == 0 && (allowBackground == false || scheduler->NumQueuedBackgroundTasks == 0))
+        return false;
+
+    // Try our own queue first, in LIFO order
+    {
+        TaskQueue& queue = scheduler->Queues[threadQueueIdx];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if(queue.Tasks.size() > 0)
+        {
+            task = std::move(queue.Tasks.back());
+            queue.Tasks.pop_back();
+            --scheduler->NumQueuedTasks;
+            return true;
+        }
+    }
+
+    // Steal the oldest task from another thread
+    for(uint32 i = 1; i < scheduler->NumQueues; ++i)
+    {
+        TaskQueue& queue = scheduler->Queues[(threadQueueIdx + i) % scheduler->NumQueues];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if(queue.Tasks.size() > 0)
+        {
+            task = std::move(queue.Tasks.front());
+            queue.Tasks.pop_front();
+            --scheduler->NumQueuedTasks;
+            return true;
+        }
+    }
+
+    // Only start on a background task once there's nothing else to do, in the order they were submitted
+    if(allowBackground)
+    {
+        TaskQueue& queue = scheduler->BackgroundQueue;
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if(queue.Tasks.size() > 0)
+        {
+            task = std::move(queue.Tasks.front());
+            queue.Tasks.pop_front();
+            --scheduler->NumQueuedBackgroundTasks;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void ReleaseDependency(const TaskHandle& task)
+{
+    if(--task->NumPendingDependencies == 0)
+        PushTask(task);
+}
+
+static void ExecuteTask(const TaskHandle& task)
+{
+    const bool wasInBackgroundTask = inBackgroundTask;
+    inBackgroundTask = task->Background;
+
+    try
+    {
+        task->Function();
+    }
+    catch(...)
+    {
+        task->Exception = std::current_exception();
+    }
+
+    inBackgroundTask = wasInBackgroundTask;
+
+    task->Function = nullptr;
+
+    std::vector<TaskHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(task->ContinuationMutex);
+        task->Completed = true;
+        continuations.swap(task->Continuations);
+    }
+
+    for(uint64 i = 0; i < continuations.size(); ++i)
+        ReleaseDependency(continuations[i]);
+
+    if(scheduler != nullptr)
+        NotifyWaiters();
+}
+
+static void WorkerThread(uint32 queueIdx)
+{
+    threadQueueIdx = queueIdx;
+
+    // Tasks may end up using WIC
+    #if defined(_WIN32)
+        const HRESULT coInitResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    #endif
+
+    while(true)
+    {
+        TaskHandle task;
+        if(PopTask(task, true))
+        {
+            ExecuteTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(scheduler->SleepMutex);
+        scheduler->SleepCondition.wait(lock, []()
+        {
+            return scheduler->NumQueuedTasks > 0 || scheduler->NumQueuedBackgroundTasks > 0 || scheduler->ShuttingDown;
+        });
+        if(scheduler->ShuttingDown)
+            break;
+    }
+
+    #if defined(_WIN32)
+        if(SUCCEEDED(coInitResult))
+            CoUninitialize();
+    #endif
+}
+
+void InitializeTaskScheduler(uint32 numWorkerThreads)
+{
+    if(scheduler != nullptr)
+        return;
+
+    if(numWorkerThreads == 0)
+        numWorkerThreads = std::max<uint32>(std::thread::hardware_concurrency(), 1) - 1;
+
+    scheduler = new TaskSchedulerState();
+    scheduler->NumQueues = numWorkerThreads + 1;
+    scheduler->Queues.reset(new TaskQueue[scheduler->NumQueues]);
+    scheduler->NumQueuedTasks = 0;
+    scheduler->NumQueuedBackgroundTasks = 0;
+
+    threadQueueIdx = 0;
+    for(uint32 i = 0; i < numWorkerThreads; ++i)
+        scheduler->Workers.push_back(std::thread(WorkerThread, i + 1));
+}
+
+void ShutdownTaskScheduler()
+{
+    if(scheduler == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(scheduler->SleepMutex);
+        scheduler->ShuttingDown = true;
+    }
+    scheduler->SleepCondition.notify_all();
+
+    for(uint64 i = 0; i < scheduler->Workers.size(); ++i)
+        scheduler->Workers[i].join();
+
+    delete scheduler;
+    scheduler = nullptr;
+}
+
+uint32 NumTaskThreads()
+{
+    return scheduler != nullptr ? scheduler->NumQueues : 1;
+}
+
+static TaskHandle SubmitTask(TaskFunction function, const TaskHandle* dependencies, uint64 numDependencies,
+                             bool background)
+{
+    TaskHandle task = std::make_shared<Task>();
+    task->Function = std::move(function);
+    task->Completed = false;
+    task->Background = background;
+
+    // Hold an extra dependency while registering, so that the task can't be queued until we're done
+    task->NumPendingDependencies = 1;
+    for(uint64 i = 0; i < numDependencies; ++i)
+    {
+        const TaskHandle& dependency = dependencies[i];
+        if(dependency == nullptr)
+            continue;
+
+        std::lock_guard<std::mutex> lock(dependency->ContinuationMutex);
+        if(dependency->Completed == false)
+        {
+            ++task->NumPendingDependencies;
+            dependency->Continuations.push_back(task);
+        }
+    }
+
+    ReleaseDependency(task);
+
+    return task;
+}
+
+TaskHandle SubmitTask(TaskFunction function, const TaskHandle* dependencies, uint64 numDependencies)
+{
+    return SubmitTask(std::move(function), dependencies, numDependencies, inBackgroundTask);
+}
+
+TaskHandle SubmitTask(TaskFunction function, std::initializer_list<TaskHandle> dependencies)
+{
+    return SubmitTask(std::move(function), dependencies.begin(), dependencies.size(), inBackgroundTask);
+}
+
+TaskHandle SubmitBackgroundTask(TaskFunction function, const TaskHandle* dependencies, uint64 numDependencies)
+{
+    return SubmitTask(std::move(function), dependencies, numDependencies, true);
+}
+
+void WaitForTask(const TaskHandle& task)
+{
+    Assert_(task != nullptr);
+
+    // Help out with other tasks while waiting. Background tasks could keep this thread busy for
+    // much longer than the task we're waiting on, so they're only taken if this thread is already
+    // running a background task, which also lets it help with its own background helpers. Once
+    // there's nothing to help with, yield for a little while in case the task is about to finish,
+    // and then block until a task completes or new work is queued.
+    const bool helpWithBackground = inBackgroundTask;
+    uint32 numIdleIterations = 0;
+    while(task->Completed == false)
+    {
+        TaskHandle otherTask;
+        if(PopTask(otherTask, helpWithBackground))
+        {
+            ExecuteTask(otherTask);
+            numIdleIterations = 0;
+        }
+        else if(scheduler == nullptr || numIdleIterations < WaitSpinCount)
+        {
+            std::this_thread::yield();
+            ++numIdleIterations;
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(scheduler->WaitMutex);
+            scheduler->WaitCondition.wait(lock, [&]()
+            {
+                return task->Completed || scheduler->NumQueuedTasks > 0
+                       || (helpWithBackground && scheduler->NumQueuedBackgroundTasks > 0);
+            });
+        }
+    }
+
+    if(task->Exception != nullptr)
+        std::rethrow_exception(task->Exception);
+}
+
+void WaitForTasks(const TaskHandle* tasks, uint64 numTasks)
+{
+    // Wait for all of them before re-throwing the first exception, since the caller's stack
+    // may be referenced by the other tasks
+    std::exception_ptr exception;
+    for(uint64 i = 0; i < numTasks; ++i)
+    {
+        try
+        {
+            WaitForTask(tasks[i]);
+        }
+        catch(...)
+        {
+            if(exception == nullptr)
+                exception = std::current_exception();
+        }
+    }
+
+    if(exception != nullptr)
+        std::rethrow_exception(exception);
+}
+
+bool TaskCompleted(const TaskHandle& task)
+{
+    return task->Completed;
+}
+
+void ParallelFor(uint64 count, uint64 grainSize, const ParallelForFunction& function)
+{
+    if(count == 0)
+        return;
+
+    const uint64 numThreads = NumTaskThreads();
+    if(grainSize == 0)
+        grainSize = std::max<uint64>(count / (numThreads * 4), 1);
+
+    const uint64 numChunks = (count + grainSize - 1) / grainSize;
+    if(numChunks == 1 || numThreads == 1)
+    {
+        function(0, count);
+        return;
+    }
+
+    // Chunks are pulled from a shared counter, with one helper task per thread plus the calling
+    // thread. This keeps the number of tasks low while still balancing uneven chunks.
+    std::atomic<uint64> nextChunk(0);
+    auto processChunks = [&]()
+    {
+        for(uint64 chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++)
+        {
+            const uint64 start = chunk * grainSize;
+            function(start, std::min(start + grainSize, count));
+        }
+    };
+
+    std::vector<TaskHandle> helpers(std::min(numChunks, numThreads) - 1);
+    for(uint64 i = 0; i < helpers.size(); ++i)
+        helpers[i] = SubmitTask(processChunks);
+
+    std::exception_ptr exception;
+    try
+    {
+        processChunks();
+    }
+    catch(...)
+    {
+        exception = std::current_exception();
+    }
+
+    try
+    {
+        WaitForTasks(helpers.data(), helpers.size());
+    }
+    catch(...)
+    {
+        if(exception == nullptr)
+            exception = std::current_exception();
+    }
+
+    if(exception != nullptr)
+        std::rethrow_exception(exception);
+}
+
+}
@@ -0,0 +1,54 @@
+//=================================================================================================
+//
+//  MJP's DX11 Sample Framework
+//  http://mynameismjp.wordpress.com/
+//
+//  All code licensed under the MIT license
+//
+//=================================================================================================
+
+#pragma once
+
+#include "PCH.h"
+
+namespace SampleFramework11
+{
+
+struct Task;
+
+// Handle to a submitted task, which can be waited on or used as a dependency of other tasks
+typedef std::shared_ptr<Task> TaskHandle;
+
+typedef std::function<void()> TaskFunction;
+typedef std::function<void(uint64 start, uint64 end)> ParallelForFunction;
+
+// Starts the worker threads. Passing 0 creates one worker per hardware thread, minus one for
+// the calling thread. Until this is called, tasks are executed immediately on the calling thread.
+void InitializeTaskScheduler(uint32 numWorkerThreads = 0);
+void ShutdownTaskScheduler();
+
+// Number of threads that can execute tasks, including the calling thread
+uint32 NumTaskThreads();
+
+// Queues a task that will run once all of its dependencies have completed
+TaskHandle SubmitTask(TaskFunction function, const TaskHandle* dependencies = nullptr, uint64 numDependencies = 0);
+TaskHandle SubmitTask(TaskFunction function, std::initializer_list<TaskHandle> dependencies);
+
+// Queues a long-running task that's only executed by worker threads once they run out of other
+// tasks, so that it never ends up running inline on a thread that's waiting on something else.
+// Tasks submitted while a background task is running (including ParallelFor helpers) are also
+// background tasks. Without any worker threads it's treated like any other task.
+TaskHandle SubmitBackgroundTask(TaskFunction function, const TaskHandle* dependencies = nullptr, uint64 numDependencies = 0);
+
+// Blocks until the task completes, executing other queued tasks while waiting. Background tasks
+// are only executed if the calling thread is running a background task itself. Exceptions thrown
+// by the task are re-thrown here.
+void WaitForTask(const TaskHandle& task);
+void WaitForTasks(const TaskHandle* tasks, uint64 numTasks);
+bool TaskCompleted(const TaskHandle& task);
+
+// Calls the function for chunks of [0, count) that are at most grainSize elements in size, spread
+// across the worker threads and the calling thread. A grain size of 0 picks one automatically.
+void ParallelFor(uint64 count, uint64 grainSize, const ParallelForFunction& function);
+
+}
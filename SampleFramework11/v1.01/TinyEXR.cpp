@@ -8329,3 +8329,38 @@ int SaveDeepEXR(const DeepImage *deepImage, const char *filename,
 
   return 0; // OK
 }
+
+// == SF11 Changes START ==========================================================================
+// Exposes the embedded miniz to the framework's block compression (see Compression.h)
+
+#include "Compression.h"
+
+namespace SampleFramework11
+{
+
+uint64 DeflateBound(uint64 size)
+{
+    return miniz::mz_compressBound(miniz::mz_ulong(size));
+}
+
+bool DeflateCompress(const void* src, uint64 srcSize, void* dst, uint64& dstSize)
+{
+    miniz::mz_ulong compressedSize = miniz::mz_ulong(dstSize);
+    const int result = miniz::mz_compress2(reinterpret_cast<unsigned char*>(dst), &compressedSize,
+                                           reinterpret_cast<const unsigned char*>(src),
+                                           miniz::mz_ulong(srcSize), miniz::MZ_DEFAULT_LEVEL);
+    dstSize = compressedSize;
+    return result == miniz::MZ_OK;
+}
+
+bool DeflateDecompress(const void* src, uint64 srcSize, void* dst, uint64 dstSize)
+{
+    miniz::mz_ulong decompressedSize = miniz::mz_ulong(dstSize);
+    const int result = miniz::mz_uncompress(reinterpret_cast<unsigned char*>(dst), &decompressedSize,
+                                            reinterpret_cast<const unsigned char*>(src),
+                                            miniz::mz_ulong(srcSize));
+    return result == miniz::MZ_OK && decompressedSize == dstSize;
+}
+
+}
+// == SF11 Changes END ==========================================================================